@@ -0,0 +1,226 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QMap>
+#include <QtCore/QStringList>
+#include <QtCore/QTextStream>
+
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlError>
+#include <QtSql/QSqlQuery>
+
+/*
+ * Catalog loading of the database tree on a database with many
+ * relations: the former query per scheme and relation kind against the
+ * single catalog query of CatalogModel.
+ *
+ *   catalog_benchmark create [schemes] [tables]
+ *   catalog_benchmark run
+ *   catalog_benchmark drop
+ *
+ * The connection is taken from the PGHOST, PGPORT, PGDATABASE, PGUSER
+ * and PGPASSWORD environment variables.
+ */
+
+static const char schemePrefix[] = "bench_";
+static const char catalogQuery[] = "SELECT n.nspname, n.oid, c.relkind::text, c.relname, c.oid, "
+								   "hashtext(n.xmin::text || n.nspname)::bigint + "
+								   "coalesce(sum(hashtext(c.xmin::text || ':' || c.oid::text)::bigint) OVER (PARTITION BY n.oid), 0) "
+								   "FROM pg_namespace n "
+								   "LEFT JOIN pg_class c ON c.relnamespace = n.oid AND c.relkind IN ('r', 'v', 'S') "
+								   "ORDER BY n.nspname, c.relname";
+
+typedef QMap<QString, QStringList> Relations;
+
+static bool exec(QSqlQuery *query, const QString &statement)
+{
+	if (!query->exec(statement)) {
+		QTextStream(stderr) << query->lastError().text() << "\n";
+		return false;
+	}
+
+	return true;
+}
+
+static bool createSchemes(const QSqlDatabase &db, int schemes, int tables)
+{
+	QSqlQuery query(db);
+
+	for (int i = 0; i < schemes; i++) {
+		const QString &scheme = schemePrefix + QString::number(i);
+		QStringList statements;
+		statements << QString("CREATE SCHEMA %1").arg(scheme);
+		for (int j = 0; j < tables; j++) {
+			statements << QString("CREATE TABLE %1.t%2 (id integer)").arg(scheme).arg(j);
+		}
+
+		if (!exec(&query, statements.join(";\n"))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool dropSchemes(const QSqlDatabase &db)
+{
+	QSqlQuery query(db);
+	if (!exec(&query, QString("SELECT nspname FROM pg_namespace WHERE nspname LIKE '%1%'").arg(schemePrefix))) {
+		return false;
+	}
+
+	QStringList schemes;
+	while (query.next()) {
+		schemes << query.value(0).toString();
+	}
+
+	foreach (const QString &scheme, schemes) {
+		if (!exec(&query, QString("DROP SCHEMA %1 CASCADE").arg(scheme))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static Relations loadPerScheme(const QSqlDatabase &db, int *roundTrips)
+{
+	Relations relations;
+	QSqlQuery namespaces(db);
+	if (!exec(&namespaces, "SELECT nspname, oid FROM pg_namespace ORDER BY 1")) {
+		return relations;
+	}
+	++*roundTrips;
+
+	const char kinds[] = {'r', 'v', 'S'};
+	QSqlQuery query(db);
+	while (namespaces.next()) {
+		const QString &scheme = namespaces.value(0).toString();
+		QStringList &names = relations[scheme];
+
+		for (size_t i = 0; i < sizeof(kinds); i++) {
+			query.prepare(QString("SELECT relname FROM pg_class WHERE relkind='%1' AND relnamespace=:relnamespace ORDER BY 1")
+						  .arg(kinds[i]));
+			query.bindValue(":relnamespace", namespaces.value(1));
+			query.exec();
+			++*roundTrips;
+
+			while (query.next()) {
+				names << query.value(0).toString();
+			}
+		}
+	}
+
+	return relations;
+}
+
+static Relations loadCatalog(const QSqlDatabase &db, int *roundTrips)
+{
+	Relations relations;
+	QSqlQuery query(db);
+	query.setForwardOnly(true);
+	if (!exec(&query, catalogQuery)) {
+		return relations;
+	}
+	++*roundTrips;
+
+	while (query.next()) {
+		QStringList &names = relations[query.value(0).toString()];
+		if (!query.isNull(3)) {
+			names << query.value(3).toString();
+		}
+	}
+
+	return relations;
+}
+
+static int relationCount(const Relations &relations)
+{
+	int count = 0;
+	foreach (const QStringList &names, relations) {
+		count += names.size();
+	}
+
+	return count;
+}
+
+// The former tree listed each relation kind in turn, so only the sets of
+// names are compared.
+static Relations sorted(Relations relations)
+{
+	for (Relations::iterator it = relations.begin(); it != relations.end(); ++it) {
+		it.value().sort();
+	}
+
+	return relations;
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QTextStream out(stdout);
+
+	const QStringList &arguments = app.arguments();
+	const QString &mode = arguments.value(1);
+	if (mode != "create" && mode != "drop" && mode != "run") {
+		out << "Usage: catalog_benchmark create [schemes] [tables] | run | drop\n";
+		return 1;
+	}
+
+	QSqlDatabase db = QSqlDatabase::addDatabase("QPSQL");
+	if (!db.open()) {
+		out << db.lastError().text() << "\n";
+		return 1;
+	}
+
+	if (mode == "create") {
+		return createSchemes(db, arguments.value(2, "400").toInt(), arguments.value(3, "250").toInt()) ? 0 : 1;
+	} else if (mode == "drop") {
+		return dropSchemes(db) ? 0 : 1;
+	}
+
+	QElapsedTimer timer;
+	int roundTrips = 0;
+
+	timer.start();
+	const Relations &perScheme = loadPerScheme(db, &roundTrips);
+	out << "per scheme: " << timer.elapsed() << " ms, " << roundTrips << " round trips, ";
+	out << perScheme.size() << " schemes, " << relationCount(perScheme) << " relations\n";
+
+	roundTrips = 0;
+	timer.restart();
+	const Relations &catalog = loadCatalog(db, &roundTrips);
+	out << "catalog: " << timer.elapsed() << " ms, " << roundTrips << " round trips, ";
+	out << catalog.size() << " schemes, " << relationCount(catalog) << " relations\n";
+
+	if (sorted(perScheme) != sorted(catalog)) {
+		out << "The relations differ\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,149 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QStringList>
+#include <QtCore/QTextStream>
+
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlError>
+#include <QtSql/QSqlQuery>
+#include <QtSql/QSqlQueryModel>
+
+#include <unistd.h>
+
+#include "resultstore.h"
+
+/*
+ * Fill rate and memory of ResultStore against QSqlQueryModel, the model
+ * the result grid used before. One model per run, so the memory of one
+ * is not reused by the other:
+ *
+ *   resultstore_benchmark store|model [rows]
+ *
+ * The connection is taken from the PGHOST, PGPORT, PGDATABASE, PGUSER
+ * and PGPASSWORD environment variables.
+ */
+
+static const char benchmarkQuery[] = "SELECT g, g * 0.5::float8, g % 2 = 0, "
+									 "timestamp '2000-01-01' + g * interval '1 second', md5(g::text), "
+									 "CASE WHEN g % 10 <> 0 THEN 'row ' || g END "
+									 "FROM generate_series(1, %1) g";
+static const int chunkSize = 1000;
+
+static qint64 residentSize()
+{
+	QFile file("/proc/self/statm");
+	if (!file.open(QIODevice::ReadOnly)) {
+		return 0;
+	}
+
+	const QList<QByteArray> &fields = file.readAll().split(' ');
+	return fields.value(1).toLongLong() * sysconf(_SC_PAGESIZE);
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QTextStream out(stdout);
+
+	const QStringList &arguments = app.arguments();
+	const QString &mode = arguments.value(1);
+	const int rows = arguments.value(2, "1000000").toInt();
+	if ((mode != "store" && mode != "model") || rows <= 0) {
+		out << "Usage: resultstore_benchmark store|model [rows]\n";
+		return 1;
+	}
+
+	QSqlDatabase db = QSqlDatabase::addDatabase("QPSQL");
+	if (!db.open()) {
+		out << db.lastError().text() << "\n";
+		return 1;
+	}
+
+	const QString &query = QString(benchmarkQuery).arg(rows);
+	const qint64 before = residentSize();
+	qint64 cells = 0;
+	qint64 storeSize = -1;
+	QVariant last;
+
+	QElapsedTimer timer;
+	timer.start();
+
+	// Both fill until every row is held and read every cell once, as a
+	// view scrolled through the whole result would.
+	if (mode == "model") {
+		QSqlQueryModel model;
+		model.setQuery(query, db);
+		while (model.canFetchMore()) {
+			model.fetchMore();
+		}
+
+		for (int row = 0; row < model.rowCount(); row++) {
+			for (int column = 0; column < model.columnCount(); column++) {
+				last = model.data(model.index(row, column));
+			}
+		}
+		cells = qint64(model.rowCount()) * model.columnCount();
+		out << mode << ": " << timer.elapsed() << " ms, ";
+		out << double(residentSize() - before) / qMax(cells, Q_INT64_C(1)) << " resident bytes per cell";
+	} else {
+		ResultStore store;
+		QSqlQuery sqlQuery(db);
+		sqlQuery.setForwardOnly(true);
+		if (!sqlQuery.exec(query)) {
+			out << sqlQuery.lastError().text() << "\n";
+			return 1;
+		}
+
+		store.setColumns(ResultStore::columnsOf(sqlQuery.record()));
+		bool atEnd = false;
+		while (!atEnd) {
+			ResultChunkBuilder builder(store.columns(), chunkSize);
+			while (builder.rowCount() < chunkSize && sqlQuery.next()) {
+				builder.addRow(sqlQuery);
+			}
+			atEnd = builder.rowCount() < chunkSize;
+			store.append(builder.finish());
+		}
+		sqlQuery.finish();
+
+		for (int row = 0; row < store.rowCount(); row++) {
+			for (int column = 0; column < store.columnCount(); column++) {
+				last = store.value(row, column);
+			}
+		}
+		cells = qint64(store.rowCount()) * store.columnCount();
+		storeSize = store.byteSize();
+		out << mode << ": " << timer.elapsed() << " ms, ";
+		out << double(residentSize() - before) / qMax(cells, Q_INT64_C(1)) << " resident bytes per cell, ";
+		out << double(storeSize) / qMax(cells, Q_INT64_C(1)) << " stored bytes per cell";
+	}
+
+	out << ", " << cells << " cells\n";
+	return 0;
+}
@@ -0,0 +1,164 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QRegExp>
+#include <QtCore/QStringList>
+#include <QtCore/QTextStream>
+
+#include <QtGui/QApplication>
+#include <QtGui/QTextBlock>
+#include <QtGui/QTextCursor>
+#include <QtGui/QTextDocument>
+
+#include "sqlhighlighter.h"
+
+/*
+ * Highlighting of a long SQL dump with the single-pass SQLHighlighter
+ * against the regular expressions it replaced: the whole document once,
+ * then a single character typed in its middle.
+ *
+ *   sqlhighlighter_benchmark lexer|regexp [lines]
+ *
+ * QTextDocument needs a display, run it under Xvfb on a headless host.
+ */
+
+//! The highlighter of the editor before the lexer, kept as a baseline
+class RegExpHighlighter : public QSyntaxHighlighter
+{
+public:
+	RegExpHighlighter(QTextDocument *parent)
+		: QSyntaxHighlighter(parent)
+	{
+	}
+
+protected:
+	void highlightBlock(const QString &text)
+	{
+		setFormat(0, text.length(), Qt::gray);
+
+		const QRegExp commandsRegexp("\\b(?:select|from|where|and|case|when|then|else|distinct|all|null|"
+									 "is|like|between|not|group|by|having|order|inner|outer|right|left|alter|with|isnull|cast|create|replace|function|"
+									 "returns|language|volatile|cost|table|view|or|"
+									 "asc|desc|"
+									 "join|on|using|union|exists|in|as|intersect|except|coalesce|insert|into|update)\\b",
+									 Qt::CaseInsensitive);
+		setFormatByRegExp(commandsRegexp, text, Qt::magenta);
+
+		const QRegExp aggregationsRegexp("\\b(?:count|min|max)\\b\\s*\\([^\\)]+\\)",
+										 Qt::CaseInsensitive);
+		setFormatByRegExp(aggregationsRegexp, text, Qt::darkGreen);
+
+		const QRegExp numbersRegexp("[^\\w]((\\d+)(\\.)?)",
+									Qt::CaseInsensitive);
+		setFormatByRegExp(numbersRegexp, text, Qt::blue);
+
+		const QRegExp stringsRegexp("'[^']+'",
+									Qt::CaseInsensitive);
+		setFormatByRegExp(stringsRegexp, text, Qt::red);
+
+		const QRegExp commentRegexp("^\\s*(--)");
+		setFormatByRegExp(commentRegexp, text, Qt::blue);
+	}
+
+private:
+	void setFormatByRegExp(const QRegExp &re, const QString &text, const QColor &color)
+	{
+		for (int i = re.indexIn(text, 0); i != -1; i = re.indexIn(text, i + re.matchedLength())) {
+			setFormat(i, re.matchedLength(), color);
+		}
+	}
+};
+
+static QString dump(int lines)
+{
+	QStringList result;
+
+	for (int i = 0; result.size() < lines; i++) {
+		switch (i % 5) {
+		case 0:
+			result << QString("-- Table t%1").arg(i)
+				   << QString("CREATE TABLE public.t%1 (id integer NOT NULL, name text, price numeric(10, 2));").arg(i);
+			break;
+		case 1:
+			result << QString("INSERT INTO public.t%1 (id, name, price) VALUES (%1, 'it''s row %1', %1.25);").arg(i);
+			break;
+		case 2:
+			result << "/*" << QString(" * Report %1, the totals by name").arg(i) << " */"
+				   << QString("SELECT name, count(*), max(price) FROM public.t%1 WHERE price > 10 GROUP BY name ORDER BY 2 DESC;").arg(i);
+			break;
+		case 3:
+			result << QString("CREATE FUNCTION public.f%1(a integer) RETURNS integer AS $body$").arg(i)
+				   << "BEGIN"
+				   << "\tRETURN a * 2; -- 'quoted' in a comment"
+				   << "END"
+				   << "$body$ LANGUAGE plpgsql VOLATILE;";
+			break;
+		default:
+			result << QString("UPDATE public.t%1 SET name = E'line\\n%1' WHERE id IN (SELECT id FROM public.t%1 LIMIT 5);").arg(i);
+			break;
+		}
+	}
+
+	return result.mid(0, lines).join("\n");
+}
+
+int main(int argc, char *argv[])
+{
+	QApplication app(argc, argv);
+	QTextStream out(stdout);
+
+	const QStringList &arguments = app.arguments();
+	const QString &mode = arguments.value(1);
+	const int lines = arguments.value(2, "50000").toInt();
+	if ((mode != "lexer" && mode != "regexp") || lines <= 0) {
+		out << "Usage: sqlhighlighter_benchmark lexer|regexp [lines]\n";
+		return 1;
+	}
+
+	QTextDocument document;
+	document.setPlainText(dump(lines));
+
+	QSyntaxHighlighter *highlighter = 0;
+	if (mode == "lexer") {
+		highlighter = new SQLHighlighter(&document);
+	} else {
+		highlighter = new RegExpHighlighter(&document);
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+	highlighter->rehighlight();
+	out << mode << ": " << document.blockCount() << " lines in " << timer.elapsed() << " ms, ";
+
+	// The highlighter reformats from the changed block until a block
+	// state is unchanged, synchronously on the edit.
+	QTextCursor cursor(document.findBlockByNumber(document.blockCount() / 2));
+	timer.restart();
+	cursor.insertText("x");
+	out << "an edit in " << timer.nsecsElapsed() / 1000 << " us\n";
+
+	return 0;
+}
@@ -0,0 +1,298 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QDir>
+#include <QtCore/QHash>
+#include <QtCore/QtEndian>
+
+#include <QtGui/QDesktopServices>
+
+#include <cstring>
+
+#include "catalogcache.h"
+
+static const char cacheMagic[4] = {'Q', 'P', 'G', 'C'};
+static const quint32 cacheVersion = 1;
+static const quint32 notLoaded = 0xFFFFFFFF;
+
+static const int headerSize = 24;
+static const int databaseSize = 16;
+static const int schemeSize = 24;
+static const int relationSize = 12;
+
+namespace
+{
+	class Writer
+	{
+	public:
+		void put32(quint32 value) {
+			uchar bytes [4];
+			qToLittleEndian(value, bytes);
+			m_data.append(reinterpret_cast<const char *>(bytes), 4);
+		}
+
+		void put64(qint64 value) {
+			uchar bytes [8];
+			qToLittleEndian(value, bytes);
+			m_data.append(reinterpret_cast<const char *>(bytes), 8);
+		}
+
+		void put8(quint8 value) {
+			m_data.append(char(value));
+		}
+
+		quint32 string(const QString &value) {
+			QHash<QString, quint32>::const_iterator it = m_stringOffsets.constFind(value);
+			if (it != m_stringOffsets.constEnd()) {
+				return it.value();
+			}
+
+			const QByteArray &utf8 = value.toUtf8().left(0xFFFF);
+			const quint32 offset = m_strings.size();
+
+			uchar bytes [2];
+			qToLittleEndian(quint16(utf8.size()), bytes);
+			m_strings.append(reinterpret_cast<const char *>(bytes), 2);
+			m_strings.append(utf8);
+
+			m_stringOffsets.insert(value, offset);
+			return offset;
+		}
+
+		QByteArray m_data;
+		QByteArray m_strings;
+
+	private:
+		QHash<QString, quint32> m_stringOffsets;
+	};
+
+	class Reader
+	{
+	public:
+		Reader(const uchar *data, qint64 size)
+			: m_data(data), m_size(size), m_strings(0), m_stringsSize(0) {}
+
+		bool contains(qint64 offset, qint64 size) const {
+			return offset >= 0 && size >= 0 && offset + size <= m_size;
+		}
+
+		quint32 get32(qint64 offset) const {
+			return qFromLittleEndian<quint32>(m_data + offset);
+		}
+
+		qint64 get64(qint64 offset) const {
+			return qFromLittleEndian<qint64>(m_data + offset);
+		}
+
+		void setStrings(qint64 offset, qint64 size) {
+			m_strings = m_data + offset;
+			m_stringsSize = size;
+		}
+
+		bool string(quint32 offset, QString *value) const {
+			if (qint64(offset) + 2 > m_stringsSize) {
+				return false;
+			}
+
+			const quint16 length = qFromLittleEndian<quint16>(m_strings + offset);
+			if (qint64(offset) + 2 + length > m_stringsSize) {
+				return false;
+			}
+
+			*value = QString::fromUtf8(reinterpret_cast<const char *>(m_strings + offset + 2), length);
+			return true;
+		}
+
+		const uchar *m_data;
+
+	private:
+		qint64 m_size;
+		const uchar *m_strings;
+		qint64 m_stringsSize;
+	};
+}
+
+QString CatalogCache::fileName(const QString &connectionName)
+{
+	const QString &path = QDesktopServices::storageLocation(QDesktopServices::DataLocation) + "/catalog";
+	return path + "/" + QString::fromLatin1(connectionName.toUtf8().toHex()) + ".cache";
+}
+
+bool CatalogCache::read(const QString &connectionName, CatalogSnapshot *snapshot)
+{
+	QFile file(fileName(connectionName));
+	if (!file.open(QIODevice::ReadOnly) || file.size() < headerSize) {
+		return false;
+	}
+
+	const uchar *data = file.map(0, file.size());
+	if (!data) {
+		return false;
+	}
+
+	Reader reader(data, file.size());
+
+	const quint32 databaseCount = reader.get32(8);
+	const quint32 schemeCount = reader.get32(12);
+	const quint32 relationCount = reader.get32(16);
+	const quint32 stringsSize = reader.get32(20);
+
+	const qint64 databasesOffset = headerSize;
+	const qint64 schemesOffset = databasesOffset + qint64(databaseCount) * databaseSize;
+	const qint64 relationsOffset = schemesOffset + qint64(schemeCount) * schemeSize;
+	const qint64 stringsOffset = relationsOffset + qint64(relationCount) * relationSize;
+
+	bool isOk = std::memcmp(data, cacheMagic, 4) == 0
+				&& reader.get32(4) == cacheVersion
+				&& stringsOffset + stringsSize == file.size();
+
+	if (isOk) {
+		reader.setStrings(stringsOffset, stringsSize);
+		snapshot->databases.resize(databaseCount);
+	}
+
+	for (quint32 i = 0; isOk && i < databaseCount; i++) {
+		const qint64 offset = databasesOffset + qint64(i) * databaseSize;
+		CatalogSnapshot::Database &database = snapshot->databases [i];
+
+		database.oid = reader.get32(offset);
+		isOk = reader.string(reader.get32(offset + 4), &database.name);
+
+		const quint32 firstScheme = reader.get32(offset + 8);
+		const quint32 count = reader.get32(offset + 12);
+		database.isLoaded = count != notLoaded;
+		if (!isOk || !database.isLoaded) {
+			continue;
+		}
+
+		isOk = qint64(firstScheme) + count <= schemeCount;
+		database.schemes.resize(isOk ? count : 0);
+
+		for (quint32 j = 0; isOk && j < count; j++) {
+			const qint64 schemeOffset = schemesOffset + qint64(firstScheme + j) * schemeSize;
+			CatalogSnapshot::Scheme &scheme = database.schemes [j];
+
+			scheme.oid = reader.get32(schemeOffset);
+			isOk = reader.string(reader.get32(schemeOffset + 4), &scheme.name);
+			scheme.signature = reader.get64(schemeOffset + 8);
+
+			const quint32 firstRelation = reader.get32(schemeOffset + 16);
+			const quint32 relations = reader.get32(schemeOffset + 20);
+			isOk = isOk && qint64(firstRelation) + relations <= relationCount;
+			scheme.relations.resize(isOk ? relations : 0);
+
+			for (quint32 k = 0; isOk && k < relations; k++) {
+				const qint64 relationOffset = relationsOffset + qint64(firstRelation + k) * relationSize;
+				CatalogSnapshot::Relation &relation = scheme.relations [k];
+
+				relation.oid = reader.get32(relationOffset);
+				isOk = reader.string(reader.get32(relationOffset + 4), &relation.name);
+				relation.kind = char(reader.m_data [relationOffset + 8]);
+			}
+		}
+	}
+
+	file.unmap(const_cast<uchar *>(data));
+
+	if (!isOk) {
+		snapshot->databases.clear();
+	}
+
+	return isOk;
+}
+
+bool CatalogCache::write(const QString &connectionName, const CatalogSnapshot &snapshot)
+{
+	Writer databases;
+	Writer schemes;
+	Writer relations;
+	Writer strings;
+
+	quint32 schemeCount = 0;
+	quint32 relationCount = 0;
+
+	foreach(const CatalogSnapshot::Database & database, snapshot.databases) {
+		databases.put32(database.oid);
+		databases.put32(strings.string(database.name));
+		databases.put32(schemeCount);
+		databases.put32(database.isLoaded ? database.schemes.size() : notLoaded);
+
+		if (!database.isLoaded) {
+			continue;
+		}
+
+		foreach(const CatalogSnapshot::Scheme & scheme, database.schemes) {
+			schemes.put32(scheme.oid);
+			schemes.put32(strings.string(scheme.name));
+			schemes.put64(scheme.signature);
+			schemes.put32(relationCount);
+			schemes.put32(scheme.relations.size());
+			++schemeCount;
+
+			foreach(const CatalogSnapshot::Relation & relation, scheme.relations) {
+				relations.put32(relation.oid);
+				relations.put32(strings.string(relation.name));
+				relations.put8(relation.kind);
+				relations.put8(0);
+				relations.put8(0);
+				relations.put8(0);
+				++relationCount;
+			}
+		}
+	}
+
+	Writer header;
+	header.m_data.append(cacheMagic, 4);
+	header.put32(cacheVersion);
+	header.put32(snapshot.databases.size());
+	header.put32(schemeCount);
+	header.put32(relationCount);
+	header.put32(strings.m_strings.size());
+
+	const QString &name = fileName(connectionName);
+	QDir().mkpath(QFileInfo(name).absolutePath());
+
+	QFile file(name + ".tmp");
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		return false;
+	}
+
+	const bool isOk = file.write(header.m_data) == header.m_data.size()
+					  && file.write(databases.m_data) == databases.m_data.size()
+					  && file.write(schemes.m_data) == schemes.m_data.size()
+					  && file.write(relations.m_data) == relations.m_data.size()
+					  && file.write(strings.m_strings) == strings.m_strings.size();
+	file.close();
+
+	if (!isOk) {
+		file.remove();
+		return false;
+	}
+
+	QFile::remove(name);
+	return file.rename(name);
+}
@@ -0,0 +1,69 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#ifndef CATALOGCACHE_H
+#define CATALOGCACHE_H
+
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+struct CatalogSnapshot {
+	struct Relation {
+		quint32 oid;
+		QString name;
+		char kind;
+	};
+
+	struct Scheme {
+		quint32 oid;
+		QString name;
+		qint64 signature;
+		QVector<Relation> relations;
+	};
+
+	struct Database {
+		quint32 oid;
+		QString name;
+		bool isLoaded;
+		QVector<Scheme> schemes;
+	};
+
+	QVector<Database> databases;
+};
+
+/*!
+ * Per-connection catalog snapshot on disk. The file is a flat array of
+ * fixed-size little-endian records followed by a string pool, so it is
+ * read straight from a memory mapping.
+ */
+class CatalogCache
+{
+public:
+	static QString fileName(const QString &connectionName);
+	static bool read(const QString &connectionName, CatalogSnapshot *snapshot);
+	static bool write(const QString &connectionName, const CatalogSnapshot &snapshot);
+};
+
+#endif //CATALOGCACHE_H
@@ -0,0 +1,884 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#include <QtCore/QSet>
+#include <QtCore/QTimer>
+
+#include <QtGui/QIcon>
+#include <QtGui/QPainter>
+#include <QtGui/QPixmap>
+
+#include <QtSql/QSqlDatabase>
+
+#include <algorithm>
+
+#include "catalogmodel.h"
+#include "catalogcache.h"
+
+static const char databasesQuery[] = "SELECT datname, oid FROM pg_database WHERE datallowconn ORDER BY 1";
+static const char catalogQuery[] = "SELECT n.nspname, n.oid, c.relkind::text, c.relname, c.oid, "
+								   "hashtext(n.xmin::text || n.nspname)::bigint + "
+								   "coalesce(sum(hashtext(c.xmin::text || ':' || c.oid::text)::bigint) OVER (PARTITION BY n.oid), 0) "
+								   "FROM pg_namespace n "
+								   "LEFT JOIN pg_class c ON c.relnamespace = n.oid AND c.relkind IN ('r', 'v', 'S') "
+								   "%1"
+								   "ORDER BY n.nspname, c.relname";
+// Ordered as catalogQuery by the C ordering of name, syncChildren inserts
+// new schemes at their row in this order
+static const char signaturesQuery[] = "SELECT n.oid, n.nspname::text, "
+									  "max(hashtext(n.xmin::text || n.nspname))::bigint + "
+									  "coalesce(sum(hashtext(c.xmin::text || ':' || c.oid::text)::bigint), 0) "
+									  "FROM pg_namespace n "
+									  "LEFT JOIN pg_class c ON c.relnamespace = n.oid AND c.relkind IN ('r', 'v', 'S') "
+									  "GROUP BY n.oid, n.nspname ORDER BY n.nspname";
+
+static const int busyFrameCount = 8;
+static const int busyInterval = 100;
+
+static QIcon busyIcon(int frame)
+{
+	static QVector<QIcon> icons;
+
+	if (icons.isEmpty()) {
+		for (int i = 0; i < busyFrameCount; i++) {
+			QPixmap pixmap(16, 16);
+			pixmap.fill(Qt::transparent);
+
+			QPainter painter(&pixmap);
+			painter.setRenderHint(QPainter::Antialiasing);
+			painter.translate(8, 8);
+			for (int spoke = 0; spoke < busyFrameCount; spoke++) {
+				QColor color(Qt::darkGray);
+				color.setAlphaF(1.0 - qreal((spoke - i + busyFrameCount) % busyFrameCount) / busyFrameCount);
+				painter.setPen(QPen(color, 2, Qt::SolidLine, Qt::RoundCap));
+				painter.drawLine(0, -3, 0, -6);
+				painter.rotate(-360.0 / busyFrameCount);
+			}
+			painter.end();
+
+			icons << QIcon(pixmap);
+		}
+	}
+
+	return icons.at(frame % busyFrameCount);
+}
+
+CatalogModel::CatalogModel(QObject *parent)
+	: QAbstractItemModel(parent)
+{
+	m_root = new Node;
+	m_root->parent = 0;
+	m_root->oid = 0;
+	m_root->name = intern(QString());
+	m_root->row = 0;
+	m_root->kind = ConnectionNode;
+	m_root->state = Loaded;
+
+	m_busyFrame = 0;
+	m_busyTimer = new QTimer(this);
+	m_busyTimer->setInterval(busyInterval);
+	connect(m_busyTimer, SIGNAL(timeout()), this, SLOT(nextBusyFrame()));
+}
+
+CatalogModel::~CatalogModel()
+{
+	deleteNode(m_root);
+}
+
+void CatalogModel::setConnections(const QStringList &connectionNames)
+{
+	for (int row = m_root->children.size() - 1; row >= connectionNames.size(); row--) {
+		removeRow(m_root, row);
+	}
+
+	for (int row = 0; row < m_root->children.size(); row++) {
+		Node *node = m_root->children.at(row);
+		if (m_names.at(node->name) != connectionNames.at(row)) {
+			unload(node);
+			node->name = intern(connectionNames.at(row));
+
+			const QModelIndex &index = indexOf(node);
+			emit dataChanged(index, index);
+		}
+	}
+
+	const int count = m_root->children.size();
+	if (count < connectionNames.size()) {
+		beginInsertRows(QModelIndex(), count, connectionNames.size() - 1);
+		for (int row = count; row < connectionNames.size(); row++) {
+			createNode(m_root, ConnectionNode, 0, connectionNames.at(row));
+		}
+		endInsertRows();
+
+		for (int row = count; row < connectionNames.size(); row++) {
+			restoreCache(m_root->children.at(row));
+		}
+	}
+}
+
+void CatalogModel::closeConnection(const QString &connectionName)
+{
+	foreach(Node * node, m_root->children) {
+		if (connectionName == m_names.at(node->name)) {
+			unload(node);
+			continue;
+		}
+
+		if (!connectionName.startsWith(m_names.at(node->name) + ".")) {
+			continue;
+		}
+
+		foreach(Node * databases, node->children) {
+			foreach(Node * database, databases->children) {
+				if (connectionName == this->connectionName(database)) {
+					unload(database);
+				}
+			}
+		}
+	}
+}
+
+void CatalogModel::refresh(const QModelIndex &index)
+{
+	Node *node = scopeOf(this->node(index));
+
+	if (node && (node->state == Loaded || node->state == Cached)) {
+		validate(node);
+	}
+}
+
+void CatalogModel::saveCache() const
+{
+	foreach(const Node * connection, m_root->children) {
+		if (connection->children.isEmpty()) {
+			continue;
+		}
+
+		CatalogSnapshot snapshot;
+
+		foreach(const Node * database, connection->children.first()->children) {
+			CatalogSnapshot::Database databaseSnapshot;
+			databaseSnapshot.oid = database->oid;
+			databaseSnapshot.name = m_names.at(database->name);
+			databaseSnapshot.isLoaded = (database->state == Loaded || database->state == Cached) && !database->children.isEmpty();
+
+			if (databaseSnapshot.isLoaded) {
+				foreach(const Node * scheme, database->children.first()->children) {
+					CatalogSnapshot::Scheme schemeSnapshot;
+					schemeSnapshot.oid = scheme->oid;
+					schemeSnapshot.name = m_names.at(scheme->name);
+					schemeSnapshot.signature = m_signatures.value(scheme);
+
+					foreach(const Node * folder, scheme->children) {
+						foreach(const Node * relation, folder->children) {
+							CatalogSnapshot::Relation relationSnapshot;
+							relationSnapshot.oid = relation->oid;
+							relationSnapshot.name = m_names.at(relation->name);
+							relationSnapshot.kind = relation->kind == TableNode ? 'r' : relation->kind == ViewNode ? 'v' : 'S';
+							schemeSnapshot.relations << relationSnapshot;
+						}
+					}
+
+					databaseSnapshot.schemes << schemeSnapshot;
+				}
+			}
+
+			snapshot.databases << databaseSnapshot;
+		}
+
+		CatalogCache::write(m_names.at(connection->name), snapshot);
+	}
+}
+
+CatalogModel::Kind CatalogModel::kind(const QModelIndex &index) const
+{
+	return Kind(node(index)->kind);
+}
+
+quint32 CatalogModel::oid(const QModelIndex &index) const
+{
+	return node(index)->oid;
+}
+
+QString CatalogModel::name(const QModelIndex &index) const
+{
+	return m_names.at(node(index)->name);
+}
+
+QString CatalogModel::connectionName(const QModelIndex &index) const
+{
+	return connectionName(node(index));
+}
+
+QString CatalogModel::schemeName(const QModelIndex &index) const
+{
+	for (Node *node = this->node(index); node != m_root; node = node->parent) {
+		if (node->kind == SchemeNode) {
+			return m_names.at(node->name);
+		}
+	}
+
+	return QString();
+}
+
+bool CatalogModel::isLoaded(const QModelIndex &index) const
+{
+	const Node *node = this->node(index);
+	return node->state == Loaded || node->state == Cached;
+}
+
+QModelIndex CatalogModel::index(int row, int column, const QModelIndex &parent) const
+{
+	Node *parentNode = node(parent);
+
+	if (column != 0 || row < 0 || row >= parentNode->children.size()) {
+		return QModelIndex();
+	}
+
+	return createIndex(row, column, parentNode->children.at(row));
+}
+
+QModelIndex CatalogModel::parent(const QModelIndex &index) const
+{
+	if (!index.isValid()) {
+		return QModelIndex();
+	}
+
+	return indexOf(node(index)->parent);
+}
+
+int CatalogModel::rowCount(const QModelIndex &parent) const
+{
+	return node(parent)->children.size();
+}
+
+int CatalogModel::columnCount(const QModelIndex &parent) const
+{
+	Q_UNUSED(parent)
+	return 1;
+}
+
+QVariant CatalogModel::data(const QModelIndex &index, int role) const
+{
+	if (!index.isValid()) {
+		return QVariant();
+	}
+
+	const Node *node = this->node(index);
+
+	if (role == Qt::DisplayRole) {
+		switch (node->kind) {
+		case DatabasesNode:
+			return tr("Databases");
+		case SchemesNode:
+			return tr("Schemes");
+		case TablesNode:
+			return tr("Tables");
+		case ViewsNode:
+			return tr("Views");
+		case SequencesNode:
+			return tr("Sequences");
+		default:
+			return m_names.at(node->name);
+		}
+	}
+
+	if (role == Qt::ToolTipRole && node->state == Cached) {
+		return tr("Cached, not yet validated against the server");
+	}
+
+	if (role == Qt::ToolTipRole && node->state == Loading) {
+		return tr("Connecting...");
+	}
+
+	if (role == Qt::DecorationRole && node->state == Loading) {
+		return busyIcon(m_busyFrame);
+	}
+
+	if (role == Qt::DecorationRole) {
+		switch (node->kind) {
+		case ConnectionNode:
+			return QIcon(node->state == Loaded ? ":/share/images/connect_established.png" : ":/share/images/connect_no.png");
+		case DatabaseNode:
+			return QIcon(node->state == Loaded ? ":/share/images/database.png" : ":/share/images/disconnected-database.png");
+		case TablesNode:
+		case TableNode:
+			return QIcon(":/share/images/table.png");
+		case ViewsNode:
+		case ViewNode:
+			return QIcon(":/share/images/view.png");
+		case SequencesNode:
+		case SequenceNode:
+			return QIcon(":/share/images/sequence.png");
+		default:
+			break;
+		}
+	}
+
+	return QVariant();
+}
+
+bool CatalogModel::hasChildren(const QModelIndex &parent) const
+{
+	const Node *node = this->node(parent);
+
+	if (node->kind == ConnectionNode || node->kind == DatabaseNode) {
+		return (node->state != Loaded && node->state != Cached) || !node->children.isEmpty();
+	}
+
+	return !node->children.isEmpty();
+}
+
+bool CatalogModel::canFetchMore(const QModelIndex &parent) const
+{
+	if (!parent.isValid()) {
+		return false;
+	}
+
+	const Node *node = this->node(parent);
+	return (node->kind == ConnectionNode || node->kind == DatabaseNode) && node->state == NotLoaded;
+}
+
+void CatalogModel::fetchMore(const QModelIndex &parent)
+{
+	if (canFetchMore(parent)) {
+		load(node(parent));
+	}
+}
+
+CatalogModel::Node *CatalogModel::node(const QModelIndex &index) const
+{
+	return index.isValid() ? static_cast<Node *>(index.internalPointer()) : m_root;
+}
+
+QModelIndex CatalogModel::indexOf(Node *node) const
+{
+	if (node == m_root) {
+		return QModelIndex();
+	}
+
+	// Rows are renumbered once per batch of inserts and removes, a view
+	// may ask in between
+	if (node->parent->children.value(node->row) != node) {
+		renumberChildren(node->parent);
+	}
+
+	return createIndex(node->row, 0, node);
+}
+
+CatalogModel::Node *CatalogModel::scopeOf(Node *node) const
+{
+	while (node && node->kind != DatabaseNode && node->kind != ConnectionNode) {
+		node = node->parent;
+	}
+
+	return node == m_root ? 0 : node;
+}
+
+QString CatalogModel::connectionName(Node *node) const
+{
+	node = scopeOf(node);
+
+	if (!node) {
+		return QString();
+	}
+
+	if (node->kind == DatabaseNode) {
+		return connectionName(node->parent) + "." + m_names.at(node->name);
+	}
+
+	return m_names.at(node->name);
+}
+
+quint32 CatalogModel::intern(const QString &name)
+{
+	QHash<QString, quint32>::const_iterator it = m_nameIds.constFind(name);
+
+	if (it != m_nameIds.constEnd()) {
+		return it.value();
+	}
+
+	const quint32 id = m_names.size();
+	m_names << name;
+	m_nameIds.insert(name, id);
+	return id;
+}
+
+CatalogModel::Node *CatalogModel::createNode(Node *parent, Kind kind, quint32 oid, const QString &name)
+{
+	Node *node = new Node;
+	node->parent = parent;
+	node->oid = oid;
+	node->name = intern(name);
+	node->row = parent->children.size();
+	node->kind = kind;
+	node->state = NotLoaded;
+
+	parent->children.append(node);
+	m_index.insert(NodeKey(scopeOf(parent), kind, oid), node);
+
+	return node;
+}
+
+CatalogModel::Node *CatalogModel::folder(Node *parent, Kind kind)
+{
+	foreach(Node * child, parent->children) {
+		if (child->kind == kind) {
+			return child;
+		}
+	}
+
+	const int row = parent->children.size();
+	beginInsertRows(indexOf(parent), row, row);
+	Node *node = createNode(parent, kind, parent->oid, QString());
+	node->state = Loaded;
+	endInsertRows();
+
+	return node;
+}
+
+void CatalogModel::syncChildren(Node *parent, Kind kind, const QList<CatalogObject> &objects)
+{
+	QHash<quint32, int> positions;
+	for (int i = 0; i < objects.size(); i++) {
+		positions.insert(objects.at(i).oid, i);
+	}
+
+	// Gone and renamed children leave in runs of adjacent rows, from the
+	// end so the rows before a run stay put
+	QSet<quint32> kept;
+	for (int row = parent->children.size() - 1; row >= 0;) {
+		int first = row;
+		while (first >= 0) {
+			const Node *child = parent->children.at(first);
+			const QHash<quint32, int>::const_iterator it = positions.constFind(child->oid);
+			if (it != positions.constEnd() && objects.at(it.value()).name == m_names.at(child->name)) {
+				kept.insert(child->oid);
+				break;
+			}
+			--first;
+		}
+
+		if (first < row) {
+			removeRows(parent, first + 1, row - first);
+		}
+		row = first - 1;
+	}
+
+	// New objects come in runs too, each run is one insert
+	for (int row = 0; row < objects.size();) {
+		if (kept.contains(objects.at(row).oid)) {
+			++row;
+			continue;
+		}
+
+		int last = row;
+		while (last + 1 < objects.size() && !kept.contains(objects.at(last + 1).oid)) {
+			++last;
+		}
+
+		beginInsertRows(indexOf(parent), row, last);
+		const int size = parent->children.size();
+		for (int i = row; i <= last; i++) {
+			createNode(parent, kind, objects.at(i).oid, objects.at(i).name);
+		}
+		std::rotate(parent->children.begin() + row, parent->children.begin() + size, parent->children.end());
+		endInsertRows();
+
+		row = last + 1;
+	}
+
+	renumberChildren(parent);
+}
+
+void CatalogModel::removeRow(Node *parent, int row)
+{
+	removeRows(parent, row, 1);
+	renumberChildren(parent);
+}
+
+void CatalogModel::removeRows(Node *parent, int row, int count)
+{
+	const QVector<Node *> nodes = parent->children.mid(row, count);
+
+	beginRemoveRows(indexOf(parent), row, row + count - 1);
+	parent->children.remove(row, count);
+	foreach(Node * node, nodes) {
+		deleteNode(node);
+	}
+	endRemoveRows();
+}
+
+void CatalogModel::renumberChildren(Node *parent)
+{
+	for (int i = 0, count = parent->children.size(); i < count; i++) {
+		parent->children.at(i)->row = i;
+	}
+}
+
+void CatalogModel::removeChildren(Node *node)
+{
+	if (node->children.isEmpty()) {
+		return;
+	}
+
+	beginRemoveRows(indexOf(node), 0, node->children.size() - 1);
+	foreach(Node * child, node->children) {
+		deleteNode(child);
+	}
+	node->children.clear();
+	endRemoveRows();
+}
+
+void CatalogModel::deleteNode(Node *node)
+{
+	foreach(Node * child, node->children) {
+		deleteNode(child);
+	}
+
+	removePendingLoads(node);
+	m_signatures.remove(node);
+	m_busyNodes.remove(node);
+
+	if (node != m_root) {
+		const NodeKey key(scopeOf(node->parent), node->kind, node->oid);
+		if (m_index.value(key) == node) {
+			m_index.remove(key);
+		}
+	}
+
+	delete node;
+}
+
+void CatalogModel::removePendingLoads(Node *node)
+{
+	for (QHash<int, PendingLoad>::iterator it = m_pendingLoads.begin(); it != m_pendingLoads.end();) {
+		if (it.value().node == node) {
+			it = m_pendingLoads.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void CatalogModel::unload(Node *node)
+{
+	// A load finishing after the unload must not refill a closed node
+	removePendingLoads(node);
+	removeChildren(node);
+	setState(node, NotLoaded);
+
+	const QModelIndex &index = indexOf(node);
+	emit dataChanged(index, index);
+}
+
+void CatalogModel::setState(Node *node, State state)
+{
+	node->state = state;
+
+	if (state == Loading) {
+		m_busyNodes.insert(node);
+		if (!m_busyTimer->isActive()) {
+			m_busyTimer->start();
+		}
+	} else {
+		m_busyNodes.remove(node);
+		if (m_busyNodes.isEmpty()) {
+			m_busyTimer->stop();
+		}
+	}
+}
+
+void CatalogModel::nextBusyFrame()
+{
+	m_busyFrame = (m_busyFrame + 1) % busyFrameCount;
+
+	foreach(Node * node, m_busyNodes) {
+		const QModelIndex &index = indexOf(node);
+		emit dataChanged(index, index);
+	}
+}
+
+void CatalogModel::load(Node *node)
+{
+	bool isSubmitted;
+	if (node->kind == ConnectionNode) {
+		isSubmitted = submit(node, LoadDatabases, QueryJob(databasesQuery));
+	} else {
+		isSubmitted = submit(node, LoadCatalog, QueryJob(QString(catalogQuery).arg("")));
+	}
+
+	if (isSubmitted && node->state == NotLoaded) {
+		setState(node, Loading);
+
+		const QModelIndex &index = indexOf(node);
+		emit dataChanged(index, index);
+	}
+}
+
+void CatalogModel::validate(Node *node)
+{
+	if (node->kind == DatabaseNode && !node->children.isEmpty()) {
+		QueryJob job(signaturesQuery);
+		job.priority = QueryJob::LowPriority;
+		submit(node, LoadSignatures, job);
+	} else if (node->kind == DatabaseNode) {
+		load(node);
+	} else {
+		QueryJob job(databasesQuery);
+		job.priority = QueryJob::LowPriority;
+		submit(node, LoadDatabases, job);
+	}
+}
+
+bool CatalogModel::submit(Node *node, LoadType type, const QueryJob &job)
+{
+	const QString &connectionName = this->connectionName(node);
+
+	emit connectionRequested(connectionName);
+	if (!QSqlDatabase::contains(connectionName)) {
+		return false;
+	}
+
+	QueryExecutor *executor = QueryExecutor::executor(connectionName);
+	connect(executor, SIGNAL(jobFinished(int, QueryResult)), this, SLOT(jobFinished(int, QueryResult)), Qt::UniqueConnection);
+
+	QueryJob queued = job;
+	if (queued.priority == QueryJob::NormalPriority) {
+		queued.priority = QueryJob::HighPriority;
+	}
+	m_pendingLoads.insert(executor->submit(queued), PendingLoad(node, type));
+	return true;
+}
+
+void CatalogModel::jobFinished(int jobId, const QueryResult &result)
+{
+	const PendingLoad load = m_pendingLoads.take(jobId);
+	Node *node = load.node;
+
+	if (!node) {
+		return;
+	}
+
+	bool isComplete = true;
+
+	if (result.error.isValid()) {
+		isComplete = false;
+		if (node->state == Loading) {
+			setState(node, NotLoaded);
+		}
+		if (node->state != Cached) {
+			emit errorOccurred(result.error);
+		}
+	} else {
+		switch (load.type) {
+		case LoadDatabases:
+			populateDatabases(node, result);
+			break;
+		case LoadCatalog:
+			populateSchemes(node, schemesOf(result), false);
+			break;
+		case LoadSignatures:
+			isComplete = populateSignatures(node, result);
+			break;
+		case LoadSchemes:
+			populateSchemes(node, schemesOf(result), true);
+			break;
+		}
+	}
+
+	if (isComplete && node->state != Loaded) {
+		setState(node, Loaded);
+		emit connectionOpened(connectionName(node));
+	}
+
+	const QModelIndex &index = indexOf(node);
+	emit dataChanged(index, index);
+}
+
+void CatalogModel::populateDatabases(Node *node, const QueryResult &result)
+{
+	QList<CatalogObject> databases;
+	for (int row = 0, count = result.rows.rowCount(); row < count; row++) {
+		databases << CatalogObject(result.rows.value(row, 1).toUInt(), result.rows.value(row, 0).toString());
+	}
+
+	Node *databasesNode = folder(node, DatabasesNode);
+	syncChildren(databasesNode, DatabaseNode, databases);
+
+	foreach(Node * database, databasesNode->children) {
+		if (database->state == Cached) {
+			validate(database);
+		}
+	}
+}
+
+bool CatalogModel::populateSignatures(Node *node, const QueryResult &result)
+{
+	QList<CatalogObject> schemes;
+	QHash<quint32, qint64> signatures;
+
+	for (int row = 0, count = result.rows.rowCount(); row < count; row++) {
+		const quint32 oid = result.rows.value(row, 0).toUInt();
+		schemes << CatalogObject(oid, result.rows.value(row, 1).toString());
+		signatures.insert(oid, result.rows.value(row, 2).toLongLong());
+	}
+
+	Node *schemesNode = folder(node, SchemesNode);
+	syncChildren(schemesNode, SchemeNode, schemes);
+
+	QStringList names;
+	foreach(const CatalogObject & scheme, schemes) {
+		names << scheme.name;
+	}
+	emit schemesLoaded(connectionName(node), names);
+
+	QStringList changed;
+	foreach(const Node * scheme, schemesNode->children) {
+		if (!m_signatures.contains(scheme) || m_signatures.value(scheme) != signatures.value(scheme->oid)) {
+			changed << QString::number(scheme->oid);
+		}
+	}
+
+	if (changed.isEmpty()) {
+		return true;
+	}
+
+	QueryJob job(QString(catalogQuery).arg("WHERE n.oid = ANY (?::oid[]) "));
+	job.bindValues << "{" + changed.join(",") + "}";
+	job.priority = QueryJob::LowPriority;
+	submit(node, LoadSchemes, job);
+
+	return false;
+}
+
+void CatalogModel::populateSchemes(Node *node, const QList<SchemeData> &schemes, bool isPatch)
+{
+	Node *schemesNode = folder(node, SchemesNode);
+	const QString &connectionName = this->connectionName(node);
+
+	if (!isPatch) {
+		QList<CatalogObject> objects;
+		QStringList names;
+		foreach(const SchemeData & scheme, schemes) {
+			objects << scheme.scheme;
+			names << scheme.scheme.name;
+		}
+		syncChildren(schemesNode, SchemeNode, objects);
+		emit schemesLoaded(connectionName, names);
+	}
+
+	foreach(const SchemeData & data, schemes) {
+		Node *scheme = m_index.value(NodeKey(node, SchemeNode, data.scheme.oid));
+		if (!scheme || scheme->parent != schemesNode) {
+			continue;
+		}
+
+		syncChildren(folder(scheme, TablesNode), TableNode, data.tables);
+		syncChildren(folder(scheme, ViewsNode), ViewNode, data.views);
+		syncChildren(folder(scheme, SequencesNode), SequenceNode, data.sequences);
+		m_signatures.insert(scheme, data.signature);
+
+		QStringList relations;
+		foreach(const CatalogObject & relation, data.tables + data.views + data.sequences) {
+			relations << relation.name;
+		}
+		emit relationsLoaded(connectionName, data.scheme.name, relations);
+	}
+}
+
+QList<CatalogModel::SchemeData> CatalogModel::schemesOf(const QueryResult &result)
+{
+	QList<SchemeData> schemes;
+
+	for (int row = 0, count = result.rows.rowCount(); row < count; row++) {
+		const quint32 id = result.rows.value(row, 1).toUInt();
+
+		if (schemes.isEmpty() || schemes.last().scheme.oid != id) {
+			schemes << SchemeData(id, result.rows.value(row, 0).toString(), result.rows.value(row, 5).toLongLong());
+		}
+
+		if (result.rows.isNull(row, 2)) {
+			continue;
+		}
+
+		const CatalogObject relation(result.rows.value(row, 4).toUInt(), result.rows.value(row, 3).toString());
+		const QString &kind = result.rows.value(row, 2).toString();
+		if (kind == "r") {
+			schemes.last().tables << relation;
+		} else if (kind == "v") {
+			schemes.last().views << relation;
+		} else if (kind == "S") {
+			schemes.last().sequences << relation;
+		}
+	}
+
+	return schemes;
+}
+
+void CatalogModel::restoreCache(Node *node)
+{
+	CatalogSnapshot snapshot;
+	if (!CatalogCache::read(m_names.at(node->name), &snapshot) || snapshot.databases.isEmpty()) {
+		return;
+	}
+
+	QList<CatalogObject> databases;
+	foreach(const CatalogSnapshot::Database & database, snapshot.databases) {
+		databases << CatalogObject(database.oid, database.name);
+	}
+
+	Node *databasesNode = folder(node, DatabasesNode);
+	syncChildren(databasesNode, DatabaseNode, databases);
+
+	for (int i = 0; i < snapshot.databases.size(); i++) {
+		const CatalogSnapshot::Database &database = snapshot.databases.at(i);
+		if (!database.isLoaded) {
+			continue;
+		}
+
+		QList<SchemeData> schemes;
+		foreach(const CatalogSnapshot::Scheme & scheme, database.schemes) {
+			schemes << SchemeData(scheme.oid, scheme.name, scheme.signature);
+			foreach(const CatalogSnapshot::Relation & relation, scheme.relations) {
+				const CatalogObject object(relation.oid, relation.name);
+				if (relation.kind == 'r') {
+					schemes.last().tables << object;
+				} else if (relation.kind == 'v') {
+					schemes.last().views << object;
+				} else {
+					schemes.last().sequences << object;
+				}
+			}
+		}
+
+		Node *databaseNode = databasesNode->children.at(i);
+		populateSchemes(databaseNode, schemes, false);
+		setState(databaseNode, Cached);
+	}
+
+	setState(node, Cached);
+	validate(node);
+}
@@ -0,0 +1,215 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#ifndef CATALOGMODEL_H
+#define CATALOGMODEL_H
+
+class QTimer;
+
+#include <QtCore/QAbstractItemModel>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+
+#include "queryexecutor.h"
+
+/*!
+ * Lazily loaded tree of connections, databases, schemes and relations.
+ * A connection lists its databases and a database loads its catalog only
+ * when the node is expanded. Nodes are small structs holding a kind, an
+ * OID and an index into a pool of interned names.
+ * The tree is restored from CatalogCache at startup and revalidated in the
+ * background by per-scheme signatures over pg_namespace/pg_class xmin.
+ */
+class CatalogModel : public QAbstractItemModel
+{
+	Q_OBJECT
+
+public:
+	enum Kind {
+		ConnectionNode,
+		DatabasesNode,
+		DatabaseNode,
+		SchemesNode,
+		SchemeNode,
+		TablesNode,
+		TableNode,
+		ViewsNode,
+		ViewNode,
+		SequencesNode,
+		SequenceNode
+	};
+
+	explicit CatalogModel(QObject *parent = 0);
+	virtual ~CatalogModel();
+
+	void setConnections(const QStringList &connectionNames);
+	void closeConnection(const QString &connectionName);
+	void refresh(const QModelIndex &index);
+	void saveCache() const;
+
+	Kind kind(const QModelIndex &index) const;
+	quint32 oid(const QModelIndex &index) const;
+	QString name(const QModelIndex &index) const;
+	QString connectionName(const QModelIndex &index) const;
+	QString schemeName(const QModelIndex &index) const;
+	bool isLoaded(const QModelIndex &index) const;
+
+	virtual QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+	virtual QModelIndex parent(const QModelIndex &index) const;
+	virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
+	virtual int columnCount(const QModelIndex &parent = QModelIndex()) const;
+	virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+	virtual bool hasChildren(const QModelIndex &parent = QModelIndex()) const;
+	virtual bool canFetchMore(const QModelIndex &parent) const;
+	virtual void fetchMore(const QModelIndex &parent);
+
+Q_SIGNALS:
+	void connectionRequested(const QString &connectionName);
+	void connectionOpened(const QString &connectionName);
+	void errorOccurred(const QSqlError &error);
+	void schemesLoaded(const QString &connectionName, const QStringList &schemes);
+	void relationsLoaded(const QString &connectionName, const QString &scheme, const QStringList &relations);
+
+private Q_SLOTS:
+	void jobFinished(int jobId, const QueryResult &result);
+	void nextBusyFrame();
+
+private:
+	Q_DISABLE_COPY(CatalogModel)
+
+	enum State {
+		NotLoaded,
+		Loading,
+		Cached,
+		Loaded
+	};
+
+	enum LoadType {
+		LoadDatabases,
+		LoadCatalog,
+		LoadSignatures,
+		LoadSchemes
+	};
+
+	struct Node {
+		Node *parent;
+		QVector<Node *> children;
+		quint32 oid;
+		quint32 name;
+		int row;
+		quint8 kind;
+		quint8 state;
+	};
+
+	struct NodeKey {
+		NodeKey(const Node *scope, quint8 kind, quint32 oid)
+			: scope(scope), kind(kind), oid(oid) {}
+
+		bool operator==(const NodeKey &other) const {
+			return scope == other.scope && kind == other.kind && oid == other.oid;
+		}
+
+		friend uint qHash(const NodeKey &key) {
+			return qHash(key.scope) ^ (uint(key.kind) << 27) ^ key.oid;
+		}
+
+		const Node *scope;
+		quint8 kind;
+		quint32 oid;
+	};
+
+	struct CatalogObject {
+		CatalogObject(quint32 oid, const QString &name)
+			: oid(oid), name(name) {}
+
+		quint32 oid;
+		QString name;
+	};
+
+	struct SchemeData {
+		SchemeData(quint32 oid, const QString &name, qint64 signature)
+			: scheme(oid, name), signature(signature) {}
+
+		CatalogObject scheme;
+		qint64 signature;
+		QList<CatalogObject> tables;
+		QList<CatalogObject> views;
+		QList<CatalogObject> sequences;
+	};
+
+	struct PendingLoad {
+		PendingLoad()
+			: node(0), type(LoadDatabases) {}
+		PendingLoad(Node *node, LoadType type)
+			: node(node), type(type) {}
+
+		Node *node;
+		LoadType type;
+	};
+
+	Node *node(const QModelIndex &index) const;
+	QModelIndex indexOf(Node *node) const;
+	Node *scopeOf(Node *node) const;
+	QString connectionName(Node *node) const;
+	quint32 intern(const QString &name);
+
+	Node *createNode(Node *parent, Kind kind, quint32 oid, const QString &name);
+	Node *folder(Node *parent, Kind kind);
+	void syncChildren(Node *parent, Kind kind, const QList<CatalogObject> &objects);
+	void removeRow(Node *parent, int row);
+	void removeRows(Node *parent, int row, int count);
+	static void renumberChildren(Node *parent);
+	void removeChildren(Node *node);
+	void deleteNode(Node *node);
+	void removePendingLoads(Node *node);
+	void unload(Node *node);
+	void setState(Node *node, State state);
+
+	void load(Node *node);
+	void validate(Node *node);
+	bool submit(Node *node, LoadType type, const QueryJob &job);
+	void populateDatabases(Node *node, const QueryResult &result);
+	bool populateSignatures(Node *node, const QueryResult &result);
+	void populateSchemes(Node *node, const QList<SchemeData> &schemes, bool isPatch);
+	static QList<SchemeData> schemesOf(const QueryResult &result);
+
+	void restoreCache(Node *node);
+
+private:
+	Node *m_root;
+	QStringList m_names;
+	QHash<QString, quint32> m_nameIds;
+	QHash<NodeKey, Node *> m_index;
+	QHash<int, PendingLoad> m_pendingLoads;
+	QHash<const Node *, qint64> m_signatures;
+
+	QTimer *m_busyTimer;
+	int m_busyFrame;
+	QSet<Node *> m_busyNodes;
+};
+
+#endif //CATALOGMODEL_H
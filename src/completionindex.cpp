@@ -0,0 +1,466 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#include <QtCore/QTimer>
+
+#include <QtSql/QSqlDatabase>
+
+#include <algorithm>
+#include <iterator>
+
+#include "completionindex.h"
+
+static const char columnsQuery[] = "SELECT n.nspname, c.relname, a.attname "
+								   "FROM pg_attribute a "
+								   "JOIN pg_class c ON c.oid = a.attrelid "
+								   "JOIN pg_namespace n ON n.oid = c.relnamespace "
+								   "WHERE a.attnum > 0 AND NOT a.attisdropped AND c.relkind IN ('r', 'v', 'm', 'f', 'p')%1";
+static const char functionsQuery[] = "SELECT DISTINCT n.nspname, p.proname "
+									 "FROM pg_proc p "
+									 "JOIN pg_namespace n ON n.oid = p.pronamespace "
+									 "WHERE n.nspname <> 'pg_toast'%1";
+
+namespace
+{
+	class KeyLess
+	{
+	public:
+		explicit KeyLess(const QStringList &keys)
+			: m_keys(keys) {}
+
+		bool operator()(int left, int right) const {
+			const int result = m_keys.at(left).compare(m_keys.at(right));
+			return result < 0 || (result == 0 && left < right);
+		}
+
+		bool operator()(int id, const QString &prefix) const {
+			return m_keys.at(id) < prefix;
+		}
+
+		bool operator()(const QString &prefix, int id) const {
+			return prefix < m_keys.at(id);
+		}
+
+	private:
+		const QStringList &m_keys;
+	};
+}
+
+CompletionIndex *CompletionIndex::s_instance = 0;
+
+CompletionIndex::CompletionIndex(QObject *parent)
+	: QObject(parent)
+{
+}
+
+CompletionIndex *CompletionIndex::instance()
+{
+	if (!s_instance) {
+		s_instance = new CompletionIndex();
+	}
+
+	return s_instance;
+}
+
+void CompletionIndex::prepare(const QString &connectionName)
+{
+	Catalog &catalog = m_catalogs [connectionName];
+
+	if (catalog.isDetailsRequested || !QSqlDatabase::contains(connectionName)) {
+		return;
+	}
+
+	catalog.isDetailsRequested = true;
+	loadDetails(connectionName, QStringList());
+}
+
+bool CompletionIndex::hasScheme(const QString &connectionName, const QString &scheme) const
+{
+	QHash<QString, Catalog>::const_iterator it = m_catalogs.constFind(connectionName);
+	return it != m_catalogs.constEnd() && it.value().schemes.contains(nameId(scheme));
+}
+
+bool CompletionIndex::hasRelation(const QString &connectionName, const QString &scheme, const QString &relation) const
+{
+	QHash<QString, Catalog>::const_iterator it = m_catalogs.constFind(connectionName);
+	if (it == m_catalogs.constEnd()) {
+		return false;
+	}
+
+	const int id = nameId(relation);
+	const Scheme *s = schemeOf(it.value(), scheme, id);
+	return s && contains(*s, id);
+}
+
+QStringList CompletionIndex::schemes(const QString &connectionName, const QString &prefix, int limit) const
+{
+	QStringList result;
+	lookup(m_catalogs.value(connectionName).schemeIds, prefix, limit, &result);
+	return result;
+}
+
+QStringList CompletionIndex::relations(const QString &connectionName, const QString &scheme, const QString &prefix, int limit) const
+{
+	QStringList result;
+	QHash<QString, Catalog>::const_iterator it = m_catalogs.constFind(connectionName);
+	if (it == m_catalogs.constEnd()) {
+		return result;
+	}
+
+	if (scheme.isEmpty()) {
+		lookup(it.value().relations, prefix, limit, &result);
+	} else {
+		lookup(it.value().schemes.value(nameId(scheme)).relations, prefix, limit, &result);
+	}
+
+	return result;
+}
+
+QStringList CompletionIndex::columns(const QString &connectionName, const QString &scheme, const QString &relation,
+									 const QString &prefix, int limit) const
+{
+	QStringList result;
+	QHash<QString, Catalog>::const_iterator it = m_catalogs.constFind(connectionName);
+	if (it == m_catalogs.constEnd()) {
+		return result;
+	}
+
+	const int id = nameId(relation);
+	if (const Scheme *s = schemeOf(it.value(), scheme, id)) {
+		lookup(s->columns.value(id), prefix, limit, &result);
+	}
+
+	return result;
+}
+
+QStringList CompletionIndex::functions(const QString &connectionName, const QString &scheme, const QString &prefix, int limit) const
+{
+	QStringList result;
+	QHash<QString, Catalog>::const_iterator it = m_catalogs.constFind(connectionName);
+	if (it == m_catalogs.constEnd()) {
+		return result;
+	}
+
+	if (scheme.isEmpty()) {
+		lookup(it.value().functions, prefix, limit, &result);
+	} else {
+		lookup(it.value().schemes.value(nameId(scheme)).functions, prefix, limit, &result);
+	}
+
+	return result;
+}
+
+void CompletionIndex::setSchemes(const QString &connectionName, const QStringList &schemes)
+{
+	Catalog &catalog = m_catalogs [connectionName];
+	const QVector<int> &ids = sortedIds(schemes);
+
+	QVector<int> removed;
+	std::set_difference(catalog.schemeIds.constBegin(), catalog.schemeIds.constEnd(), ids.constBegin(), ids.constEnd(),
+						std::back_inserter(removed), KeyLess(m_keys));
+
+	foreach(int id, removed) {
+		Scheme &scheme = catalog.schemes [id];
+		setMembers(&scheme.relations, QVector<int>(), &catalog.relations, &catalog.relationRefs);
+		setMembers(&scheme.functions, QVector<int>(), &catalog.functions, &catalog.functionRefs);
+		catalog.schemes.remove(id);
+	}
+
+	catalog.schemeIds = ids;
+}
+
+void CompletionIndex::setRelations(const QString &connectionName, const QString &scheme, const QStringList &relations)
+{
+	Catalog &catalog = m_catalogs [connectionName];
+	setMembers(&catalog.schemes [intern(scheme)].relations, sortedIds(relations), &catalog.relations, &catalog.relationRefs);
+
+	if (!catalog.isDetailsRequested) {
+		return;
+	}
+
+	// A load of a whole catalog reports every scheme, one query does for all of them
+	if (m_changedSchemes.isEmpty()) {
+		QTimer::singleShot(0, this, SLOT(loadChanged()));
+	}
+	m_changedSchemes [connectionName] << scheme;
+}
+
+void CompletionIndex::loadChanged()
+{
+	const QHash<QString, QSet<QString> > changedSchemes = m_changedSchemes;
+	m_changedSchemes.clear();
+
+	for (QHash<QString, QSet<QString> >::const_iterator it = changedSchemes.constBegin(); it != changedSchemes.constEnd(); ++it) {
+		bool isLoadingAll = false;
+		foreach(const PendingJob & job, m_pendingJobs) {
+			isLoadingAll = isLoadingAll || (job.connectionName == it.key() && job.schemes.isEmpty());
+		}
+
+		if (!isLoadingAll) {
+			loadDetails(it.key(), it.value().toList());
+		}
+	}
+}
+
+void CompletionIndex::jobFinished(int jobId, const QueryResult &result)
+{
+	if (!m_pendingJobs.contains(jobId)) {
+		return;
+	}
+
+	const PendingJob job = m_pendingJobs.take(jobId);
+	QHash<QString, Catalog>::iterator it = m_catalogs.find(job.connectionName);
+	if (it == m_catalogs.end()) {
+		return;
+	}
+
+	if (result.error.isValid()) {
+		// Tried again on the next completion
+		if (job.schemes.isEmpty()) {
+			it.value().isDetailsRequested = false;
+		}
+		return;
+	}
+
+	if (job.isColumns) {
+		populateColumns(&it.value(), job.schemes, result.rows);
+	} else {
+		populateFunctions(&it.value(), job.schemes, result.rows);
+	}
+}
+
+int CompletionIndex::intern(const QString &name)
+{
+	QHash<QString, int>::const_iterator it = m_nameIds.constFind(name);
+	if (it != m_nameIds.constEnd()) {
+		return it.value();
+	}
+
+	const int id = m_names.size();
+	m_names << name;
+	m_keys << name.toLower();
+	m_nameIds.insert(name, id);
+	return id;
+}
+
+int CompletionIndex::nameId(const QString &name) const
+{
+	// Unquoted identifiers are folded to lower case by the server
+	QHash<QString, int>::const_iterator it = m_nameIds.constFind(name);
+	if (it == m_nameIds.constEnd()) {
+		it = m_nameIds.constFind(name.toLower());
+	}
+
+	return it != m_nameIds.constEnd() ? it.value() : -1;
+}
+
+QVector<int> CompletionIndex::sortedIds(const QStringList &names)
+{
+	QVector<int> ids;
+	ids.reserve(names.size());
+
+	foreach(const QString & name, names) {
+		ids << intern(name);
+	}
+
+	sortIds(&ids);
+	ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+	return ids;
+}
+
+void CompletionIndex::sortIds(QVector<int> *ids) const
+{
+	std::sort(ids->begin(), ids->end(), KeyLess(m_keys));
+}
+
+void CompletionIndex::setMembers(QVector<int> *members, const QVector<int> &ids, QVector<int> *all, QHash<int, int> *refs)
+{
+	// Only the difference touches the union of all schemes, with one merge
+	QVector<int> removed;
+	QVector<int> added;
+	std::set_difference(members->constBegin(), members->constEnd(), ids.constBegin(), ids.constEnd(),
+						std::back_inserter(removed), KeyLess(m_keys));
+	std::set_difference(ids.constBegin(), ids.constEnd(), members->constBegin(), members->constEnd(),
+						std::back_inserter(added), KeyLess(m_keys));
+
+	QVector<int> erased;
+	foreach(int id, removed) {
+		if (--(*refs) [id] == 0) {
+			refs->remove(id);
+			erased << id;
+		}
+	}
+
+	QVector<int> inserted;
+	foreach(int id, added) {
+		if ((*refs) [id]++ == 0) {
+			inserted << id;
+		}
+	}
+
+	if (!erased.isEmpty() || !inserted.isEmpty()) {
+		QVector<int> kept;
+		kept.reserve(all->size() - erased.size());
+		std::set_difference(all->constBegin(), all->constEnd(), erased.constBegin(), erased.constEnd(),
+							std::back_inserter(kept), KeyLess(m_keys));
+
+		all->resize(kept.size() + inserted.size());
+		std::merge(kept.constBegin(), kept.constEnd(), inserted.constBegin(), inserted.constEnd(),
+				   all->begin(), KeyLess(m_keys));
+	}
+
+	*members = ids;
+}
+
+void CompletionIndex::lookup(const QVector<int> &ids, const QString &prefix, int limit, QStringList *result) const
+{
+	const QString &key = prefix.toLower();
+	QVector<int>::const_iterator it = std::lower_bound(ids.constBegin(), ids.constEnd(), key, KeyLess(m_keys));
+
+	for (; it != ids.constEnd() && result->size() < limit && m_keys.at(*it).startsWith(key); ++it) {
+		*result << m_names.at(*it);
+	}
+}
+
+void CompletionIndex::loadDetails(const QString &connectionName, const QStringList &schemes)
+{
+	QueryExecutor *executor = QueryExecutor::executor(connectionName);
+	connect(executor, SIGNAL(jobFinished(int, QueryResult)), this, SLOT(jobFinished(int, QueryResult)), Qt::UniqueConnection);
+
+	const QString &filter = schemes.isEmpty() ? QString() : QString(" AND n.nspname = ANY (CAST(? AS text[]))");
+
+	PendingJob pending;
+	pending.connectionName = connectionName;
+	pending.schemes = schemes;
+
+	QueryJob columnsJob(QString(columnsQuery).arg(filter));
+	QueryJob functionsJob(QString(functionsQuery).arg(filter));
+	if (!schemes.isEmpty()) {
+		QStringList elements;
+		foreach(QString scheme, schemes) {
+			elements << "\"" + scheme.replace('\\', "\\\\").replace('"', "\\\"") + "\"";
+		}
+		columnsJob.bindValues << "{" + elements.join(",") + "}";
+		functionsJob.bindValues << columnsJob.bindValues;
+	}
+	columnsJob.priority = QueryJob::LowPriority;
+	functionsJob.priority = QueryJob::LowPriority;
+
+	pending.isColumns = true;
+	m_pendingJobs.insert(executor->submit(columnsJob), pending);
+	pending.isColumns = false;
+	m_pendingJobs.insert(executor->submit(functionsJob), pending);
+}
+
+void CompletionIndex::populateColumns(Catalog *catalog, const QStringList &schemes, const ResultChunk &rows)
+{
+	QHash<int, QHash<int, QVector<int> > > columns;
+
+	for (int row = 0, count = rows.rowCount(); row < count; row++) {
+		columns [intern(rows.value(row, 0).toString())] [intern(rows.value(row, 1).toString())]
+				<< intern(rows.value(row, 2).toString());
+	}
+
+	if (schemes.isEmpty()) {
+		for (QHash<int, Scheme>::iterator it = catalog->schemes.begin(); it != catalog->schemes.end(); ++it) {
+			it.value().columns.clear();
+		}
+	} else {
+		foreach(const QString & scheme, schemes) {
+			catalog->schemes [intern(scheme)].columns.clear();
+		}
+	}
+
+	for (QHash<int, QHash<int, QVector<int> > >::iterator it = columns.begin(); it != columns.end(); ++it) {
+		Scheme &s = catalog->schemes [it.key()];
+
+		for (QHash<int, QVector<int> >::iterator relation = it.value().begin(); relation != it.value().end(); ++relation) {
+			sortIds(&relation.value());
+			s.columns.insert(relation.key(), relation.value());
+		}
+	}
+}
+
+void CompletionIndex::populateFunctions(Catalog *catalog, const QStringList &schemes, const ResultChunk &rows)
+{
+	QHash<int, QVector<int> > functions;
+
+	for (int row = 0, count = rows.rowCount(); row < count; row++) {
+		functions [intern(rows.value(row, 0).toString())] << intern(rows.value(row, 1).toString());
+	}
+
+	QList<int> schemeIds;
+	if (schemes.isEmpty()) {
+		schemeIds = catalog->schemes.keys();
+	} else {
+		foreach(const QString & scheme, schemes) {
+			schemeIds << intern(scheme);
+		}
+	}
+
+	foreach(int id, functions.keys()) {
+		if (!schemeIds.contains(id)) {
+			schemeIds << id;
+		}
+	}
+
+	foreach(int id, schemeIds) {
+		QVector<int> ids = functions.value(id);
+		sortIds(&ids);
+		setMembers(&catalog->schemes [id].functions, ids, &catalog->functions, &catalog->functionRefs);
+	}
+}
+
+bool CompletionIndex::contains(const Scheme &scheme, int relation) const
+{
+	return scheme.columns.contains(relation)
+		   || std::binary_search(scheme.relations.constBegin(), scheme.relations.constEnd(), relation, KeyLess(m_keys));
+}
+
+const CompletionIndex::Scheme *CompletionIndex::schemeOf(const Catalog &catalog, const QString &scheme, int relation) const
+{
+	if (!scheme.isEmpty()) {
+		QHash<int, Scheme>::const_iterator it = catalog.schemes.constFind(nameId(scheme));
+		return it != catalog.schemes.constEnd() ? &it.value() : 0;
+	}
+
+	if (relation < 0) {
+		return 0;
+	}
+
+	// Unqualified names are looked up in public first, as in the default search_path
+	QHash<int, Scheme>::const_iterator it = catalog.schemes.constFind(nameId("public"));
+	if (it != catalog.schemes.constEnd() && contains(it.value(), relation)) {
+		return &it.value();
+	}
+
+	for (it = catalog.schemes.constBegin(); it != catalog.schemes.constEnd(); ++it) {
+		if (contains(it.value(), relation)) {
+			return &it.value();
+		}
+	}
+
+	return 0;
+}
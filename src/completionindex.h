@@ -0,0 +1,125 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#ifndef COMPLETIONINDEX_H
+#define COMPLETIONINDEX_H
+
+#include <QtCore/QObject>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+
+#include "queryexecutor.h"
+
+/*!
+ * Names for SQL completion, per connection. Schemes and relations come
+ * from CatalogModel as it loads or patches a scheme; columns and functions
+ * are read on the first completion in an editor of the connection and
+ * afterwards reloaded only for the schemes CatalogModel reports as loaded
+ * again, batched into one query per connection.
+ * Names are interned once and kept in id vectors sorted by the lower case
+ * name, so a prefix lookup is a binary search.
+ */
+class CompletionIndex : public QObject
+{
+	Q_OBJECT
+
+public:
+	static CompletionIndex *instance();
+
+	void prepare(const QString &connectionName);
+
+	bool hasScheme(const QString &connectionName, const QString &scheme) const;
+	bool hasRelation(const QString &connectionName, const QString &scheme, const QString &relation) const;
+	QStringList schemes(const QString &connectionName, const QString &prefix, int limit) const;
+	QStringList relations(const QString &connectionName, const QString &scheme, const QString &prefix, int limit) const;
+	QStringList columns(const QString &connectionName, const QString &scheme, const QString &relation,
+						const QString &prefix, int limit) const;
+	QStringList functions(const QString &connectionName, const QString &scheme, const QString &prefix, int limit) const;
+
+public Q_SLOTS:
+	void setSchemes(const QString &connectionName, const QStringList &schemes);
+	void setRelations(const QString &connectionName, const QString &scheme, const QStringList &relations);
+
+private Q_SLOTS:
+	void jobFinished(int jobId, const QueryResult &result);
+	void loadChanged();
+
+private:
+	explicit CompletionIndex(QObject *parent = 0);
+	Q_DISABLE_COPY(CompletionIndex)
+
+	struct Scheme {
+		QVector<int> relations;
+		QVector<int> functions;
+		QHash<int, QVector<int> > columns;
+	};
+
+	// Every vector of ids is sorted by the lower case name, then by id
+	struct Catalog {
+		Catalog()
+			: isDetailsRequested(false) {}
+
+		QHash<int, Scheme> schemes;
+		QVector<int> schemeIds;
+		QVector<int> relations;
+		QHash<int, int> relationRefs;
+		QVector<int> functions;
+		QHash<int, int> functionRefs;
+		bool isDetailsRequested;
+	};
+
+	// No schemes means all of them
+	struct PendingJob {
+		QString connectionName;
+		QStringList schemes;
+		bool isColumns;
+	};
+
+	int intern(const QString &name);
+	int nameId(const QString &name) const;
+	QVector<int> sortedIds(const QStringList &names);
+	void sortIds(QVector<int> *ids) const;
+	void setMembers(QVector<int> *members, const QVector<int> &ids, QVector<int> *all, QHash<int, int> *refs);
+	void lookup(const QVector<int> &ids, const QString &prefix, int limit, QStringList *result) const;
+	void loadDetails(const QString &connectionName, const QStringList &schemes);
+	void populateColumns(Catalog *catalog, const QStringList &schemes, const ResultChunk &rows);
+	void populateFunctions(Catalog *catalog, const QStringList &schemes, const ResultChunk &rows);
+	bool contains(const Scheme &scheme, int relation) const;
+	const Scheme *schemeOf(const Catalog &catalog, const QString &scheme, int relation) const;
+
+private:
+	QStringList m_names;
+	QStringList m_keys;
+	QHash<QString, int> m_nameIds;
+	QHash<QString, Catalog> m_catalogs;
+	QHash<int, PendingJob> m_pendingJobs;
+	QHash<QString, QSet<QString> > m_changedSchemes;
+
+	static CompletionIndex *s_instance;
+};
+
+#endif //COMPLETIONINDEX_H
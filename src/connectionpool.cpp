@@ -0,0 +1,348 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#include <QtCore/QSettings>
+#include <QtCore/QTimer>
+
+#include "connectionpool.h"
+
+static const int maintenanceInterval = 5000;
+
+QHash<QString, ConnectionPool *> ConnectionPool::s_pools;
+
+PoolStatistics::PoolStatistics()
+	: size(0)
+	, checkedOut(0)
+	, checkouts(0)
+	, sharedCheckouts(0)
+	, waitTime(0)
+	, reconnects(0)
+	, healthChecks(0)
+	, failedHealthChecks(0)
+	, reaped(0)
+	, preparedHits(0)
+	, preparedMisses(0)
+	, preparedTimeSaved(0)
+{
+
+}
+
+ConnectionPool::ConnectionPool(const QString &connectionName, QObject *parent)
+	: QObject(parent)
+	, m_connectionName(connectionName)
+	, m_checkouts(0)
+	, m_sharedCheckouts(0)
+	, m_healthCheckCount(0)
+	, m_failedHealthChecks(0)
+	, m_reaped(0)
+	, m_reapedWaitTime(0)
+	, m_reapedReconnects(0)
+	, m_reapedPreparedHits(0)
+	, m_reapedPreparedMisses(0)
+	, m_reapedPreparedTimeSaved(0)
+{
+	QSettings settings;
+
+	settings.beginGroup("ConnectionPool");
+	m_minSize = qMax(settings.value("MinSize", 0).toInt(), 0);
+	m_maxSize = qMax(settings.value("MaxSize", 4).toInt(), 1);
+	m_idleTimeout = settings.value("IdleTimeout", 300).toInt() * 1000;
+	m_healthCheckInterval = settings.value("HealthCheckInterval", 60).toInt() * 1000;
+	settings.endGroup();
+
+	m_timer = new QTimer(this);
+	m_timer->setInterval(maintenanceInterval);
+	connect(m_timer, SIGNAL(timeout()), this, SLOT(maintain()));
+	m_timer->start();
+
+	maintain();
+}
+
+ConnectionPool::~ConnectionPool()
+{
+	foreach(Entry * entry, m_entries) {
+		if (entry->owners > 0) {
+			// Still used by a widget, it is deleted by release()
+			entry->executor->setParent(0);
+		} else {
+			delete entry->executor;
+		}
+		delete entry;
+	}
+}
+
+ConnectionPool *ConnectionPool::pool(const QString &connectionName)
+{
+	ConnectionPool *pool = s_pools.value(connectionName);
+
+	if (!pool) {
+		pool = new ConnectionPool(connectionName);
+		s_pools.insert(connectionName, pool);
+	}
+
+	return pool;
+}
+
+void ConnectionPool::closePools(const QString &connectionName)
+{
+	foreach(const QString & name, s_pools.keys()) {
+		if (connectionName.isEmpty() || name == connectionName || name.startsWith(connectionName + ".")) {
+			delete s_pools.take(name);
+		}
+	}
+}
+
+void ConnectionPool::release(QueryExecutor *executor)
+{
+	ConnectionPool *pool = s_pools.value(executor->connectionName());
+
+	if (pool && pool->entryOf(executor)) {
+		pool->checkIn(executor);
+	} else {
+		executor->deleteLater();
+	}
+}
+
+QStringList ConnectionPool::connectionNames()
+{
+	QStringList result = s_pools.keys();
+	result.sort();
+	return result;
+}
+
+QString ConnectionPool::connectionName() const
+{
+	return m_connectionName;
+}
+
+int ConnectionPool::minSize() const
+{
+	return m_minSize;
+}
+
+void ConnectionPool::setMinSize(int minSize)
+{
+	m_minSize = qMax(minSize, 0);
+}
+
+int ConnectionPool::maxSize() const
+{
+	return m_maxSize;
+}
+
+void ConnectionPool::setMaxSize(int maxSize)
+{
+	m_maxSize = qMax(maxSize, 1);
+}
+
+int ConnectionPool::idleTimeout() const
+{
+	return m_idleTimeout;
+}
+
+void ConnectionPool::setIdleTimeout(int msec)
+{
+	m_idleTimeout = msec;
+}
+
+int ConnectionPool::healthCheckInterval() const
+{
+	return m_healthCheckInterval;
+}
+
+void ConnectionPool::setHealthCheckInterval(int msec)
+{
+	m_healthCheckInterval = msec;
+
+	foreach(Entry * entry, m_entries) {
+		entry->executor->setIdleCheckInterval(msec);
+	}
+}
+
+QueryExecutor *ConnectionPool::checkOut()
+{
+	++m_checkouts;
+
+	Entry *entry = 0;
+	foreach(Entry * candidate, m_entries) {
+		if (candidate->owners == 0) {
+			entry = candidate;
+			break;
+		}
+	}
+
+	if (!entry && m_entries.size() < m_maxSize) {
+		entry = createEntry();
+	}
+
+	// A cursor holds its executor until the view has fetched it all, the
+	// jobs of another owner would wait behind it
+	if (!entry) {
+		foreach(Entry * candidate, m_entries) {
+			if (!candidate->executor->hasOpenCursor() && (!entry || candidate->owners < entry->owners)) {
+				entry = candidate;
+			}
+		}
+
+		if (entry) {
+			++m_sharedCheckouts;
+		} else {
+			entry = createEntry();
+		}
+	}
+
+	// A connection idle for longer than the check interval may have been
+	// dropped by the server; the ping runs before the caller's first job
+	// and the executor reconnects if it fails.
+	if (entry->owners == 0 && entry->checkTimer.elapsed() > m_healthCheckInterval) {
+		healthCheck(entry, QueryJob::HighPriority);
+	}
+
+	++entry->owners;
+	return entry->executor;
+}
+
+void ConnectionPool::checkIn(QueryExecutor *executor)
+{
+	Entry *entry = entryOf(executor);
+
+	if (entry && entry->owners > 0 && --entry->owners == 0) {
+		entry->idleTimer.start();
+	}
+}
+
+PoolStatistics ConnectionPool::statistics() const
+{
+	PoolStatistics statistics;
+
+	statistics.size = m_entries.size();
+	statistics.checkouts = m_checkouts;
+	statistics.sharedCheckouts = m_sharedCheckouts;
+	statistics.waitTime = m_reapedWaitTime;
+	statistics.reconnects = m_reapedReconnects;
+	statistics.healthChecks = m_healthCheckCount;
+	statistics.failedHealthChecks = m_failedHealthChecks;
+	statistics.reaped = m_reaped;
+	statistics.preparedHits = m_reapedPreparedHits;
+	statistics.preparedMisses = m_reapedPreparedMisses;
+	statistics.preparedTimeSaved = m_reapedPreparedTimeSaved;
+
+	foreach(const Entry * entry, m_entries) {
+		if (entry->owners > 0) {
+			++statistics.checkedOut;
+		}
+		statistics.waitTime += entry->executor->waitTime();
+		statistics.reconnects += entry->executor->reconnects();
+		statistics.preparedHits += entry->executor->preparedHits();
+		statistics.preparedMisses += entry->executor->preparedMisses();
+		statistics.preparedTimeSaved += entry->executor->preparedTimeSaved();
+	}
+
+	return statistics;
+}
+
+void ConnectionPool::maintain()
+{
+	foreach(Entry * entry, m_entries) {
+		if (entry->owners > 0 || m_healthChecks.values().contains(entry->executor)) {
+			continue;
+		}
+
+		if (entry->idleTimer.elapsed() > m_idleTimeout && m_entries.size() > m_minSize) {
+			++m_reaped;
+			removeEntry(entry);
+		} else if (entry->checkTimer.elapsed() > m_healthCheckInterval) {
+			healthCheck(entry, QueryJob::LowPriority);
+		}
+	}
+
+	while (m_entries.size() < qMin(m_minSize, m_maxSize)) {
+		healthCheck(createEntry(), QueryJob::LowPriority);
+	}
+}
+
+void ConnectionPool::healthCheckFinished(int jobId, const QueryResult &result)
+{
+	if (!m_healthChecks.contains(jobId)) {
+		return;
+	}
+
+	m_healthChecks.remove(jobId);
+
+	// The executor drops a broken connection itself, the next job reconnects
+	if (result.error.isValid()) {
+		++m_failedHealthChecks;
+	}
+}
+
+ConnectionPool::Entry *ConnectionPool::entryOf(QueryExecutor *executor) const
+{
+	foreach(Entry * entry, m_entries) {
+		if (entry->executor == executor) {
+			return entry;
+		}
+	}
+
+	return 0;
+}
+
+ConnectionPool::Entry *ConnectionPool::createEntry()
+{
+	Entry *entry = new Entry;
+	entry->executor = new QueryExecutor(m_connectionName, this);
+	entry->executor->setIdleCheckInterval(m_healthCheckInterval);
+	entry->owners = 0;
+	entry->idleTimer.start();
+	entry->checkTimer.start();
+
+	connect(entry->executor, SIGNAL(jobFinished(int, QueryResult)), this, SLOT(healthCheckFinished(int, QueryResult)));
+	entry->executor->start();
+
+	m_entries << entry;
+	return entry;
+}
+
+void ConnectionPool::removeEntry(Entry *entry)
+{
+	m_reapedWaitTime += entry->executor->waitTime();
+	m_reapedReconnects += entry->executor->reconnects();
+	m_reapedPreparedHits += entry->executor->preparedHits();
+	m_reapedPreparedMisses += entry->executor->preparedMisses();
+	m_reapedPreparedTimeSaved += entry->executor->preparedTimeSaved();
+
+	m_entries.removeOne(entry);
+	delete entry->executor;
+	delete entry;
+}
+
+void ConnectionPool::healthCheck(Entry *entry, int priority)
+{
+	QueryJob job("SELECT 1");
+	job.priority = priority;
+
+	m_healthChecks.insert(entry->executor->submit(job), entry->executor);
+	entry->checkTimer.start();
+	++m_healthCheckCount;
+}
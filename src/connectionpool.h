@@ -0,0 +1,140 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#ifndef CONNECTIONPOOL_H
+#define CONNECTIONPOOL_H
+
+class QTimer;
+
+#include <QtCore/QObject>
+#include <QtCore/QStringList>
+#include <QtCore/QList>
+#include <QtCore/QHash>
+#include <QtCore/QElapsedTimer>
+
+#include "queryexecutor.h"
+
+struct PoolStatistics {
+	PoolStatistics();
+
+	int size;
+	int checkedOut;
+	qint64 checkouts;
+	qint64 sharedCheckouts;
+	qint64 waitTime; // usec, time jobs spent queued behind other jobs
+	int reconnects;
+	int healthChecks;
+	int failedHealthChecks;
+	int reaped;
+	qint64 preparedHits;
+	qint64 preparedMisses;
+	qint64 preparedTimeSaved; // usec, estimated from the first run of each statement
+};
+
+/*!
+ * Set of QueryExecutor workers for one connection name.
+ * Widgets check an executor out while they need it and check it back in.
+ * Idle executors are pinged with SELECT 1 so a dead socket is dropped
+ * before the next job, and reaped after idleTimeout() above minSize().
+ * Checked out executors check their own connection before a job after
+ * healthCheckInterval() of idleness.
+ * When maxSize() executors are checked out the least used one without an
+ * open cursor is shared and its jobs wait in its queue; if every one holds
+ * a cursor the pool grows past maxSize() instead.
+ */
+class ConnectionPool : public QObject
+{
+	Q_OBJECT
+
+public:
+	static ConnectionPool *pool(const QString &connectionName);
+	static void closePools(const QString &connectionName = QString());
+	static void release(QueryExecutor *executor);
+	static QStringList connectionNames();
+
+	QString connectionName() const;
+
+	int minSize() const;
+	void setMinSize(int minSize);
+	int maxSize() const;
+	void setMaxSize(int maxSize);
+	int idleTimeout() const;
+	void setIdleTimeout(int msec);
+	int healthCheckInterval() const;
+	void setHealthCheckInterval(int msec);
+
+	QueryExecutor *checkOut();
+	void checkIn(QueryExecutor *executor);
+
+	PoolStatistics statistics() const;
+
+private Q_SLOTS:
+	void maintain();
+	void healthCheckFinished(int jobId, const QueryResult &result);
+
+private:
+	Q_DISABLE_COPY(ConnectionPool)
+
+	explicit ConnectionPool(const QString &connectionName, QObject *parent = 0);
+	virtual ~ConnectionPool();
+
+	struct Entry {
+		QueryExecutor *executor;
+		int owners;
+		QElapsedTimer idleTimer;
+		QElapsedTimer checkTimer;
+	};
+
+	Entry *entryOf(QueryExecutor *executor) const;
+	Entry *createEntry();
+	void removeEntry(Entry *entry);
+	void healthCheck(Entry *entry, int priority);
+
+private:
+	QString m_connectionName;
+	int m_minSize;
+	int m_maxSize;
+	int m_idleTimeout;
+	int m_healthCheckInterval;
+
+	QList<Entry *> m_entries;
+	QHash<int, QueryExecutor *> m_healthChecks;
+	QTimer *m_timer;
+
+	qint64 m_checkouts;
+	qint64 m_sharedCheckouts;
+	int m_healthCheckCount;
+	int m_failedHealthChecks;
+	int m_reaped;
+	qint64 m_reapedWaitTime;
+	int m_reapedReconnects;
+	qint64 m_reapedPreparedHits;
+	qint64 m_reapedPreparedMisses;
+	qint64 m_reapedPreparedTimeSaved;
+
+	static QHash<QString, ConnectionPool *> s_pools;
+};
+
+#endif //CONNECTIONPOOL_H
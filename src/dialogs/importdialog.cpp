@@ -0,0 +1,332 @@
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSettings>
+
+#include <QtGui/QLabel>
+#include <QtGui/QDialogButtonBox>
+#include <QtGui/QLineEdit>
+#include <QtGui/QComboBox>
+#include <QtGui/QCheckBox>
+#include <QtGui/QPushButton>
+#include <QtGui/QTableWidget>
+#include <QtGui/QHeaderView>
+#include <QtGui/QProgressBar>
+#include <QtGui/QFileDialog>
+#include <QtGui/QMessageBox>
+#include <QtGui/QLayout>
+
+#include "importdialog.h"
+#include "connectionpool.h"
+#include "tablemodel.h"
+
+static const int maxHeaderLength = 64 * 1024;
+
+ImportDialog::ImportDialog(const QString &connectionName, const QString &tableName, QWidget *parent)
+	: QDialog(parent)
+	, tableName(tableName)
+	, columnsJobId(0)
+	, importJobId(0)
+	, isImported(false)
+	, fileSize(0)
+{
+	setWindowTitle(tr("Import into %1").arg(tableName));
+
+	fileNameEdit = new QLineEdit(this);
+	connect(fileNameEdit, SIGNAL(editingFinished()), this, SLOT(updateMapping()));
+
+	browseButton = new QPushButton(tr("Browse..."), this);
+	connect(browseButton, SIGNAL(clicked()), this, SLOT(browse()));
+
+	formatEdit = new QComboBox(this);
+	formatEdit->addItem(tr("CSV"));
+	formatEdit->addItem(tr("Tab separated"));
+	connect(formatEdit, SIGNAL(currentIndexChanged(int)), this, SLOT(updateMapping()));
+
+	headerBox = new QCheckBox(tr("The first line is a header"), this);
+	headerBox->setChecked(true);
+	connect(headerBox, SIGNAL(toggled(bool)), this, SLOT(updateMapping()));
+
+	mappingView = new QTableWidget(this);
+	mappingView->setColumnCount(2);
+	mappingView->setHorizontalHeaderLabels(QStringList() << tr("File column") << tr("Table column"));
+	mappingView->horizontalHeader()->setStretchLastSection(true);
+	mappingView->verticalHeader()->hide();
+
+	progressBar = new QProgressBar(this);
+	progressBar->setRange(0, 1000);
+	progressBar->setValue(0);
+
+	statusLabel = new QLabel(this);
+
+	QDialogButtonBox *buttons = new QDialogButtonBox(Qt::Horizontal, this);
+	importButton = buttons->addButton(tr("Import"), QDialogButtonBox::ActionRole);
+	connect(importButton, SIGNAL(clicked()), this, SLOT(startImport()));
+	closeButton = buttons->addButton(QDialogButtonBox::Close);
+	connect(closeButton, SIGNAL(clicked()), this, SLOT(reject()));
+
+	QHBoxLayout *fileLayout = new QHBoxLayout();
+	fileLayout->addWidget(fileNameEdit);
+	fileLayout->addWidget(browseButton);
+
+	QGridLayout *gridLayout = new QGridLayout();
+	gridLayout->addWidget(new QLabel(tr("File"), this), 0, 0);
+	gridLayout->addLayout(fileLayout, 0, 1);
+	gridLayout->addWidget(new QLabel(tr("Format"), this), 1, 0);
+	gridLayout->addWidget(formatEdit, 1, 1);
+	gridLayout->addWidget(headerBox, 2, 1);
+
+	QVBoxLayout *mainLayout = new QVBoxLayout();
+	mainLayout->addLayout(gridLayout);
+	mainLayout->addWidget(mappingView);
+	mainLayout->addWidget(progressBar);
+	mainLayout->addWidget(statusLabel);
+	mainLayout->addWidget(buttons);
+	setLayout(mainLayout);
+
+	executor = ConnectionPool::pool(connectionName)->checkOut();
+	connect(executor, SIGNAL(jobFinished(int, QueryResult)), this, SLOT(jobFinished(int, QueryResult)));
+	connect(executor, SIGNAL(copyProgress(int, qint64, qint64)), this, SLOT(copyProgress(int, qint64, qint64)));
+
+	QueryJob job("SELECT attname FROM pg_attribute "
+				 "WHERE attrelid = ?::regclass AND attnum > 0 AND NOT attisdropped ORDER BY attnum");
+	job.bindValues << TableModel::escapeIdentifier(tableName);
+	job.priority = QueryJob::HighPriority;
+	columnsJobId = executor->submit(job);
+}
+
+ImportDialog::~ImportDialog()
+{
+	if (importJobId) {
+		executor->cancel(token);
+	}
+	disconnect(executor, 0, this, 0);
+	ConnectionPool::release(executor);
+}
+
+void ImportDialog::reject()
+{
+	if (importJobId) {
+		closeButton->setEnabled(false);
+		statusLabel->setText(tr("Cancelling the import..."));
+		executor->cancel(token);
+		return;
+	}
+
+	done(isImported ? QDialog::Accepted : QDialog::Rejected);
+}
+
+QChar ImportDialog::delimiter() const
+{
+	return formatEdit->currentIndex() == 0 ? QChar(',') : QChar('\t');
+}
+
+QStringList ImportDialog::fileColumns() const
+{
+	QFile file(fileNameEdit->text());
+	if (!file.open(QIODevice::ReadOnly)) {
+		return QStringList();
+	}
+
+	QString line = QString::fromUtf8(file.readLine(maxHeaderLength));
+	while (line.endsWith('\n') || line.endsWith('\r')) {
+		line.chop(1);
+	}
+
+	// Enough of CSV to read a header line: quoted fields with doubled quotes
+	QStringList fields;
+	QString field;
+	bool isQuoted = false;
+	for (int i = 0; i < line.size(); i++) {
+		const QChar c = line.at(i);
+		if (isQuoted) {
+			if (c == '"' && i + 1 < line.size() && line.at(i + 1) == '"') {
+				field += c;
+				++i;
+			} else if (c == '"') {
+				isQuoted = false;
+			} else {
+				field += c;
+			}
+		} else if (c == '"' && delimiter() == ',') {
+			isQuoted = true;
+		} else if (c == delimiter()) {
+			fields << field;
+			field.clear();
+		} else {
+			field += c;
+		}
+	}
+	fields << field;
+
+	if (!headerBox->isChecked()) {
+		for (int i = 0; i < fields.size(); i++) {
+			fields [i] = tr("Column %1").arg(i + 1);
+		}
+	}
+
+	return fields;
+}
+
+void ImportDialog::browse()
+{
+	QSettings settings;
+
+	const QString &fileName = QFileDialog::getOpenFileName(this,
+							  tr("Import file"),
+							  settings.value("ImportDialog/OpenPath", "").toString(),
+							  tr("CSV files (*.csv)\nText files (*.txt *.tsv)\nAll files (*.*)"));
+	if (fileName.isEmpty()) {
+		return;
+	}
+
+	settings.setValue("ImportDialog/OpenPath", QFileInfo(fileName).absolutePath());
+
+	fileNameEdit->setText(fileName);
+	if (fileName.endsWith(".tsv", Qt::CaseInsensitive) || fileName.endsWith(".txt", Qt::CaseInsensitive)) {
+		formatEdit->setCurrentIndex(1);
+	}
+	updateMapping();
+}
+
+void ImportDialog::updateMapping()
+{
+	const QStringList &columns = fileColumns();
+
+	mappingView->setRowCount(columns.size());
+	for (int row = 0; row < columns.size(); row++) {
+		mappingView->setItem(row, 0, new QTableWidgetItem(columns.at(row)));
+
+		QComboBox *columnEdit = new QComboBox(mappingView);
+		columnEdit->addItems(tableColumns);
+
+		int index = tableColumns.indexOf(columns.at(row));
+		for (int i = 0; index == -1 && i < tableColumns.size(); i++) {
+			if (tableColumns.at(i).compare(columns.at(row), Qt::CaseInsensitive) == 0) {
+				index = i;
+			}
+		}
+		if (index == -1 && !headerBox->isChecked()) {
+			index = row < tableColumns.size() ? row : -1;
+		}
+		columnEdit->setCurrentIndex(index);
+
+		mappingView->setCellWidget(row, 1, columnEdit);
+	}
+}
+
+QString ImportDialog::copyQuery(QString *error) const
+{
+	QStringList columns;
+
+	for (int row = 0; row < mappingView->rowCount(); row++) {
+		QComboBox *columnEdit = qobject_cast<QComboBox *> (mappingView->cellWidget(row, 1));
+		const QString &column = columnEdit ? columnEdit->currentText() : QString();
+
+		if (column.isEmpty()) {
+			*error = tr("Choose a table column for \"%1\"").arg(mappingView->item(row, 0)->text());
+			return QString();
+		}
+
+		const QString &escaped = "\"" + QString(column).replace('"', "\"\"") + "\"";
+		if (columns.contains(escaped)) {
+			*error = tr("The column \"%1\" is mapped twice").arg(column);
+			return QString();
+		}
+		columns << escaped;
+	}
+
+	if (columns.isEmpty()) {
+		*error = tr("The file has no columns");
+		return QString();
+	}
+
+	QString options = formatEdit->currentIndex() == 0 ? "FORMAT csv" : "FORMAT text";
+	if (headerBox->isChecked()) {
+		options += formatEdit->currentIndex() == 0 ? ", HEADER" : "";
+	}
+
+	return QString("COPY %1 (%2) FROM STDIN WITH (%3)")
+		   .arg(TableModel::escapeIdentifier(tableName))
+		   .arg(columns.join(", "))
+		   .arg(options);
+}
+
+void ImportDialog::startImport()
+{
+	QString error;
+	const QString &query = copyQuery(&error);
+	if (query.isEmpty()) {
+		QMessageBox::critical(this, "", error);
+		return;
+	}
+
+	if (formatEdit->currentIndex() == 1 && headerBox->isChecked()) {
+		QMessageBox::critical(this, "", tr("A header line is only supported for CSV files"));
+		return;
+	}
+
+	QueryJob job(query, QueryJob::CopyIn);
+	job.fileName = fileNameEdit->text();
+	token = job.token;
+	fileSize = QFileInfo(job.fileName).size();
+
+	importButton->setEnabled(false);
+	mappingView->setEnabled(false);
+	progressBar->setValue(0);
+	statusLabel->setText(tr("Importing..."));
+
+	time.start();
+	importJobId = executor->submit(job);
+}
+
+void ImportDialog::jobFinished(int jobId, const QueryResult &result)
+{
+	if (jobId == columnsJobId) {
+		columnsJobId = 0;
+		tableColumns.clear();
+		for (int row = 0; row < result.rows.rowCount(); row++) {
+			tableColumns << result.rows.value(row, 0).toString();
+		}
+		updateMapping();
+		if (result.error.isValid()) {
+			statusLabel->setText(result.error.text());
+		}
+		return;
+	}
+
+	if (jobId != importJobId)
+		return;
+
+	importJobId = 0;
+	importButton->setEnabled(true);
+	mappingView->setEnabled(true);
+	closeButton->setEnabled(true);
+
+	if (result.error.isValid()) {
+		statusLabel->setText(result.error.text());
+		return;
+	}
+
+	const double seconds = qMax(time.elapsed(), 1) / 1000.0;
+	progressBar->setValue(progressBar->maximum());
+	statusLabel->setText(tr("%1 rows imported in %2 s (%3 rows/s, %4 MB/s)")
+						 .arg(result.numRowsAffected)
+						 .arg(seconds, 0, 'f', 1)
+						 .arg(qRound64(result.numRowsAffected / seconds))
+						 .arg(fileSize / (1024.0 * 1024.0) / seconds, 0, 'f', 1));
+	isImported = true;
+}
+
+void ImportDialog::copyProgress(int jobId, qint64 bytes, qint64 rows)
+{
+	if (jobId != importJobId)
+		return;
+
+	const double seconds = qMax(time.elapsed(), 1) / 1000.0;
+	progressBar->setValue(fileSize > 0 ? int(bytes * 1000 / fileSize) : 0);
+	statusLabel->setText(tr("~%1 rows, %2 MB, %3 rows/s, %4 MB/s")
+						 .arg(rows)
+						 .arg(bytes / (1024.0 * 1024.0), 0, 'f', 1)
+						 .arg(qRound64(rows / seconds))
+						 .arg(bytes / (1024.0 * 1024.0) / seconds, 0, 'f', 1));
+}
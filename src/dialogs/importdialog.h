@@ -0,0 +1,67 @@
+#ifndef ImportDialog_H
+#define ImportDialog_H
+
+class QLineEdit;
+class QComboBox;
+class QCheckBox;
+class QTableWidget;
+class QProgressBar;
+class QPushButton;
+class QLabel;
+
+#include <QtCore/QStringList>
+#include <QtCore/QTime>
+
+#include <QtGui/QDialog>
+
+#include "queryexecutor.h"
+
+/*!
+ * Streams a CSV or tab separated file into a table with COPY FROM STDIN.
+ * Every file column is mapped to a table column; the file itself is sent
+ * unchanged, so the import runs at COPY speed.
+ */
+class ImportDialog : public QDialog
+{
+	Q_OBJECT
+
+private:
+	QLineEdit *fileNameEdit;
+	QPushButton *browseButton;
+	QComboBox *formatEdit;
+	QCheckBox *headerBox;
+	QTableWidget *mappingView;
+	QProgressBar *progressBar;
+	QLabel *statusLabel;
+	QPushButton *importButton;
+	QPushButton *closeButton;
+
+	QString tableName;
+	QStringList tableColumns;
+	QueryExecutor *executor;
+	CancellationToken token;
+	int columnsJobId;
+	int importJobId;
+	bool isImported;
+	qint64 fileSize;
+	QTime time;
+
+public:
+	ImportDialog(const QString &connectionName, const QString &tableName, QWidget *parent = 0);
+	virtual ~ImportDialog();
+
+	virtual void reject();
+
+private:
+	QChar delimiter() const;
+	QStringList fileColumns() const;
+	QString copyQuery(QString *error) const;
+
+private Q_SLOTS:
+	void browse();
+	void updateMapping();
+	void startImport();
+	void jobFinished(int jobId, const QueryResult &result);
+	void copyProgress(int jobId, qint64 bytes, qint64 rows);
+};
+#endif
@@ -0,0 +1,220 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#include <QtCore/QObject>
+#include <QtCore/QXmlStreamReader>
+
+#include "explainplan.h"
+
+PlanNode::PlanNode()
+	: startupCost(0), totalCost(0), planRows(0), actualRows(0), actualTime(0), loops(0), selfTime(0)
+	, sharedHit(0), sharedRead(0)
+{
+}
+
+QString PlanNode::title() const
+{
+	QString title = type;
+
+	if (!joinType.isEmpty() && joinType != "Inner") {
+		title += " (" + joinType + ")";
+	}
+
+	if (!index.isEmpty()) {
+		title += " using " + index;
+	}
+
+	if (!relation.isEmpty()) {
+		title += " on " + relation;
+		if (!alias.isEmpty() && alias != relation) {
+			title += " " + alias;
+		}
+	}
+
+	return title;
+}
+
+double PlanNode::totalTime() const
+{
+	return actualTime * loops;
+}
+
+bool PlanNode::isExecuted() const
+{
+	return loops > 0;
+}
+
+ExplainPlan::ExplainPlan()
+	: m_planningTime(-1), m_executionTime(-1)
+{
+}
+
+QString ExplainPlan::query(const QString &statement)
+{
+	// No line break, so LINE n of an error still matches the editor
+	return "EXPLAIN (ANALYZE, BUFFERS, FORMAT XML) " + statement;
+}
+
+bool ExplainPlan::parse(const QString &xml)
+{
+	m_root = PlanNode();
+	m_planningTime = -1;
+	m_executionTime = -1;
+	m_errorString.clear();
+
+	QXmlStreamReader reader(xml);
+	bool hasPlan = false;
+
+	if (reader.readNextStartElement() && reader.name() == QLatin1String("explain")) {
+		while (reader.readNextStartElement()) {
+			if (reader.name() != QLatin1String("Query") || hasPlan) {
+				reader.skipCurrentElement();
+				continue;
+			}
+
+			while (reader.readNextStartElement()) {
+				if (reader.name() == QLatin1String("Plan")) {
+					readPlan(reader, &m_root);
+					hasPlan = true;
+				} else if (reader.name() == QLatin1String("Planning-Time")) {
+					m_planningTime = reader.readElementText().toDouble();
+				} else if (reader.name() == QLatin1String("Execution-Time") || reader.name() == QLatin1String("Total-Runtime")) {
+					m_executionTime = reader.readElementText().toDouble();
+				} else {
+					reader.skipCurrentElement();
+				}
+			}
+		}
+	}
+
+	if (reader.hasError()) {
+		m_errorString = reader.errorString();
+	} else if (!hasPlan) {
+		m_errorString = QObject::tr("The result is not an XML plan");
+	}
+
+	return m_errorString.isEmpty();
+}
+
+QString ExplainPlan::errorString() const
+{
+	return m_errorString;
+}
+
+PlanNode ExplainPlan::root() const
+{
+	return m_root;
+}
+
+double ExplainPlan::planningTime() const
+{
+	return m_planningTime;
+}
+
+double ExplainPlan::executionTime() const
+{
+	return m_executionTime;
+}
+
+void ExplainPlan::readPlan(QXmlStreamReader &reader, PlanNode *node)
+{
+	while (reader.readNextStartElement()) {
+		const QString name = reader.name().toString();
+
+		if (name == "Plans") {
+			while (reader.readNextStartElement()) {
+				if (reader.name() == QLatin1String("Plan")) {
+					PlanNode child;
+					readPlan(reader, &child);
+					node->children << child;
+				} else {
+					reader.skipCurrentElement();
+				}
+			}
+		} else if (name == "Node-Type") {
+			node->type = reader.readElementText();
+		} else if (name == "Relation-Name") {
+			node->relation = reader.readElementText();
+		} else if (name == "Alias") {
+			node->alias = reader.readElementText();
+		} else if (name == "Index-Name") {
+			node->index = reader.readElementText();
+		} else if (name == "Join-Type") {
+			node->joinType = reader.readElementText();
+		} else if (name == "Startup-Cost") {
+			node->startupCost = reader.readElementText().toDouble();
+		} else if (name == "Total-Cost") {
+			node->totalCost = reader.readElementText().toDouble();
+		} else if (name == "Plan-Rows") {
+			node->planRows = reader.readElementText().toDouble();
+		} else if (name == "Actual-Rows") {
+			node->actualRows = reader.readElementText().toDouble();
+		} else if (name == "Actual-Total-Time") {
+			node->actualTime = reader.readElementText().toDouble();
+		} else if (name == "Actual-Loops") {
+			node->loops = reader.readElementText().toDouble();
+		} else if (name == "Shared-Hit-Blocks") {
+			node->sharedHit = reader.readElementText().toLongLong();
+		} else if (name == "Shared-Read-Blocks") {
+			node->sharedRead = reader.readElementText().toLongLong();
+		} else if (name == "Plan-Width" || name == "Actual-Startup-Time" || name == "Parallel-Aware" || name == "Async-Capable") {
+			reader.skipCurrentElement();
+		} else {
+			// Conditions, sort keys, spills and the like go to the tooltip
+			const QString &value = readValue(reader);
+			if (!value.isEmpty() && value != "0" && value != "0.000" && value != "false") {
+				node->details << QString(name).replace('-', ' ') + ": " + value;
+			}
+		}
+	}
+
+	double childrenTime = 0;
+	foreach(const PlanNode & child, node->children) {
+		childrenTime += child.totalTime();
+	}
+
+	node->selfTime = qMax(0.0, node->totalTime() - childrenTime);
+}
+
+QString ExplainPlan::readValue(QXmlStreamReader &reader)
+{
+	// Either plain text or a list of <Item> elements
+	QString text;
+	QStringList items;
+
+	while (!reader.atEnd()) {
+		reader.readNext();
+
+		if (reader.isCharacters()) {
+			text += reader.text();
+		} else if (reader.isStartElement()) {
+			items << reader.readElementText(QXmlStreamReader::IncludeChildElements);
+		} else if (reader.isEndElement()) {
+			break;
+		}
+	}
+
+	return items.isEmpty() ? text.trimmed() : items.join(", ");
+}
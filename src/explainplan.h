@@ -0,0 +1,94 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#ifndef EXPLAINPLAN_H
+#define EXPLAINPLAN_H
+
+class QXmlStreamReader;
+
+#include <QtCore/QList>
+#include <QtCore/QStringList>
+
+/*!
+ * One node of an executed plan. Times are in milliseconds, actualTime and
+ * the row counts are per loop as PostgreSQL reports them, buffer counts
+ * include the children.
+ */
+struct PlanNode {
+	PlanNode();
+
+	QString title() const;
+	double totalTime() const;
+	bool isExecuted() const;
+
+	QString type;
+	QString relation;
+	QString alias;
+	QString index;
+	QString joinType;
+	QStringList details;
+	double startupCost;
+	double totalCost;
+	double planRows;
+	double actualRows;
+	double actualTime;
+	double loops;
+	double selfTime;
+	qint64 sharedHit;
+	qint64 sharedRead;
+	QList<PlanNode> children;
+};
+
+/*!
+ * Plan of EXPLAIN (ANALYZE, BUFFERS, FORMAT XML) read with QXmlStreamReader.
+ * The self time of a node is its total time minus the total time of its
+ * children.
+ */
+class ExplainPlan
+{
+public:
+	ExplainPlan();
+
+	static QString query(const QString &statement);
+
+	bool parse(const QString &xml);
+	QString errorString() const;
+
+	PlanNode root() const;
+	double planningTime() const;
+	double executionTime() const;
+
+private:
+	void readPlan(QXmlStreamReader &reader, PlanNode *node);
+	QString readValue(QXmlStreamReader &reader);
+
+private:
+	PlanNode m_root;
+	double m_planningTime;
+	double m_executionTime;
+	QString m_errorString;
+};
+
+#endif //EXPLAINPLAN_H
@@ -0,0 +1,211 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#include "fanoutrunner.h"
+#include "connectionpool.h"
+
+FanOutRunner::FanOutRunner(QObject *parent)
+	: QObject(parent)
+	, m_parallelism(8)
+{
+
+}
+
+FanOutRunner::~FanOutRunner()
+{
+	foreach(const Target & target, m_running) {
+		target.executor->cancel(m_job.token);
+		ConnectionPool::release(target.executor);
+	}
+}
+
+int FanOutRunner::parallelism() const
+{
+	return m_parallelism;
+}
+
+void FanOutRunner::setParallelism(int parallelism)
+{
+	m_parallelism = qMax(parallelism, 1);
+}
+
+bool FanOutRunner::isRunning() const
+{
+	return !m_running.isEmpty() || !m_pending.isEmpty();
+}
+
+void FanOutRunner::start(const QStringList &targets, const QueryJob &job)
+{
+	cancel();
+
+	m_job = job;
+	m_pending = targets;
+	m_columns.clear();
+
+	while (m_running.size() < m_parallelism && !m_pending.isEmpty()) {
+		startNext();
+	}
+
+	if (!isRunning()) {
+		emit finished();
+	}
+}
+
+void FanOutRunner::cancel()
+{
+	m_pending.clear();
+
+	foreach(const Target & target, m_running) {
+		target.executor->cancel(m_job.token);
+	}
+}
+
+void FanOutRunner::startNext()
+{
+	Target target;
+	target.name = m_pending.takeFirst();
+	target.executor = ConnectionPool::pool(target.name)->checkOut();
+	target.rowCount = 0;
+
+	connect(target.executor, SIGNAL(columnsReady(int, ResultColumns)), this, SLOT(executorColumnsReady(int, ResultColumns)));
+	connect(target.executor, SIGNAL(chunkFetched(int, ResultChunk, bool)), this, SLOT(executorChunkFetched(int, ResultChunk, bool)));
+	connect(target.executor, SIGNAL(jobFinished(int, QueryResult)), this, SLOT(executorJobFinished(int, QueryResult)));
+
+	target.timer.start();
+	m_running.insert(target.executor->submit(m_job), target);
+
+	emit targetStarted(target.name);
+}
+
+bool FanOutRunner::checkColumns(Target *target, const ResultColumns &columns)
+{
+	if (target->error.isValid()) {
+		return false;
+	}
+
+	if (m_columns.isEmpty()) {
+		ResultColumn source;
+		source.name = tr("source");
+		source.type = ResultColumn::Text;
+
+		m_columns << source << columns;
+		emit columnsReady(m_columns);
+		return true;
+	}
+
+	if (m_columns.size() != columns.size() + 1) {
+		target->error = QSqlError(tr("The result columns differ from the first target"), QString(), QSqlError::UnknownError);
+		return false;
+	}
+
+	// Rows are stored in the types of the first target; anything but text
+	// would be converted with a silent loss, e.g. text to 0 in an integer.
+	for (int i = 0; i < columns.size(); i++) {
+		const ResultColumn &first = m_columns.at(i + 1);
+
+		if (first.name != columns.at(i).name) {
+			target->error = QSqlError(tr("The result columns differ from the first target"), QString(), QSqlError::UnknownError);
+			return false;
+		}
+
+		if (first.type != columns.at(i).type && first.type != ResultColumn::Text) {
+			target->error = QSqlError(tr("The type of column %1 differs from the first target").arg(first.name), QString(), QSqlError::UnknownError);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void FanOutRunner::appendRows(Target *target, const ResultChunk &chunk)
+{
+	if (target->error.isValid() || chunk.rowCount() == 0) {
+		return;
+	}
+
+	ResultChunkBuilder builder(m_columns, chunk.rowCount());
+	QVector<QVariant> values(m_columns.size());
+	values [0] = target->name;
+
+	for (int row = 0, rowCount = chunk.rowCount(); row < rowCount; row++) {
+		for (int column = 1, columnCount = values.size(); column < columnCount; column++) {
+			values [column] = chunk.value(row, column - 1);
+		}
+		builder.addRow(values);
+	}
+
+	target->rowCount += chunk.rowCount();
+	emit chunkFetched(builder.finish());
+}
+
+void FanOutRunner::executorColumnsReady(int jobId, const ResultColumns &columns)
+{
+	if (m_running.contains(jobId)) {
+		Target &target = m_running [jobId];
+		if (!checkColumns(&target, columns)) {
+			target.executor->closeCursor(jobId);
+		}
+	}
+}
+
+void FanOutRunner::executorChunkFetched(int jobId, const ResultChunk &chunk, bool atEnd)
+{
+	if (!m_running.contains(jobId))
+		return;
+
+	Target &target = m_running [jobId];
+	appendRows(&target, chunk);
+
+	if (!atEnd) {
+		target.executor->fetchMore(jobId);
+	}
+}
+
+void FanOutRunner::executorJobFinished(int jobId, const QueryResult &result)
+{
+	if (!m_running.contains(jobId))
+		return;
+
+	Target target = m_running.take(jobId);
+
+	if (!result.columns.isEmpty() && checkColumns(&target, result.columns)) {
+		appendRows(&target, result.rows);
+	}
+
+	QueryResult targetResult = result;
+	if (!targetResult.error.isValid()) {
+		targetResult.error = target.error;
+	}
+
+	disconnect(target.executor, 0, this, 0);
+	ConnectionPool::release(target.executor);
+	emit targetFinished(target.name, targetResult, target.rowCount, target.timer.elapsed());
+
+	if (!m_pending.isEmpty()) {
+		startNext();
+	} else if (m_running.isEmpty()) {
+		emit finished();
+	}
+}
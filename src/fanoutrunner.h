@@ -0,0 +1,92 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#ifndef FANOUTRUNNER_H
+#define FANOUTRUNNER_H
+
+#include <QtCore/QObject>
+#include <QtCore/QStringList>
+#include <QtCore/QHash>
+#include <QtCore/QElapsedTimer>
+
+#include "queryexecutor.h"
+
+/*!
+ * Runs one job on several connections at once, at most parallelism()
+ * targets at a time. Rows from all targets are merged into one stream
+ * with a leading source column.
+ */
+class FanOutRunner : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit FanOutRunner(QObject *parent = 0);
+	virtual ~FanOutRunner();
+
+	int parallelism() const;
+	void setParallelism(int parallelism);
+
+	bool isRunning() const;
+
+	void start(const QStringList &targets, const QueryJob &job);
+	void cancel();
+
+Q_SIGNALS:
+	void targetStarted(const QString &target);
+	void columnsReady(const ResultColumns &columns);
+	void chunkFetched(const ResultChunk &chunk);
+	void targetFinished(const QString &target, const QueryResult &result, int rowCount, qint64 elapsed);
+	void finished();
+
+private Q_SLOTS:
+	void executorColumnsReady(int jobId, const ResultColumns &columns);
+	void executorChunkFetched(int jobId, const ResultChunk &chunk, bool atEnd);
+	void executorJobFinished(int jobId, const QueryResult &result);
+
+private:
+	Q_DISABLE_COPY(FanOutRunner)
+
+	struct Target {
+		QString name;
+		QueryExecutor *executor;
+		QElapsedTimer timer;
+		int rowCount;
+		QSqlError error;
+	};
+
+	void startNext();
+	bool checkColumns(Target *target, const ResultColumns &columns);
+	void appendRows(Target *target, const ResultChunk &chunk);
+
+private:
+	int m_parallelism;
+	QueryJob m_job;
+	QStringList m_pending;
+	QHash<int, Target> m_running;
+	ResultColumns m_columns;
+};
+
+#endif //FANOUTRUNNER_H
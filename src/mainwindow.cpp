@@ -38,6 +38,7 @@
 #include "databasetree.h"
 #include "edittablewidget.h"
 #include "sqlquerywidget.h"
+#include "activitywidget.h"
 
 MainWindow::MainWindow(QWidget *parent, Qt::WFlags f)
 	: QMainWindow(parent, f)
@@ -47,6 +48,8 @@ MainWindow::MainWindow(QWidget *parent, Qt::WFlags f)
 
 	databaseTree = new DatabaseTree(this);
 	connect(databaseTree, SIGNAL(openTable(QString, QString)), this, SLOT(openTable(QString, QString)));
+	connect(databaseTree, SIGNAL(openActivity(QString)), this, SLOT(openActivity(QString)));
+	connect(databaseTree, SIGNAL(runOnTargets(QStringList)), this, SLOT(sqlEditTargets(QStringList)));
 
 	databaseTreeDock = new QDockWidget(this);
 	databaseTreeDock->setObjectName("TREE_DOCK");
@@ -151,6 +154,11 @@ void MainWindow::openTable(const QString &connectionName, const QString &tableNa
 	addWindow(new EditTableWidget(connectionName, tableName));
 }
 
+void MainWindow::openActivity(const QString &connectionName)
+{
+	addWindow(new ActivityWidget(connectionName));
+}
+
 void MainWindow::sqlEdit()
 {
 	SqlQueryWidget *w = new SqlQueryWidget(databaseTree->currentConnection());
@@ -158,6 +166,14 @@ void MainWindow::sqlEdit()
 	addWindow(w);
 }
 
+void MainWindow::sqlEditTargets(const QStringList &connectionNames)
+{
+	SqlQueryWidget *w = new SqlQueryWidget(connectionNames.first());
+	w->setTargets(connectionNames);
+	connect(databaseTree, SIGNAL(connectionsChanged()), w, SLOT(connectionsChanged()));
+	addWindow(w);
+}
+
 void MainWindow::addWindow(QWidget *widget)
 {/*
 	QMdiSubWindow *mdi = new QMdiSubWindow(this);
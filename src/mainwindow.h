@@ -30,6 +30,7 @@ class DatabaseTree;
 class QDockWidget;
 class QMdiArea;
 class QMenu;
+class QStringList;
 
 #include <QtGui/QMainWindow>
 
@@ -54,7 +55,9 @@ private:
 
 private Q_SLOTS:
 	void openTable(const QString &connectionName, const QString &tableName);
+	void openActivity(const QString &connectionName);
 	void sqlEdit();
+	void sqlEditTargets(const QStringList &connectionNames);
 
 private:
 	QMdiArea *mdiArea;
@@ -0,0 +1,1502 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#include <QtCore/QRegExp>
+#include <QtCore/QFile>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QtConcurrentRun>
+
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlQuery>
+#include <QtSql/QSqlRecord>
+#include <QtSql/QSqlDriver>
+
+#include <climits>
+#include <cstring>
+
+#include <libpq-fe.h>
+
+#include "queryexecutor.h"
+#include "sqlsplitter.h"
+
+static const char cursorName[] = "qpgadmin_cursor";
+static const char internalSeparator = '#';
+static const int cancelTimeout = 5000;
+static const int cancelPollInterval = 100;
+static const int progressInterval = 250;
+static const int copyChunkSize = 1024 * 1024;
+static const int maxPreparedStatements = 64;
+static const int maxSeenQueries = 1024;
+static const int defaultIdleCheckInterval = 60000;
+
+static PGconn *connectionHandle(const QSqlDatabase &db)
+{
+	const QVariant handle = db.driver()->handle();
+	if (!handle.isValid() || qstrcmp(handle.typeName(), "PGconn*") != 0) {
+		return 0;
+	}
+	return *static_cast<PGconn *const *>(handle.constData());
+}
+
+QAtomicInt QueryExecutor::s_lastJobId(0);
+QHash<QString, QueryExecutor *> QueryExecutor::s_executors;
+
+CancellationToken::CancellationToken()
+	: m_cancelled(new QAtomicInt(0))
+{
+
+}
+
+void CancellationToken::cancel()
+{
+	*m_cancelled = 1;
+}
+
+bool CancellationToken::isCancelled() const
+{
+	return *m_cancelled != 0;
+}
+
+bool CancellationToken::operator==(const CancellationToken &other) const
+{
+	return m_cancelled == other.m_cancelled;
+}
+
+bool CancellationToken::operator!=(const CancellationToken &other) const
+{
+	return m_cancelled != other.m_cancelled;
+}
+
+QueryJob::QueryJob(const QString &query, Type type)
+	: id(0)
+	, type(type)
+	, query(query)
+	, stopOnError(true)
+	, cachePrepared(false)
+	, rollback(false)
+	, priority(NormalPriority)
+	, fetchSize(1000)
+	, statementTimeout(0)
+{
+
+}
+
+QueryTimings::QueryTimings()
+	: queueWait(-1)
+	, checkout(-1)
+	, connect(-1)
+	, execution(-1)
+	, firstRow(-1)
+	, fetch(-1)
+	, idle(0)
+	, population(-1)
+	, total(-1)
+{
+
+}
+
+QueryResult::QueryResult()
+	: jobId(0)
+	, isCancelled(false)
+	, numRowsAffected(-1)
+{
+
+}
+
+StatementResult::StatementResult()
+	: index(-1)
+	, line(0)
+	, position(-1)
+	, numRowsAffected(-1)
+	, rowCount(-1)
+	, elapsed(0)
+{
+
+}
+
+QueryExecutor::QueryExecutor(const QString &connectionName, QObject *parent)
+	: QThread(parent)
+	, m_connectionName(connectionName)
+	, m_port(-1)
+	, m_stopped(false)
+	, m_cursorJobId(0)
+	, m_pendingFetches(0)
+	, m_closeRequested(false)
+	, m_waiting(false)
+	, m_waitTime(0)
+	, m_preparedTimeSaved(0)
+	, m_idleCheckInterval(defaultIdleCheckInterval)
+	, m_backendPid(0)
+	, m_reconnects(0)
+	, m_isOpened(false)
+	, m_preparedHits(0)
+	, m_preparedMisses(0)
+{
+	static int serial = 0;
+	m_executorName = QString("%1%2%3").arg(connectionName).arg(internalSeparator).arg(++serial);
+
+	const QSqlDatabase origin = QSqlDatabase::database(connectionName, false);
+	m_driverName = origin.driverName();
+	m_hostName = origin.hostName();
+	m_port = origin.port();
+	m_databaseName = origin.databaseName();
+	m_userName = origin.userName();
+	m_password = origin.password();
+	m_connectOptions = origin.connectOptions();
+
+	qRegisterMetaType<ResultColumns>("ResultColumns");
+	qRegisterMetaType<ResultChunk>("ResultChunk");
+	qRegisterMetaType<QueryResult>("QueryResult");
+	qRegisterMetaType<StatementResult>("StatementResult");
+	qRegisterMetaType<qint64>("qint64");
+}
+
+QueryExecutor::~QueryExecutor()
+{
+	shutdown();
+}
+
+QueryExecutor *QueryExecutor::executor(const QString &connectionName)
+{
+	QueryExecutor *executor = s_executors.value(connectionName);
+
+	if (!executor) {
+		executor = new QueryExecutor(connectionName);
+		s_executors.insert(connectionName, executor);
+		executor->start();
+	}
+
+	return executor;
+}
+
+void QueryExecutor::closeExecutors(const QString &connectionName)
+{
+	foreach(const QString & name, s_executors.keys()) {
+		if (connectionName.isEmpty() || name == connectionName || name.startsWith(connectionName + ".")) {
+			delete s_executors.take(name);
+		}
+	}
+}
+
+QStringList QueryExecutor::connectionNames()
+{
+	QStringList result;
+
+	foreach(const QString & name, QSqlDatabase::connectionNames()) {
+		if (!name.contains(internalSeparator)) {
+			result << name;
+		}
+	}
+
+	return result;
+}
+
+bool QueryExecutor::isCursorQuery(const QString &queryString)
+{
+	static const QRegExp selectRegexp("^\\s*(select|values|table)\\b", Qt::CaseInsensitive);
+	static const QRegExp withRegexp("^\\s*with\\b", Qt::CaseInsensitive);
+	static const QRegExp modifyRegexp("\\b(insert|update|delete)\\b", Qt::CaseInsensitive);
+	// DECLARE rejects SELECT INTO, row locks would end with the implicit
+	// transaction of the cursor
+	static const QRegExp plainRegexp("\\binto\\b|\\bfor\\s+(no\\s+key\\s+)?(update|share)\\b|\\bfor\\s+key\\s+share\\b",
+									 Qt::CaseInsensitive);
+
+	// Called from every executor thread at once, a QRegExp keeps match state
+	QRegExp select = selectRegexp;
+	QRegExp with = withRegexp;
+	QRegExp modify = modifyRegexp;
+	QRegExp plain = plainRegexp;
+
+	QString query = queryString.trimmed();
+	while (query.endsWith(';')) {
+		query.chop(1);
+	}
+
+	if (query.contains(';') || plain.indexIn(query) != -1) {
+		return false;
+	}
+
+	if (select.indexIn(query) != -1) {
+		return true;
+	}
+
+	return with.indexIn(query) != -1 && modify.indexIn(query) == -1;
+}
+
+QString QueryExecutor::connectionName() const
+{
+	return m_connectionName;
+}
+
+qint64 QueryExecutor::waitTime() const
+{
+	QMutexLocker locker(&m_mutex);
+	return m_waitTime;
+}
+
+int QueryExecutor::reconnects() const
+{
+	return m_reconnects;
+}
+
+bool QueryExecutor::hasOpenCursor() const
+{
+	QMutexLocker locker(&m_mutex);
+	return m_cursorJobId != 0;
+}
+
+int QueryExecutor::preparedHits() const
+{
+	return m_preparedHits;
+}
+
+int QueryExecutor::preparedMisses() const
+{
+	return m_preparedMisses;
+}
+
+qint64 QueryExecutor::preparedTimeSaved() const
+{
+	QMutexLocker locker(&m_mutex);
+	return m_preparedTimeSaved;
+}
+
+int QueryExecutor::idleCheckInterval() const
+{
+	return m_idleCheckInterval;
+}
+
+void QueryExecutor::setIdleCheckInterval(int msec)
+{
+	m_idleCheckInterval = msec;
+}
+
+int QueryExecutor::submit(const QueryJob &job)
+{
+	QueryJob queued = job;
+	queued.id = s_lastJobId.fetchAndAddOrdered(1) + 1;
+	queued.queueTimer.start();
+
+	QMutexLocker locker(&m_mutex);
+
+	int index = 0;
+	while (index < m_queue.size() && m_queue.at(index).priority >= queued.priority) {
+		++index;
+	}
+	m_queue.insert(index, queued);
+	m_condition.wakeAll();
+
+	return queued.id;
+}
+
+void QueryExecutor::fetchMore(int jobId)
+{
+	QMutexLocker locker(&m_mutex);
+
+	if (m_cursorJobId == jobId) {
+		++m_pendingFetches;
+		m_condition.wakeAll();
+	}
+}
+
+void QueryExecutor::closeCursor(int jobId)
+{
+	QMutexLocker locker(&m_mutex);
+
+	if (m_cursorJobId == jobId) {
+		m_closeRequested = true;
+		m_condition.wakeAll();
+	}
+}
+
+void QueryExecutor::cancel(const CancellationToken &token)
+{
+	CancellationToken cancelled = token;
+	cancelled.cancel();
+
+	QMutexLocker locker(&m_mutex);
+
+	const bool isCurrent = m_currentToken == token;
+	const bool isWaiting = isCurrent && m_cursorJobId != 0 && m_waiting;
+	m_condition.wakeAll();
+
+	locker.unlock();
+
+	const int backendPid = m_backendPid;
+	if (isCurrent && !isWaiting && backendPid > 0) {
+		m_cancels.addFuture(QtConcurrent::run(this, &QueryExecutor::cancelBackend, QSqlDatabase::database(m_connectionName, false),
+											  token, backendPid));
+	}
+}
+
+void QueryExecutor::shutdown()
+{
+	if (!isRunning()) {
+		m_cancels.waitForFinished();
+		return;
+	}
+
+	QMutexLocker locker(&m_mutex);
+	const CancellationToken token = m_currentToken;
+	m_queue.clear();
+	m_stopped = true;
+	locker.unlock();
+
+	cancel(token);
+	wait();
+	m_cancels.waitForFinished();
+}
+
+void QueryExecutor::cancelBackend(const QSqlDatabase &origin, const CancellationToken &token, int backendPid)
+{
+	const QString connectionName = QString("%1%2cancel%3").arg(origin.connectionName()).arg(internalSeparator).arg(backendPid);
+
+	{
+		QSqlDatabase db = QSqlDatabase::cloneDatabase(origin, connectionName);
+		if (db.open()) {
+			QSqlQuery activity(db);
+			activity.prepare("SELECT query_start FROM pg_stat_activity WHERE pid = ? AND state = 'active'");
+			activity.addBindValue(backendPid);
+
+			QSqlQuery query(db);
+
+			// Every step is taken only while the cancelled job is still the
+			// one on the backend; the executor may have moved on to a job
+			// of another widget sharing it.
+			QMutexLocker locker(&m_cancelMutex);
+			QVariant queryStart;
+			if (isCurrentJob(token, backendPid) && activity.exec() && activity.next()) {
+				queryStart = activity.value(0);
+
+				query.prepare("SELECT pg_cancel_backend(?)");
+				query.addBindValue(backendPid);
+				query.exec();
+			}
+			locker.unlock();
+
+			// The session is only terminated when the same statement of the
+			// same job ignored the cancel for the whole timeout
+			bool isActive = queryStart.isValid();
+			for (int elapsed = 0; isActive && elapsed < cancelTimeout; elapsed += cancelPollInterval) {
+				QThread::msleep(cancelPollInterval);
+
+				locker.relock();
+				isActive = isCurrentJob(token, backendPid) && activity.exec() && activity.next() && activity.value(0) == queryStart;
+				locker.unlock();
+			}
+
+			if (isActive) {
+				locker.relock();
+				if (isCurrentJob(token, backendPid) && activity.exec() && activity.next() && activity.value(0) == queryStart) {
+					query.prepare("SELECT pg_terminate_backend(?)");
+					query.addBindValue(backendPid);
+					query.exec();
+				}
+				locker.unlock();
+			}
+		}
+	}
+
+	QSqlDatabase::removeDatabase(connectionName);
+}
+
+bool QueryExecutor::isCurrentJob(const CancellationToken &token, int backendPid) const
+{
+	QMutexLocker locker(&m_mutex);
+	return m_currentToken == token && m_backendPid == backendPid;
+}
+
+void QueryExecutor::run()
+{
+	forever {
+		QueryJob job;
+		if (!takeJob(&job)) {
+			break;
+		}
+
+		QueryResult result;
+		result.jobId = job.id;
+		result.timings.queueWait = job.queueTimer.nsecsElapsed() / 1000;
+
+		{
+			QMutexLocker locker(&m_mutex);
+			m_waitTime += result.timings.queueWait;
+		}
+
+		m_jobTimer.start();
+		if (job.token.isCancelled()) {
+			setError(job, QSqlError(), &result);
+		} else if (openDatabase(&result)) {
+			result.timings.connect = jobTime();
+			m_jobTimer.start();
+			emit jobStarted(job.id);
+
+			if (job.type == QueryJob::Cursor) {
+				executeCursor(job, &result);
+			} else if (job.type == QueryJob::Script) {
+				executeScript(job, &result);
+			} else if (job.type == QueryJob::File) {
+				executeFile(job, &result);
+			} else if (job.type == QueryJob::CopyOut) {
+				executeCopyOut(job, &result);
+			} else if (job.type == QueryJob::CopyIn) {
+				executeCopyIn(job, &result);
+			} else if (job.type == QueryJob::Batch) {
+				executeBatch(job, &result);
+			} else {
+				executeQuery(job, &result);
+			}
+
+			if (result.timings.execution < 0) {
+				result.timings.execution = jobTime();
+			}
+
+			if (result.error.isValid() && !isConnectionAlive(QSqlDatabase::database(m_executorName, false))) {
+				closeDatabase();
+			}
+		}
+		result.timings.total = result.timings.queueWait + qMax(result.timings.connect, Q_INT64_C(0)) + jobTime();
+
+		m_idleTimer.start();
+
+		QMutexLocker cancelLocker(&m_cancelMutex);
+		QMutexLocker locker(&m_mutex);
+		m_currentToken = CancellationToken();
+		locker.unlock();
+		cancelLocker.unlock();
+
+		emit jobFinished(job.id, result);
+	}
+
+	closeDatabase();
+}
+
+bool QueryExecutor::takeJob(QueryJob *job)
+{
+	QMutexLocker locker(&m_mutex);
+
+	while (m_queue.isEmpty() && !m_stopped) {
+		m_condition.wait(&m_mutex);
+	}
+
+	if (m_stopped) {
+		return false;
+	}
+
+	*job = m_queue.takeFirst();
+	m_currentToken = job->token;
+	return true;
+}
+
+bool QueryExecutor::openDatabase(QueryResult *result)
+{
+	bool isOpen = QSqlDatabase::database(m_executorName, false).isOpen();
+
+	// Whoever owns the executor, a dead socket is found here and not by
+	// the next query of the user
+	if (isOpen && m_idleTimer.isValid() && m_idleTimer.elapsed() > m_idleCheckInterval
+			&& !isConnectionResponding(QSqlDatabase::database(m_executorName, false))) {
+		closeDatabase();
+		isOpen = false;
+	}
+
+	if (isOpen) {
+		return true;
+	}
+
+	QSqlDatabase db;
+	if (QSqlDatabase::contains(m_executorName)) {
+		db = QSqlDatabase::database(m_executorName, false);
+	} else {
+		db = QSqlDatabase::addDatabase(m_driverName, m_executorName);
+		db.setHostName(m_hostName);
+		db.setPort(m_port);
+		db.setDatabaseName(m_databaseName);
+		db.setUserName(m_userName);
+		db.setPassword(m_password);
+		db.setConnectOptions(m_connectOptions);
+	}
+
+	if (!db.open()) {
+		result->error = db.lastError();
+		return false;
+	}
+
+	if (m_isOpened) {
+		m_reconnects.ref();
+	}
+	m_isOpened = true;
+
+	QSqlQuery query(db);
+	if (query.exec("SELECT pg_backend_pid()") && query.next()) {
+		m_backendPid = query.value(0).toInt();
+	}
+
+	return true;
+}
+
+void QueryExecutor::closeDatabase()
+{
+	if (!QSqlDatabase::contains(m_executorName)) {
+		return;
+	}
+
+	clearPrepared();
+
+	{
+		QSqlDatabase db = QSqlDatabase::database(m_executorName, false);
+		db.close();
+	}
+
+	m_backendPid = 0;
+	QSqlDatabase::removeDatabase(m_executorName);
+}
+
+void QueryExecutor::executeQuery(const QueryJob &job, QueryResult *result)
+{
+	QSqlDatabase db = QSqlDatabase::database(m_executorName, false);
+	QSqlQuery query(db);
+	query.setForwardOnly(true);
+
+	// The changes of a rolled back job are never kept, whatever it runs
+	if (job.rollback && !db.transaction()) {
+		setError(job, db.lastError(), result);
+		return;
+	}
+
+	if (!setTimeout(query, job, job.rollback, result)) {
+		if (job.rollback) {
+			db.rollback();
+		}
+		return;
+	}
+
+	bool isOk;
+	if (job.cachePrepared) {
+		// The statement stays prepared on the server for the next job
+		// with the same text, only the bind values change.
+		QElapsedTimer timer;
+		timer.start();
+
+		bool isHit;
+		isOk = prepareCached(job.query, job.query, &query, &isHit);
+		for (int i = 0, count = job.bindValues.size(); isOk && i < count; i++) {
+			query.bindValue(i, job.bindValues.at(i));
+		}
+		isOk = isOk && query.exec();
+
+		if (isOk) {
+			addPreparedTime(job.query, isHit, timer.nsecsElapsed() / 1000);
+		} else {
+			removePrepared(job.query);
+		}
+	} else if (job.bindValues.isEmpty()) {
+		isOk = query.exec(job.query);
+	} else {
+		isOk = query.prepare(job.query);
+		foreach(const QVariant & value, job.bindValues) {
+			query.addBindValue(value);
+		}
+		isOk = isOk && query.exec();
+	}
+
+	result->timings.execution = jobTime();
+
+	if (!isOk) {
+		setError(job, query.lastError(), result);
+	} else {
+		result->numRowsAffected = query.numRowsAffected();
+
+		if (query.isSelect()) {
+			result->columns = ResultStore::columnsOf(query.record());
+
+			ResultChunkBuilder builder(result->columns, qMax(query.size(), 0));
+			while (query.next()) {
+				builder.addRow(query);
+			}
+			result->rows = builder.finish();
+
+			result->timings.firstRow = jobTime();
+			result->timings.fetch = result->timings.firstRow;
+		}
+	}
+	query.finish();
+
+	if (job.rollback) {
+		db.rollback();
+	} else if (job.statementTimeout > 0) {
+		QSqlQuery(db).exec("RESET statement_timeout");
+	}
+}
+
+void QueryExecutor::executeCursor(const QueryJob &job, QueryResult *result)
+{
+	QMutexLocker locker(&m_mutex);
+	m_cursorJobId = job.id;
+	m_pendingFetches = 0;
+	m_closeRequested = false;
+	locker.unlock();
+
+	QSqlDatabase db = QSqlDatabase::database(m_executorName, false);
+
+	// Cursor queries are never prepared, a DECLARE can not be; a prepared
+	// EXECUTE would bring the whole result over at once.
+	if (!isCursorQuery(job.query)) {
+		QSqlQuery query(db);
+		query.setForwardOnly(true);
+
+		if (setTimeout(query, job, false, result)) {
+			const bool isOk = execStatement(&query, job.query, true);
+			result->timings.execution = jobTime();
+
+			if (!isOk) {
+				setError(job, query.lastError(), result);
+			} else {
+				result->numRowsAffected = query.numRowsAffected();
+
+				bool atEnd = !query.isSelect();
+				for (bool isFirst = true; !atEnd; isFirst = false) {
+					if (!isFirst && !waitForFetch(job, result)) {
+						break;
+					}
+					fetchChunk(query, job, isFirst, &atEnd, result);
+				}
+			}
+			query.finish();
+
+			if (job.statementTimeout > 0) {
+				QSqlQuery(db).exec("RESET statement_timeout");
+			}
+		}
+	} else {
+		QString cursorQuery = job.query.trimmed();
+		while (cursorQuery.endsWith(';')) {
+			cursorQuery.chop(1);
+		}
+
+		QSqlQuery query(db);
+		QSqlQuery fetch(db);
+		fetch.setForwardOnly(true);
+
+		const QString fetchString = QString("FETCH %1 FROM %2").arg(job.fetchSize).arg(cursorName);
+
+		bool isOk = db.transaction();
+		if (!isOk) {
+			setError(job, db.lastError(), result);
+		}
+
+		isOk = isOk && setTimeout(query, job, true, result);
+
+		if (isOk && !query.exec(QString("DECLARE %1 NO SCROLL CURSOR FOR %2").arg(cursorName).arg(cursorQuery))) {
+			setError(job, query.lastError(), result);
+			isOk = false;
+		}
+
+		bool atEnd = !isOk;
+		for (bool isFirst = true; !atEnd; isFirst = false) {
+			if (!isFirst && !waitForFetch(job, result)) {
+				break;
+			}
+
+			if (!fetch.exec(fetchString)) {
+				setError(job, fetch.lastError(), result);
+				isOk = false;
+				break;
+			}
+
+			// The server runs the query as far as the first FETCH needs
+			if (isFirst) {
+				result->timings.execution = jobTime();
+			}
+
+			fetchChunk(fetch, job, isFirst, &atEnd, result);
+		}
+
+		if (isOk && (!query.exec(QString("CLOSE %1").arg(cursorName)) || !db.commit())) {
+			setError(job, query.lastError().isValid() ? query.lastError() : db.lastError(), result);
+			isOk = false;
+		}
+
+		if (!isOk) {
+			db.rollback();
+		}
+	}
+
+	locker.relock();
+	m_cursorJobId = 0;
+}
+
+void QueryExecutor::executeScript(const QueryJob &job, QueryResult *result)
+{
+	QSqlDatabase db = QSqlDatabase::database(m_executorName, false);
+	QSqlQuery query(db);
+	query.setForwardOnly(true);
+
+	if (!setTimeout(query, job, false, result)) {
+		return;
+	}
+
+	QElapsedTimer timer;
+	for (int i = 0; i < job.statements.size() && !job.token.isCancelled(); i++) {
+		StatementResult statement;
+		statement.index = i;
+
+		timer.start();
+		if (!execStatement(&query, job.statements.at(i), false)) {
+			statement.error = query.lastError();
+		} else {
+			statement.numRowsAffected = query.numRowsAffected();
+
+			if (query.isSelect()) {
+				statement.rowCount = query.size();
+
+				const ResultColumns &columns = ResultStore::columnsOf(query.record());
+				ResultChunkBuilder builder(columns, qMin(qMax(statement.rowCount, 0), job.fetchSize));
+				while (builder.rowCount() < job.fetchSize && query.next()) {
+					builder.addRow(query);
+				}
+
+				emit columnsReady(job.id, columns);
+				emit chunkFetched(job.id, builder.finish(), true);
+			}
+		}
+		statement.elapsed = timer.nsecsElapsed() / 1000;
+		query.finish();
+
+		emit statementFinished(job.id, statement);
+
+		if (statement.error.isValid() && job.stopOnError) {
+			setError(job, statement.error, result);
+			break;
+		}
+	}
+
+	if (job.token.isCancelled() && !result->error.isValid()) {
+		setError(job, QSqlError(), result);
+	}
+
+	if (job.statementTimeout > 0) {
+		QSqlQuery(db).exec("RESET statement_timeout");
+	}
+}
+
+void QueryExecutor::executeBatch(const QueryJob &job, QueryResult *result)
+{
+	QSqlDatabase db = QSqlDatabase::database(m_executorName, false);
+	if (!db.transaction()) {
+		setError(job, db.lastError(), result);
+		return;
+	}
+
+	QSqlQuery query(db);
+	bool isOk = setTimeout(query, job, true, result);
+
+	// Statements of the same text share one prepared query, so the server
+	// parses and plans every shape once per batch.
+	QHash<QString, QSqlQuery> prepared;
+	result->numRowsAffected = 0;
+
+	for (int i = 0; isOk && i < job.statements.size(); i++) {
+		if (job.token.isCancelled()) {
+			setError(job, QSqlError(), result);
+			isOk = false;
+			break;
+		}
+
+		const QString &statement = job.statements.at(i);
+		QHash<QString, QSqlQuery>::iterator it = prepared.find(statement);
+		if (it == prepared.end()) {
+			QSqlQuery statementQuery(db);
+			statementQuery.setForwardOnly(true);
+			if (!statementQuery.prepare(statement)) {
+				setError(job, statementQuery.lastError(), result);
+				isOk = false;
+				break;
+			}
+			it = prepared.insert(statement, statementQuery);
+		}
+
+		const QVariantList &values = job.statementValues.value(i);
+		for (int j = 0, count = values.size(); j < count; j++) {
+			it.value().bindValue(j, values.at(j));
+		}
+
+		if (!it.value().exec()) {
+			setError(job, it.value().lastError(), result);
+			isOk = false;
+			break;
+		}
+
+		result->numRowsAffected += qMax(it.value().numRowsAffected(), 0);
+	}
+
+	prepared.clear();
+
+	if (isOk && !db.commit()) {
+		setError(job, db.lastError(), result);
+		isOk = false;
+	}
+
+	if (!isOk) {
+		db.rollback();
+	}
+}
+
+void QueryExecutor::executeFile(const QueryJob &job, QueryResult *result)
+{
+	QFile file(job.fileName);
+	if (!file.open(QIODevice::ReadOnly)) {
+		setError(job, QSqlError(tr("Cannot open %1: %2").arg(job.fileName).arg(file.errorString()), QString(), QSqlError::UnknownError), result);
+		return;
+	}
+
+	const qint64 size = file.size();
+	const char *data = size > 0 ? reinterpret_cast<const char *>(file.map(0, size)) : 0;
+	if (size > 0 && !data) {
+		setError(job, QSqlError(tr("Cannot map %1: %2").arg(job.fileName).arg(file.errorString()), QString(), QSqlError::UnknownError), result);
+		return;
+	}
+
+	// Dumps mostly change the schema, cached plans may be stale after it
+	clearPrepared();
+
+	QSqlDatabase db = QSqlDatabase::database(m_executorName, false);
+	QSqlQuery query(db);
+	query.setForwardOnly(true);
+
+	if (!setTimeout(query, job, false, result)) {
+		return;
+	}
+
+	static const QRegExp copyStdinRegexp("^\\s*copy\\b.*\\bfrom\\s+stdin\\b", Qt::CaseInsensitive);
+	QRegExp copyStdin = copyStdinRegexp;
+
+	// Only errors are reported per statement, a dump may hold millions of
+	// statements; the rest is summed up by throttled progress signals.
+	qint64 pos = 0;
+	int line = 1;
+	int count = 0;
+	SqlStatement statement;
+	QElapsedTimer timer;
+	QElapsedTimer progressTimer;
+	progressTimer.start();
+
+	while (!job.token.isCancelled() && SqlSplitter::next(data, size, &pos, &line, &statement)) {
+		StatementResult statementResult;
+		statementResult.index = count++;
+		statementResult.line = statement.line;
+		statementResult.position = pos;
+
+		const QString &text = QString::fromUtf8(data + statement.offset, statement.length);
+
+		timer.start();
+		if (copyStdin.indexIn(text) != -1) {
+			statementResult.error = copyInline(job, text, data, size, &pos, &line, &statementResult.numRowsAffected);
+		} else if (!query.exec(text)) {
+			statementResult.error = query.lastError();
+		} else {
+			statementResult.numRowsAffected = query.numRowsAffected();
+		}
+		statementResult.elapsed = timer.nsecsElapsed() / 1000;
+		query.finish();
+
+		if (statementResult.error.isValid()) {
+			emit statementFinished(job.id, statementResult);
+		}
+
+		if (progressTimer.elapsed() >= progressInterval) {
+			emit fileProgress(job.id, pos, size, count);
+			progressTimer.restart();
+		}
+
+		if (statementResult.error.isValid() && job.stopOnError) {
+			setError(job, statementResult.error, result);
+			break;
+		}
+	}
+
+	emit fileProgress(job.id, pos, size, count);
+
+	if (job.token.isCancelled() && !result->error.isValid()) {
+		setError(job, QSqlError(), result);
+	}
+
+	if (job.statementTimeout > 0) {
+		QSqlQuery(db).exec("RESET statement_timeout");
+	}
+}
+
+void QueryExecutor::executeCopyOut(const QueryJob &job, QueryResult *result)
+{
+	QSqlDatabase db = QSqlDatabase::database(m_executorName, false);
+	QSqlQuery query(db);
+
+	if (!setTimeout(query, job, false, result)) {
+		return;
+	}
+
+	PGconn *connection = connectionHandle(db);
+	if (!connection) {
+		setError(job, QSqlError(tr("COPY needs the QPSQL driver"), QString(), QSqlError::UnknownError), result);
+		return;
+	}
+
+	QFile file(job.fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		setError(job, QSqlError(tr("Cannot open %1: %2").arg(job.fileName).arg(file.errorString()), QString(), QSqlError::UnknownError), result);
+		return;
+	}
+
+	QSqlError error;
+	PGresult *copyResult = PQexec(connection, job.query.toUtf8().constData());
+	if (PQresultStatus(copyResult) != PGRES_COPY_OUT) {
+		error = QSqlError(tr("Unable to start COPY"), QString::fromUtf8(PQresultErrorMessage(copyResult)), QSqlError::StatementError);
+	}
+	PQclear(copyResult);
+
+	// Rows are written as they arrive; a cancel request from the GUI
+	// aborts the COPY on the server, which ends the loop with an error.
+	qint64 bytes = 0;
+	qint64 rows = 0;
+	QElapsedTimer progressTimer;
+	progressTimer.start();
+
+	while (!error.isValid()) {
+		char *buffer = 0;
+		const int length = PQgetCopyData(connection, &buffer, 0);
+
+		if (length < 0) {
+			break;
+		}
+
+		const bool isWritten = file.write(buffer, length) == length;
+		PQfreemem(buffer);
+
+		if (!isWritten) {
+			error = QSqlError(tr("Cannot write %1: %2").arg(job.fileName).arg(file.errorString()), QString(), QSqlError::UnknownError);
+
+			char message [256];
+			PGcancel *cancel = PQgetCancel(connection);
+			PQcancel(cancel, message, sizeof(message));
+			PQfreeCancel(cancel);
+			break;
+		}
+
+		bytes += length;
+		++rows;
+
+		if (progressTimer.elapsed() >= progressInterval) {
+			emit copyProgress(job.id, bytes, rows);
+			progressTimer.restart();
+		}
+	}
+
+	// Drain the connection, the last result tells how the COPY ended
+	while (PGresult *copyEnd = PQgetResult(connection)) {
+		if (PQresultStatus(copyEnd) == PGRES_COPY_OUT) {
+			char *buffer = 0;
+			while (PQgetCopyData(connection, &buffer, 0) >= 0) {
+				PQfreemem(buffer);
+			}
+		} else if (PQresultStatus(copyEnd) == PGRES_COMMAND_OK) {
+			rows = QByteArray(PQcmdTuples(copyEnd)).toLongLong();
+		} else if (!error.isValid()) {
+			error = QSqlError(tr("COPY failed"), QString::fromUtf8(PQresultErrorMessage(copyEnd)), QSqlError::StatementError);
+		}
+		PQclear(copyEnd);
+	}
+
+	file.close();
+	emit copyProgress(job.id, bytes, rows);
+
+	if (error.isValid() || job.token.isCancelled()) {
+		file.remove();
+		setError(job, error, result);
+	} else {
+		result->numRowsAffected = int(qMin(rows, qint64(INT_MAX)));
+	}
+
+	if (job.statementTimeout > 0) {
+		QSqlQuery(db).exec("RESET statement_timeout");
+	}
+}
+
+void QueryExecutor::executeCopyIn(const QueryJob &job, QueryResult *result)
+{
+	QSqlDatabase db = QSqlDatabase::database(m_executorName, false);
+	QSqlQuery query(db);
+
+	if (!setTimeout(query, job, false, result)) {
+		return;
+	}
+
+	PGconn *connection = connectionHandle(db);
+	if (!connection) {
+		setError(job, QSqlError(tr("COPY needs the QPSQL driver"), QString(), QSqlError::UnknownError), result);
+		return;
+	}
+
+	QFile file(job.fileName);
+	if (!file.open(QIODevice::ReadOnly)) {
+		setError(job, QSqlError(tr("Cannot open %1: %2").arg(job.fileName).arg(file.errorString()), QString(), QSqlError::UnknownError), result);
+		return;
+	}
+
+	QSqlError error;
+	PGresult *copyResult = PQexec(connection, job.query.toUtf8().constData());
+	const bool isStarted = PQresultStatus(copyResult) == PGRES_COPY_IN;
+	if (!isStarted) {
+		error = QSqlError(tr("Unable to start COPY"), QString::fromUtf8(PQresultErrorMessage(copyResult)), QSqlError::StatementError);
+	}
+	PQclear(copyResult);
+
+	// The file goes to the server in big raw chunks, rows are only counted
+	// by line breaks for the progress; the server reports the real count.
+	QByteArray buffer(copyChunkSize, Qt::Uninitialized);
+	qint64 bytes = 0;
+	qint64 rows = 0;
+	QElapsedTimer progressTimer;
+	progressTimer.start();
+
+	while (isStarted) {
+		if (job.token.isCancelled()) {
+			PQputCopyEnd(connection, "cancelled by user");
+			break;
+		}
+
+		const qint64 length = file.read(buffer.data(), buffer.size());
+		if (length < 0) {
+			error = QSqlError(tr("Cannot read %1: %2").arg(job.fileName).arg(file.errorString()), QString(), QSqlError::UnknownError);
+			PQputCopyEnd(connection, "read error");
+			break;
+		}
+
+		if (length == 0) {
+			PQputCopyEnd(connection, 0);
+			break;
+		}
+
+		if (PQputCopyData(connection, buffer.constData(), int(length)) != 1) {
+			error = QSqlError(tr("COPY failed"), QString::fromUtf8(PQerrorMessage(connection)), QSqlError::ConnectionError);
+			break;
+		}
+
+		bytes += length;
+		const char *end = buffer.constData() + length;
+		for (const char *it = buffer.constData(); (it = static_cast<const char *>(std::memchr(it, '\n', end - it))) != 0; ++it) {
+			++rows;
+		}
+
+		if (progressTimer.elapsed() >= progressInterval) {
+			emit copyProgress(job.id, bytes, rows);
+			progressTimer.restart();
+		}
+	}
+
+	while (PGresult *copyEnd = PQgetResult(connection)) {
+		if (PQresultStatus(copyEnd) == PGRES_COMMAND_OK) {
+			rows = QByteArray(PQcmdTuples(copyEnd)).toLongLong();
+		} else if (!error.isValid()) {
+			error = QSqlError(tr("COPY failed"), QString::fromUtf8(PQresultErrorMessage(copyEnd)), QSqlError::StatementError);
+		}
+		PQclear(copyEnd);
+	}
+
+	emit copyProgress(job.id, bytes, rows);
+
+	if (error.isValid() || job.token.isCancelled()) {
+		setError(job, error, result);
+	} else {
+		result->numRowsAffected = int(qMin(rows, qint64(INT_MAX)));
+	}
+
+	if (job.statementTimeout > 0) {
+		QSqlQuery(db).exec("RESET statement_timeout");
+	}
+}
+
+QSqlError QueryExecutor::copyInline(const QueryJob &job, const QString &statement, const char *data, qint64 size, qint64 *pos,
+									int *line, int *rows)
+{
+	// The rows of a COPY FROM stdin in a dump follow the line of the
+	// statement up to a line of "\."; the splitter goes on after it.
+	const char *newline = static_cast<const char *>(std::memchr(data + *pos, '\n', size - *pos));
+	const qint64 begin = newline ? newline - data + 1 : size;
+	if (newline) {
+		++*line;
+	}
+
+	qint64 end = begin;
+	qint64 next = size;
+	while (end < size) {
+		newline = static_cast<const char *>(std::memchr(data + end, '\n', size - end));
+		const qint64 lineEnd = newline ? newline - data : size;
+		if (newline) {
+			++*line;
+		}
+
+		const qint64 length = lineEnd - end;
+		if ((length == 2 || (length == 3 && data [end + 2] == '\r')) && data [end] == '\\' && data [end + 1] == '.') {
+			next = newline ? lineEnd + 1 : size;
+			break;
+		}
+		end = newline ? lineEnd + 1 : size;
+	}
+	*pos = next;
+
+	PGconn *connection = connectionHandle(QSqlDatabase::database(m_executorName, false));
+	if (!connection) {
+		return QSqlError(tr("COPY needs the QPSQL driver"), QString(), QSqlError::UnknownError);
+	}
+
+	QSqlError error;
+	PGresult *copyResult = PQexec(connection, statement.toUtf8().constData());
+	const bool isStarted = PQresultStatus(copyResult) == PGRES_COPY_IN;
+	if (!isStarted) {
+		error = QSqlError(tr("Unable to start COPY"), QString::fromUtf8(PQresultErrorMessage(copyResult)), QSqlError::StatementError);
+	}
+	PQclear(copyResult);
+
+	for (qint64 offset = begin; isStarted && offset < end; offset += copyChunkSize) {
+		if (job.token.isCancelled()) {
+			PQputCopyEnd(connection, "cancelled by user");
+			break;
+		}
+
+		if (PQputCopyData(connection, data + offset, int(qMin(qint64(copyChunkSize), end - offset))) != 1) {
+			error = QSqlError(tr("COPY failed"), QString::fromUtf8(PQerrorMessage(connection)), QSqlError::ConnectionError);
+			break;
+		}
+	}
+
+	if (isStarted && !job.token.isCancelled()) {
+		PQputCopyEnd(connection, error.isValid() ? "send error" : 0);
+	}
+
+	while (PGresult *copyEnd = PQgetResult(connection)) {
+		if (PQresultStatus(copyEnd) == PGRES_COMMAND_OK) {
+			*rows = int(qMin(QByteArray(PQcmdTuples(copyEnd)).toLongLong(), qint64(INT_MAX)));
+		} else if (!error.isValid()) {
+			error = QSqlError(tr("COPY failed"), QString::fromUtf8(PQresultErrorMessage(copyEnd)), QSqlError::StatementError);
+		}
+		PQclear(copyEnd);
+	}
+
+	return error;
+}
+
+bool QueryExecutor::fetchChunk(QSqlQuery &query, const QueryJob &job, bool isFirst, bool *atEnd, QueryResult *result)
+{
+	const ResultColumns &columns = ResultStore::columnsOf(query.record());
+
+	if (isFirst) {
+		emit columnsReady(job.id, columns);
+	}
+
+	ResultChunkBuilder builder(columns, job.fetchSize);
+
+	while (builder.rowCount() < job.fetchSize && query.next()) {
+		builder.addRow(query);
+	}
+
+	const int rowCount = builder.rowCount();
+	*atEnd = rowCount < job.fetchSize;
+	emit chunkFetched(job.id, builder.finish(), *atEnd);
+
+	if (isFirst) {
+		result->timings.firstRow = jobTime();
+	}
+	if (*atEnd) {
+		result->timings.fetch = jobTime() - result->timings.idle;
+	}
+
+	return rowCount > 0;
+}
+
+bool QueryExecutor::waitForFetch(const QueryJob &job, QueryResult *result)
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	// Time spent waiting for the view to scroll is not fetch time. Jobs
+	// of other owners of a shared executor wait behind the open cursor.
+	QMutexLocker locker(&m_mutex);
+
+	m_waiting = true;
+	while (m_pendingFetches == 0 && !m_closeRequested && !m_stopped && !job.token.isCancelled()) {
+		m_condition.wait(&m_mutex);
+	}
+	m_waiting = false;
+	result->timings.idle += timer.nsecsElapsed() / 1000;
+
+	if (m_closeRequested || m_stopped || job.token.isCancelled()) {
+		return false;
+	}
+
+	--m_pendingFetches;
+	return true;
+}
+
+qint64 QueryExecutor::jobTime() const
+{
+	return m_jobTimer.nsecsElapsed() / 1000;
+}
+
+bool QueryExecutor::setTimeout(QSqlQuery &query, const QueryJob &job, bool isLocal, QueryResult *result)
+{
+	if (job.statementTimeout <= 0) {
+		return true;
+	}
+
+	if (!query.exec(QString("SET %1 statement_timeout = %2").arg(isLocal ? "LOCAL" : "").arg(job.statementTimeout))) {
+		setError(job, query.lastError(), result);
+		return false;
+	}
+
+	return true;
+}
+
+void QueryExecutor::setError(const QueryJob &job, const QSqlError &error, QueryResult *result)
+{
+	if (job.token.isCancelled()) {
+		result->isCancelled = true;
+		result->error = QSqlError(tr("The query is cancelled"), error.databaseText(), QSqlError::StatementError, error.number());
+	} else {
+		result->error = error;
+	}
+}
+
+bool QueryExecutor::execStatement(QSqlQuery *query, const QString &statement, bool isCached)
+{
+	static const QRegExp invalidatingRegexp("^\\s*(create|alter|drop|truncate|comment|set|reset|discard|deallocate)\\b", Qt::CaseInsensitive);
+
+	// Plans may depend on the changed objects or settings
+	QRegExp invalidating = invalidatingRegexp;
+	if (invalidating.indexIn(statement) != -1) {
+		clearPrepared();
+	}
+
+	// Script statements mostly run once, preparing them would only add
+	// round trips; a failed PREPARE would abort an open transaction.
+	QSqlDatabase db = QSqlDatabase::database(m_executorName, false);
+	const QString &key = normalizedQuery(statement);
+	if (!isCached || !isPreparable(key) || !isTransactionIdle(db)) {
+		return query->exec(statement);
+	}
+
+	// Prepared only when the query comes again
+	if (!m_prepared.contains(key) && !m_seenQueries.contains(key)) {
+		if (m_seenQueries.size() >= maxSeenQueries) {
+			m_seenQueries.clear();
+		}
+		m_seenQueries.insert(key);
+		return query->exec(statement);
+	}
+
+	// The text is sent as written, so error positions match the editor
+	QString text = statement.trimmed();
+	while (text.endsWith(';')) {
+		text.chop(1);
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+
+	bool isHit;
+	QSqlQuery prepared(db);
+	prepared.setForwardOnly(true);
+	if (prepareCached(key, text, &prepared, &isHit) && prepared.exec()) {
+		addPreparedTime(key, isHit, timer.nsecsElapsed() / 1000);
+		*query = prepared;
+		return true;
+	}
+
+	removePrepared(key);
+	if (isHit) {
+		// The cached plan went stale, e.g. a table was changed by
+		// another session; run the text once more without it.
+		return query->exec(statement);
+	}
+
+	*query = prepared;
+	return false;
+}
+
+bool QueryExecutor::prepareCached(const QString &key, const QString &statement, QSqlQuery *query, bool *isHit)
+{
+	const QHash<QString, PreparedStatement>::const_iterator it = m_prepared.constFind(key);
+	*isHit = it != m_prepared.constEnd();
+
+	if (*isHit) {
+		*query = it.value().query;
+		m_preparedOrder.removeOne(key);
+		m_preparedOrder << key;
+		return true;
+	}
+
+	if (!query->prepare(statement)) {
+		return false;
+	}
+
+	while (m_preparedOrder.size() >= maxPreparedStatements) {
+		m_prepared.remove(m_preparedOrder.takeFirst());
+	}
+
+	PreparedStatement statement;
+	statement.query = *query;
+	statement.elapsed = 0;
+	m_prepared.insert(key, statement);
+	m_preparedOrder << key;
+	return true;
+}
+
+void QueryExecutor::addPreparedTime(const QString &key, bool isHit, qint64 elapsed)
+{
+	QHash<QString, PreparedStatement>::iterator it = m_prepared.find(key);
+	if (it == m_prepared.end()) {
+		return;
+	}
+
+	// The first run, parsed and planned, is the cost a hit is compared to
+	if (!isHit) {
+		m_preparedMisses.ref();
+		it.value().elapsed = elapsed;
+		return;
+	}
+
+	m_preparedHits.ref();
+	QMutexLocker locker(&m_mutex);
+	m_preparedTimeSaved += qMax(it.value().elapsed - elapsed, Q_INT64_C(0));
+}
+
+void QueryExecutor::removePrepared(const QString &key)
+{
+	m_prepared.remove(key);
+	m_preparedOrder.removeOne(key);
+}
+
+void QueryExecutor::clearPrepared()
+{
+	m_prepared.clear();
+	m_preparedOrder.clear();
+}
+
+QString QueryExecutor::normalizedQuery(const QString &query)
+{
+	// Whitespace runs outside quotes and comments become one space, so
+	// reformatted copies of a query share one prepared statement.
+	QString normalized;
+	normalized.reserve(query.size());
+
+	QChar quote;
+	bool isComment = false;
+	bool isSpace = false;
+	for (int i = 0, size = query.size(); i < size; i++) {
+		const QChar c = query.at(i);
+
+		if (isComment || !quote.isNull()) {
+			normalized += c;
+			if (isComment && c == '\n') {
+				isComment = false;
+			} else if (c == quote) {
+				quote = QChar();
+			}
+			continue;
+		}
+
+		if (c.isSpace()) {
+			isSpace = true;
+			continue;
+		}
+
+		if (isSpace && !normalized.isEmpty()) {
+			normalized += ' ';
+		}
+		isSpace = false;
+
+		if (c == '\'' || c == '"') {
+			quote = c;
+		} else if (c == '-' && i + 1 < size && query.at(i + 1) == '-') {
+			isComment = true;
+		}
+		normalized += c;
+	}
+
+	while (normalized.endsWith(';') || normalized.endsWith(' ')) {
+		normalized.chop(1);
+	}
+
+	return normalized;
+}
+
+bool QueryExecutor::isPreparable(const QString &normalizedQuery)
+{
+	static const QRegExp preparableRegexp("^(select|values|insert|update|delete|with)\\b", Qt::CaseInsensitive);
+	static const QRegExp placeholderRegexp("(^|[^:]):[A-Za-z_]");
+
+	QRegExp preparable = preparableRegexp;
+	QRegExp placeholder = placeholderRegexp;
+
+	// Qt would take ? and :name for bind placeholders, dollar quotes and
+	// backslash escapes are not followed by normalizedQuery()
+	return preparable.indexIn(normalizedQuery) != -1
+		   && !normalizedQuery.contains(';')
+		   && !normalizedQuery.contains('?')
+		   && !normalizedQuery.contains('$')
+		   && !normalizedQuery.contains('\\')
+		   && placeholder.indexIn(normalizedQuery) == -1;
+}
+
+bool QueryExecutor::isTransactionIdle(const QSqlDatabase &db)
+{
+	PGconn *connection = connectionHandle(db);
+	return connection && PQtransactionStatus(connection) == PQTRANS_IDLE;
+}
+
+bool QueryExecutor::isConnectionAlive(const QSqlDatabase &db)
+{
+	// Asked from libpq, a query would fail in an aborted transaction of
+	// the user (PQTRANS_INERROR) although the session is fine
+	PGconn *connection = connectionHandle(db);
+	if (!connection) {
+		return db.isOpen();
+	}
+
+	return PQstatus(connection) == CONNECTION_OK && PQtransactionStatus(connection) != PQTRANS_UNKNOWN;
+}
+
+bool QueryExecutor::isConnectionResponding(const QSqlDatabase &db)
+{
+	PGconn *connection = connectionHandle(db);
+	if (!connection) {
+		return QSqlQuery(db).exec("SELECT 1");
+	}
+
+	// An empty query is answered even in an aborted transaction of the user
+	PGresult *result = PQexec(connection, "");
+	const bool isResponding = PQresultStatus(result) == PGRES_EMPTY_QUERY;
+	PQclear(result);
+	return isResponding;
+}
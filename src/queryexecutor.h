@@ -0,0 +1,280 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#ifndef QUERYEXECUTOR_H
+#define QUERYEXECUTOR_H
+
+class QSqlDatabase;
+
+#include <QtCore/QThread>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QStringList>
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFutureSynchronizer>
+
+#include <QtSql/QSqlError>
+#include <QtSql/QSqlQuery>
+
+#include "resultstore.h"
+
+class CancellationToken
+{
+public:
+	CancellationToken();
+
+	void cancel();
+	bool isCancelled() const;
+
+	bool operator==(const CancellationToken &other) const;
+	bool operator!=(const CancellationToken &other) const;
+
+private:
+	QSharedPointer<QAtomicInt> m_cancelled;
+};
+
+struct QueryJob {
+	enum Type {
+		Execute,
+		Cursor,
+		Script,
+		File,
+		CopyOut,
+		CopyIn,
+		Batch
+	};
+
+	enum Priority {
+		LowPriority = 0,
+		NormalPriority = 50,
+		HighPriority = 100
+	};
+
+	QueryJob(const QString &query = QString(), Type type = Execute);
+
+	int id;
+	Type type;
+	QString query;
+	QString fileName;
+	QStringList statements;
+	QList<QVariantList> statementValues;
+	bool stopOnError;
+	QVariantList bindValues;
+	bool cachePrepared;
+	bool rollback;
+	int priority;
+	CancellationToken token;
+	int fetchSize;
+	int statementTimeout;
+	QElapsedTimer queueTimer;
+};
+
+/*!
+ * Phases of one job in microseconds, -1 where a phase did not happen.
+ * The executor fills all but checkout and population, which happen on
+ * the side of the consumer of the result.
+ */
+struct QueryTimings {
+	QueryTimings();
+
+	qint64 queueWait;
+	qint64 checkout;
+	qint64 connect;
+	qint64 execution;
+	qint64 firstRow;
+	qint64 fetch;
+	qint64 idle;
+	qint64 population;
+	qint64 total;
+};
+
+struct QueryResult {
+	QueryResult();
+
+	int jobId;
+	QSqlError error;
+	bool isCancelled;
+	int numRowsAffected;
+	ResultColumns columns;
+	ResultChunk rows;
+	QueryTimings timings;
+};
+
+struct StatementResult {
+	StatementResult();
+
+	int index;
+	int line;
+	qint64 position;
+	QSqlError error;
+	int numRowsAffected;
+	int rowCount;
+	qint64 elapsed;
+};
+
+Q_DECLARE_METATYPE(QueryResult)
+Q_DECLARE_METATYPE(StatementResult)
+
+/*!
+ * Long-lived worker thread with its own connection to one database.
+ * Jobs are queued by priority and executed one at a time; results come
+ * back through queued signals tagged with the job id. A connection idle
+ * for longer than idleCheckInterval() is checked before the next job and
+ * reopened if the server or a firewall dropped it.
+ */
+class QueryExecutor : public QThread
+{
+	Q_OBJECT
+
+public:
+	explicit QueryExecutor(const QString &connectionName, QObject *parent = 0);
+	virtual ~QueryExecutor();
+
+	static QueryExecutor *executor(const QString &connectionName);
+	static void closeExecutors(const QString &connectionName = QString());
+	static QStringList connectionNames();
+	static bool isCursorQuery(const QString &queryString);
+
+	QString connectionName() const;
+	qint64 waitTime() const;
+	int reconnects() const;
+	bool hasOpenCursor() const;
+	int preparedHits() const;
+	int preparedMisses() const;
+	qint64 preparedTimeSaved() const;
+	int idleCheckInterval() const;
+	void setIdleCheckInterval(int msec);
+
+	int submit(const QueryJob &job);
+	void fetchMore(int jobId);
+	void closeCursor(int jobId);
+	void cancel(const CancellationToken &token);
+	void shutdown();
+
+Q_SIGNALS:
+	void jobStarted(int jobId);
+	void columnsReady(int jobId, const ResultColumns &columns);
+	void chunkFetched(int jobId, const ResultChunk &chunk, bool atEnd);
+	void statementFinished(int jobId, const StatementResult &result);
+	void fileProgress(int jobId, qint64 position, qint64 size, int statements);
+	void copyProgress(int jobId, qint64 bytes, qint64 rows);
+	void jobFinished(int jobId, const QueryResult &result);
+
+protected:
+	virtual void run();
+
+private:
+	Q_DISABLE_COPY(QueryExecutor)
+
+	bool takeJob(QueryJob *job);
+	bool openDatabase(QueryResult *result);
+	void closeDatabase();
+
+	void executeQuery(const QueryJob &job, QueryResult *result);
+	void executeCursor(const QueryJob &job, QueryResult *result);
+	void executeScript(const QueryJob &job, QueryResult *result);
+	void executeFile(const QueryJob &job, QueryResult *result);
+	void executeCopyOut(const QueryJob &job, QueryResult *result);
+	void executeCopyIn(const QueryJob &job, QueryResult *result);
+	void executeBatch(const QueryJob &job, QueryResult *result);
+	QSqlError copyInline(const QueryJob &job, const QString &statement, const char *data, qint64 size, qint64 *pos, int *line,
+						 int *rows);
+	bool fetchChunk(QSqlQuery &query, const QueryJob &job, bool isFirst, bool *atEnd, QueryResult *result);
+	bool waitForFetch(const QueryJob &job, QueryResult *result);
+	qint64 jobTime() const;
+	bool setTimeout(QSqlQuery &query, const QueryJob &job, bool isLocal, QueryResult *result);
+	void setError(const QueryJob &job, const QSqlError &error, QueryResult *result);
+
+	bool execStatement(QSqlQuery *query, const QString &statement, bool isCached);
+	bool prepareCached(const QString &key, const QString &statement, QSqlQuery *query, bool *isHit);
+	void addPreparedTime(const QString &key, bool isHit, qint64 elapsed);
+	void removePrepared(const QString &key);
+	void clearPrepared();
+
+	void cancelBackend(const QSqlDatabase &origin, const CancellationToken &token, int backendPid);
+	bool isCurrentJob(const CancellationToken &token, int backendPid) const;
+	static QString normalizedQuery(const QString &query);
+	static bool isPreparable(const QString &normalizedQuery);
+	static bool isTransactionIdle(const QSqlDatabase &db);
+	static bool isConnectionAlive(const QSqlDatabase &db);
+	static bool isConnectionResponding(const QSqlDatabase &db);
+
+	struct PreparedStatement {
+		QSqlQuery query;
+		qint64 elapsed;
+	};
+
+private:
+	QString m_connectionName;
+	QString m_executorName;
+
+	QString m_driverName;
+	QString m_hostName;
+	int m_port;
+	QString m_databaseName;
+	QString m_userName;
+	QString m_password;
+	QString m_connectOptions;
+
+	mutable QMutex m_mutex;
+	QWaitCondition m_condition;
+	QList<QueryJob> m_queue;
+	bool m_stopped;
+
+	// Held by a cancel while it acts on the backend, the job can not change meanwhile
+	QMutex m_cancelMutex;
+	QFutureSynchronizer<void> m_cancels;
+
+	CancellationToken m_currentToken;
+	int m_cursorJobId;
+	int m_pendingFetches;
+	bool m_closeRequested;
+	bool m_waiting;
+	qint64 m_waitTime;
+	qint64 m_preparedTimeSaved;
+
+	QElapsedTimer m_jobTimer;
+	QElapsedTimer m_idleTimer;
+	QAtomicInt m_idleCheckInterval;
+
+	QAtomicInt m_backendPid;
+	QAtomicInt m_reconnects;
+	bool m_isOpened;
+
+	QHash<QString, PreparedStatement> m_prepared;
+	QStringList m_preparedOrder;
+	QSet<QString> m_seenQueries;
+	QAtomicInt m_preparedHits;
+	QAtomicInt m_preparedMisses;
+
+	static QAtomicInt s_lastJobId;
+	static QHash<QString, QueryExecutor *> s_executors;
+};
+
+#endif //QUERYEXECUTOR_H
@@ -0,0 +1,398 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <QtCore/QPair>
+#include <QtCore/QtEndian>
+
+#include <QtGui/QDesktopServices>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iterator>
+
+#include "queryhistory.h"
+
+static const char historyMagic[4] = {'Q', 'P', 'G', 'H'};
+static const quint32 historyVersion = 1;
+
+static const int headerSize = 8;
+static const int recordHeaderSize = 44;
+static const int recentRuns = 10;
+
+namespace
+{
+	QVector<quint64> trigrams(const QString &text)
+	{
+		const QString &lower = text.toLower();
+		const QChar *chars = lower.constData();
+
+		QVector<quint64> result;
+		result.reserve(qMax(lower.size() - 2, 0));
+
+		for (int i = 0; i + 2 < lower.size(); i++) {
+			result << (quint64(chars [i].unicode()) << 32 | quint64(chars [i + 1].unicode()) << 16 | chars [i + 2].unicode());
+		}
+
+		std::sort(result.begin(), result.end());
+		result.erase(std::unique(result.begin(), result.end()), result.end());
+		return result;
+	}
+
+	// values must be sorted
+	qint64 percentile(const QVector<qint64> &values, int percent)
+	{
+		if (values.isEmpty()) {
+			return -1;
+		}
+
+		return values.at(qMax(0, (values.size() * percent + 99) / 100 - 1));
+	}
+
+	bool lessBySize(const QVector<int> *left, const QVector<int> *right)
+	{
+		return left->size() < right->size();
+	}
+}
+
+QueryHistory *QueryHistory::s_instance = 0;
+
+HistoryEntry::HistoryEntry()
+	: duration(-1), rowCount(-1)
+{
+}
+
+HistoryStats::HistoryStats()
+	: runs(0), failed(0), min(-1), median(-1), p95(-1), recentMedian(-1)
+{
+}
+
+QueryHistory::QueryHistory()
+	: m_data(0), m_mappedSize(0)
+{
+	load();
+}
+
+QueryHistory::~QueryHistory()
+{
+	if (m_data) {
+		m_file.unmap(const_cast<uchar *>(m_data));
+	}
+}
+
+QueryHistory *QueryHistory::instance()
+{
+	if (!s_instance) {
+		s_instance = new QueryHistory();
+	}
+
+	return s_instance;
+}
+
+QString QueryHistory::fileName()
+{
+	return QDesktopServices::storageLocation(QDesktopServices::DataLocation) + "/history.log";
+}
+
+void QueryHistory::load()
+{
+	const QString &name = fileName();
+	QDir().mkpath(QFileInfo(name).absolutePath());
+
+	m_file.setFileName(name);
+	if (!m_file.open(QIODevice::ReadWrite | QIODevice::Append)) {
+		return;
+	}
+
+	if (m_file.size() < headerSize) {
+		uchar version [4];
+		qToLittleEndian(historyVersion, version);
+
+		m_file.resize(0);
+		m_file.write(historyMagic, 4);
+		m_file.write(reinterpret_cast<const char *>(version), 4);
+		m_file.flush();
+	}
+
+	map();
+
+	if (!m_data
+			|| std::memcmp(m_data, historyMagic, 4) != 0
+			|| qFromLittleEndian<quint32>(m_data + 4) != historyVersion) {
+		// Not ours, leave the file alone and keep no history
+		if (m_data) {
+			m_file.unmap(const_cast<uchar *>(m_data));
+			m_data = 0;
+		}
+		m_file.close();
+		return;
+	}
+
+	qint64 offset = headerSize;
+
+	while (offset + recordHeaderSize <= m_mappedSize) {
+		const uchar *record = m_data + offset;
+		const qint64 connectionSize = qFromLittleEndian<quint32>(record + 32);
+		const qint64 querySize = qFromLittleEndian<quint32>(record + 36);
+		const qint64 errorSize = qFromLittleEndian<quint32>(record + 40);
+		const qint64 size = recordHeaderSize + connectionSize + querySize + errorSize;
+
+		if (qFromLittleEndian<quint32>(record) != size - 4 || offset + size > m_mappedSize) {
+			break;
+		}
+
+		Run run;
+		run.offset = offset;
+		run.time = qFromLittleEndian<qint64>(record + 4);
+		run.duration = qFromLittleEndian<qint64>(record + 12);
+		run.isFailed = record [28] != 0;
+
+		addRun(QString::fromUtf8(reinterpret_cast<const char *>(record + recordHeaderSize + connectionSize), querySize), run);
+		offset += size;
+	}
+
+	if (offset < m_mappedSize) {
+		m_file.unmap(const_cast<uchar *>(m_data));
+		m_data = 0;
+		m_file.resize(offset);
+		map();
+	}
+}
+
+void QueryHistory::map()
+{
+	if (m_data) {
+		m_file.unmap(const_cast<uchar *>(m_data));
+	}
+
+	m_mappedSize = m_file.size();
+	m_data = m_mappedSize > 0 ? m_file.map(0, m_mappedSize) : 0;
+}
+
+bool QueryHistory::add(const HistoryEntry &entry)
+{
+	if (!m_file.isOpen()) {
+		return false;
+	}
+
+	const QByteArray &connectionName = entry.connectionName.toUtf8();
+	const QByteArray &query = entry.query.toUtf8();
+	const QByteArray &error = entry.error.toUtf8();
+
+	Run run;
+	run.offset = m_file.size();
+	run.time = entry.time.toMSecsSinceEpoch();
+	run.duration = entry.duration;
+	run.isFailed = !entry.error.isEmpty();
+
+	QByteArray record(recordHeaderSize, '\0');
+	uchar *header = reinterpret_cast<uchar *>(record.data());
+	qToLittleEndian(quint32(recordHeaderSize - 4 + connectionName.size() + query.size() + error.size()), header);
+	qToLittleEndian(run.time, header + 4);
+	qToLittleEndian(run.duration, header + 12);
+	qToLittleEndian(entry.rowCount, header + 20);
+	header [28] = run.isFailed ? 1 : 0;
+	qToLittleEndian(quint32(connectionName.size()), header + 32);
+	qToLittleEndian(quint32(query.size()), header + 36);
+	qToLittleEndian(quint32(error.size()), header + 40);
+
+	record.append(connectionName);
+	record.append(query);
+	record.append(error);
+
+	if (m_file.write(record) != record.size() || !m_file.flush()) {
+		return false;
+	}
+
+	map();
+	addRun(entry.query, run);
+	return true;
+}
+
+void QueryHistory::addRun(const QString &query, const Run &run)
+{
+	const QString &text = query.simplified();
+	int id = m_queryIds.value(text, -1);
+
+	if (id < 0) {
+		id = m_queries.size();
+
+		Query q;
+		q.text = text;
+		m_queries << q;
+		m_queryIds.insert(text, id);
+
+		// Ids only grow, so every posting list stays sorted
+		foreach(quint64 trigram, trigrams(text)) {
+			m_trigrams [trigram] << id;
+		}
+	}
+
+	m_queries [id].runs << m_runs.size();
+	m_runs << run;
+}
+
+int QueryHistory::queryCount() const
+{
+	return m_queries.size();
+}
+
+QString QueryHistory::query(int id) const
+{
+	return m_queries.value(id).text;
+}
+
+QList<int> QueryHistory::search(const QString &pattern, int limit) const
+{
+	const QString &needle = pattern.simplified();
+	QVector<int> candidates;
+
+	if (needle.size() < 3) {
+		candidates.resize(m_queries.size());
+		for (int i = 0; i < candidates.size(); i++) {
+			candidates [i] = i;
+		}
+	} else {
+		QVector<const QVector<int> *> postings;
+
+		foreach(quint64 trigram, trigrams(needle)) {
+			QHash<quint64, QVector<int> >::const_iterator it = m_trigrams.constFind(trigram);
+			if (it == m_trigrams.constEnd()) {
+				return QList<int>();
+			}
+			postings << &it.value();
+		}
+
+		// Intersect starting from the rarest trigram
+		std::sort(postings.begin(), postings.end(), lessBySize);
+		candidates = *postings.first();
+
+		for (int i = 1; i < postings.size() && !candidates.isEmpty(); i++) {
+			QVector<int> matched;
+			std::set_intersection(candidates.constBegin(), candidates.constEnd(),
+								  postings.at(i)->constBegin(), postings.at(i)->constEnd(),
+								  std::back_inserter(matched));
+			candidates = matched;
+		}
+	}
+
+	// Trigrams only narrow the set down, the order of them is checked here
+	QVector<QPair<qint64, int> > found;
+	foreach(int id, candidates) {
+		const Query &q = m_queries.at(id);
+		if (needle.isEmpty() || q.text.contains(needle, Qt::CaseInsensitive)) {
+			found << qMakePair(m_runs.at(q.runs.last()).time, id);
+		}
+	}
+
+	const int count = qMin(limit, found.size());
+	std::partial_sort(found.begin(), found.begin() + count, found.end(), std::greater<QPair<qint64, int> >());
+
+	QList<int> result;
+	for (int i = 0; i < count; i++) {
+		result << found.at(i).second;
+	}
+
+	return result;
+}
+
+HistoryStats QueryHistory::stats(int id) const
+{
+	HistoryStats stats;
+	if (id < 0 || id >= m_queries.size()) {
+		return stats;
+	}
+
+	QVector<qint64> durations;
+
+	foreach(int index, m_queries.at(id).runs) {
+		const Run &run = m_runs.at(index);
+
+		++stats.runs;
+		if (run.isFailed) {
+			++stats.failed;
+		} else if (run.duration >= 0) {
+			durations << run.duration;
+		}
+	}
+
+	stats.lastRun = QDateTime::fromMSecsSinceEpoch(m_runs.at(m_queries.at(id).runs.last()).time);
+
+	QVector<qint64> recent = durations.mid(qMax(0, durations.size() - recentRuns));
+	std::sort(recent.begin(), recent.end());
+	stats.recentMedian = percentile(recent, 50);
+
+	std::sort(durations.begin(), durations.end());
+	stats.min = durations.isEmpty() ? -1 : durations.first();
+	stats.median = percentile(durations, 50);
+	stats.p95 = percentile(durations, 95);
+
+	return stats;
+}
+
+QList<HistoryEntry> QueryHistory::entries(int id, int limit) const
+{
+	// Newest first
+	QList<HistoryEntry> result;
+	const QVector<int> runs = m_queries.value(id).runs;
+	const int first = limit < 0 ? 0 : qMax(0, runs.size() - limit);
+
+	for (int i = runs.size() - 1; i >= first; i--) {
+		HistoryEntry entry;
+		if (readEntry(m_runs.at(runs.at(i)).offset, &entry)) {
+			result << entry;
+		}
+	}
+
+	return result;
+}
+
+bool QueryHistory::readEntry(qint64 offset, HistoryEntry *entry) const
+{
+	if (!m_data || offset + recordHeaderSize > m_mappedSize) {
+		return false;
+	}
+
+	const uchar *record = m_data + offset;
+	const quint32 connectionSize = qFromLittleEndian<quint32>(record + 32);
+	const quint32 querySize = qFromLittleEndian<quint32>(record + 36);
+	const quint32 errorSize = qFromLittleEndian<quint32>(record + 40);
+
+	if (offset + recordHeaderSize + qint64(connectionSize) + querySize + errorSize > m_mappedSize) {
+		return false;
+	}
+
+	const char *strings = reinterpret_cast<const char *>(record + recordHeaderSize);
+
+	entry->time = QDateTime::fromMSecsSinceEpoch(qFromLittleEndian<qint64>(record + 4));
+	entry->duration = qFromLittleEndian<qint64>(record + 12);
+	entry->rowCount = qFromLittleEndian<qint64>(record + 20);
+	entry->connectionName = QString::fromUtf8(strings, connectionSize);
+	entry->query = QString::fromUtf8(strings + connectionSize, querySize);
+	entry->error = QString::fromUtf8(strings + connectionSize + querySize, errorSize);
+	return true;
+}
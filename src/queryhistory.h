@@ -0,0 +1,119 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#ifndef QUERYHISTORY_H
+#define QUERYHISTORY_H
+
+#include <QtCore/QFile>
+#include <QtCore/QDateTime>
+#include <QtCore/QHash>
+#include <QtCore/QVector>
+#include <QtCore/QStringList>
+
+struct HistoryEntry {
+	HistoryEntry();
+
+	QDateTime time;
+	QString connectionName;
+	QString query;
+	qint64 duration; // usec
+	qint64 rowCount;
+	QString error;
+};
+
+/*!
+ * Durations in usec of the successful runs of one query.
+ * recentMedian covers only the last runs, so a value well above median
+ * means the query got slower lately.
+ */
+struct HistoryStats {
+	HistoryStats();
+
+	int runs;
+	int failed;
+	qint64 min;
+	qint64 median;
+	qint64 p95;
+	qint64 recentMedian;
+	QDateTime lastRun;
+};
+
+/*!
+ * Every query executed from the SQL editors, kept in an append-only log
+ * file that is read through a memory mapping. Runs of the same query text
+ * (whitespace ignored) are grouped under one query id, and the distinct
+ * texts are indexed by trigrams for case-insensitive substring search.
+ * A torn record at the end of the log, left by a crash, is cut off on load.
+ * Used from the GUI thread only.
+ */
+class QueryHistory
+{
+public:
+	static QueryHistory *instance();
+	static QString fileName();
+
+	bool add(const HistoryEntry &entry);
+
+	int queryCount() const;
+	QString query(int id) const;
+	QList<int> search(const QString &pattern, int limit) const;
+	HistoryStats stats(int id) const;
+	QList<HistoryEntry> entries(int id, int limit = -1) const;
+
+private:
+	QueryHistory();
+	~QueryHistory();
+	Q_DISABLE_COPY(QueryHistory)
+
+	struct Run {
+		qint64 offset;
+		qint64 time;
+		qint64 duration;
+		bool isFailed;
+	};
+
+	struct Query {
+		QString text;
+		QVector<int> runs;
+	};
+
+	void load();
+	void map();
+	void addRun(const QString &query, const Run &run);
+	bool readEntry(qint64 offset, HistoryEntry *entry) const;
+
+private:
+	QFile m_file;
+	const uchar *m_data;
+	qint64 m_mappedSize;
+	QVector<Run> m_runs;
+	QVector<Query> m_queries;
+	QHash<QString, int> m_queryIds;
+	QHash<quint64, QVector<int> > m_trigrams;
+
+	static QueryHistory *s_instance;
+};
+
+#endif //QUERYHISTORY_H
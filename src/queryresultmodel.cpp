@@ -0,0 +1,150 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#include "queryresultmodel.h"
+
+QueryResultModel::QueryResultModel(QObject *parent)
+	: QAbstractTableModel(parent)
+	, m_memoryLimit(Q_INT64_C(512) * 1024 * 1024)
+	, m_atEnd(true)
+	, m_fetching(false)
+{
+	qRegisterMetaType<ResultColumns>("ResultColumns");
+	qRegisterMetaType<ResultChunk>("ResultChunk");
+}
+
+QueryResultModel::~QueryResultModel()
+{
+
+}
+
+qint64 QueryResultModel::memoryLimit() const
+{
+	return m_memoryLimit;
+}
+
+void QueryResultModel::setMemoryLimit(qint64 memoryLimit)
+{
+	m_memoryLimit = memoryLimit;
+}
+
+qint64 QueryResultModel::byteSize() const
+{
+	return m_store.byteSize();
+}
+
+bool QueryResultModel::isTruncated() const
+{
+	return !m_atEnd && m_store.byteSize() >= m_memoryLimit;
+}
+
+bool QueryResultModel::isComplete() const
+{
+	return m_atEnd;
+}
+
+int QueryResultModel::rowCount(const QModelIndex &parent) const
+{
+	return parent.isValid() ? 0 : m_store.rowCount();
+}
+
+int QueryResultModel::columnCount(const QModelIndex &parent) const
+{
+	return parent.isValid() ? 0 : m_store.columnCount();
+}
+
+QVariant QueryResultModel::data(const QModelIndex &index, int role) const
+{
+	if (!index.isValid() || (role != Qt::DisplayRole && role != Qt::EditRole)) {
+		return QVariant();
+	}
+
+	return m_store.value(index.row(), index.column());
+}
+
+QVariant QueryResultModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+	if (role != Qt::DisplayRole) {
+		return QVariant();
+	}
+
+	if (orientation == Qt::Horizontal) {
+		return m_store.columns().value(section).name;
+	}
+
+	return section + 1;
+}
+
+bool QueryResultModel::canFetchMore(const QModelIndex &parent) const
+{
+	if (parent.isValid()) {
+		return false;
+	}
+
+	return !m_atEnd && !m_fetching && m_store.byteSize() < m_memoryLimit;
+}
+
+void QueryResultModel::fetchMore(const QModelIndex &parent)
+{
+	if (!canFetchMore(parent)) {
+		return;
+	}
+
+	m_fetching = true;
+	emit fetchRequested();
+}
+
+void QueryResultModel::clear()
+{
+	beginResetModel();
+	m_store.clear();
+	m_atEnd = true;
+	m_fetching = false;
+	endResetModel();
+}
+
+void QueryResultModel::setColumns(const ResultColumns &columns)
+{
+	beginResetModel();
+	m_store.setColumns(columns);
+	m_atEnd = false;
+	m_fetching = true;
+	endResetModel();
+}
+
+void QueryResultModel::appendChunk(const ResultChunk &chunk, bool atEnd)
+{
+	m_fetching = false;
+	m_atEnd = atEnd;
+
+	if (chunk.rowCount() == 0) {
+		return;
+	}
+
+	const int rowCount = m_store.rowCount();
+	beginInsertRows(QModelIndex(), rowCount, rowCount + chunk.rowCount() - 1);
+	m_store.append(chunk);
+	endInsertRows();
+}
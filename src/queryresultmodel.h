@@ -0,0 +1,78 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+#ifndef QUERYRESULTMODEL_H
+#define QUERYRESULTMODEL_H
+
+#include <QtCore/QAbstractTableModel>
+
+#include "resultstore.h"
+
+/*!
+ * Result grid model filled in batches by QueryExecutor.
+ * Rows are appended as the worker fetches them from the server cursor,
+ * more rows are requested only when the view scrolls to the end.
+ */
+class QueryResultModel : public QAbstractTableModel
+{
+	Q_OBJECT
+
+public:
+	explicit QueryResultModel(QObject *parent = 0);
+	virtual ~QueryResultModel();
+
+	qint64 memoryLimit() const;
+	void setMemoryLimit(qint64 memoryLimit);
+	qint64 byteSize() const;
+
+	bool isTruncated() const;
+	bool isComplete() const;
+
+	virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
+	virtual int columnCount(const QModelIndex &parent = QModelIndex()) const;
+	virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+	virtual QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+
+	virtual bool canFetchMore(const QModelIndex &parent) const;
+	virtual void fetchMore(const QModelIndex &parent);
+
+public Q_SLOTS:
+	void clear();
+	void setColumns(const ResultColumns &columns);
+	void appendChunk(const ResultChunk &chunk, bool atEnd);
+
+Q_SIGNALS:
+	void fetchRequested();
+
+private:
+	Q_DISABLE_COPY(QueryResultModel)
+
+private:
+	ResultStore m_store;
+	qint64 m_memoryLimit;
+	bool m_atEnd;
+	bool m_fetching;
+};
+
+#endif //QUERYRESULTMODEL_H
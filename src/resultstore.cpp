@@ -0,0 +1,429 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#include <QtCore/QDateTime>
+
+#include <QtSql/QSqlQuery>
+#include <QtSql/QSqlRecord>
+#include <QtSql/QSqlField>
+
+#include <algorithm>
+#include <cstring>
+
+#include "resultstore.h"
+
+static const int numericTypeId = 1700;
+static const qint64 invalidValue = Q_INT64_C(-9223372036854775807) - 1;
+
+static int align(int pos)
+{
+	return (pos + 7) & ~7;
+}
+
+ResultColumn::Type ResultColumn::typeOf(QVariant::Type variantType)
+{
+	switch (variantType) {
+	case QVariant::Int: case QVariant::UInt: case QVariant::LongLong: case QVariant::ULongLong:
+		return Integer;
+	case QVariant::Double:
+		return Real;
+	case QVariant::Bool:
+		return Boolean;
+	case QVariant::DateTime:
+		return DateTime;
+	case QVariant::Date:
+		return Date;
+	case QVariant::Time:
+		return Time;
+	case QVariant::ByteArray:
+		return Binary;
+	default:
+		return Text;
+	}
+}
+
+int ResultColumn::width(Type type)
+{
+	switch (type) {
+	case Integer: case Real: case DateTime: case Date:
+		return 8;
+	case Time:
+		return 4;
+	case Boolean:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+class ResultChunkData : public QSharedData
+{
+public:
+	struct Layout {
+		int nulls;
+		int values;
+		int offsets;
+		int bytes;
+	};
+
+	ResultChunkData()
+		: rowCount(0)
+	{}
+
+	int rowCount;
+	QVector<ResultColumn::Type> types;
+	QVector<Layout> layout;
+	QByteArray buffer;
+};
+
+ResultChunk::ResultChunk()
+	: d(new ResultChunkData())
+{
+
+}
+
+ResultChunk::ResultChunk(const ResultChunk &other)
+	: d(other.d)
+{
+
+}
+
+ResultChunk::~ResultChunk()
+{
+
+}
+
+ResultChunk &ResultChunk::operator=(const ResultChunk &other)
+{
+	d = other.d;
+	return *this;
+}
+
+int ResultChunk::rowCount() const
+{
+	return d->rowCount;
+}
+
+int ResultChunk::columnCount() const
+{
+	return d->types.size();
+}
+
+qint64 ResultChunk::byteSize() const
+{
+	return d->buffer.size();
+}
+
+bool ResultChunk::isNull(int row, int column) const
+{
+	const char *nulls = d->buffer.constData() + d->layout.at(column).nulls;
+	return nulls [row >> 3] & (1 << (row & 7));
+}
+
+QVariant ResultChunk::value(int row, int column) const
+{
+	const ResultColumn::Type type = d->types.at(column);
+
+	if (isNull(row, column)) {
+		return QVariant();
+	}
+
+	const ResultChunkData::Layout &layout = d->layout.at(column);
+	const char *base = d->buffer.constData();
+
+	if (type == ResultColumn::Text || type == ResultColumn::Binary) {
+		const quint32 *offsets = reinterpret_cast<const quint32 *>(base + layout.offsets);
+		const char *bytes = base + layout.bytes + offsets [row];
+		const int size = offsets [row + 1] - offsets [row];
+		return type == ResultColumn::Text
+			   ? QVariant(QString::fromUtf8(bytes, size))
+			   : QVariant(QByteArray(bytes, size));
+	}
+
+	const char *value = base + layout.values + row * ResultColumn::width(type);
+
+	switch (type) {
+	case ResultColumn::Boolean:
+		return bool(*value);
+	case ResultColumn::Time: {
+		qint32 msecs;
+		memcpy(&msecs, value, sizeof(msecs));
+		return msecs < 0 ? QTime() : QTime(0, 0).addMSecs(msecs);
+	}
+	case ResultColumn::Real: {
+		double real;
+		memcpy(&real, value, sizeof(real));
+		return real;
+	}
+	default:
+		break;
+	}
+
+	qint64 integer;
+	memcpy(&integer, value, sizeof(integer));
+
+	switch (type) {
+	case ResultColumn::DateTime:
+		return integer == invalidValue ? QDateTime() : QDateTime::fromMSecsSinceEpoch(integer);
+	case ResultColumn::Date:
+		return integer == invalidValue ? QDate() : QDate::fromJulianDay(integer);
+	default:
+		return integer;
+	}
+}
+
+ResultChunkBuilder::ResultChunkBuilder(const ResultColumns &columns, int capacity)
+	: m_buffers(columns.size())
+	, m_rowCount(0)
+{
+	for (int i = 0, count = columns.size(); i < count; i++) {
+		ColumnBuffer &buffer = m_buffers [i];
+		buffer.type = columns.at(i).type;
+		buffer.values.reserve(capacity * ResultColumn::width(buffer.type));
+		if (ResultColumn::width(buffer.type) == 0) {
+			buffer.offsets.reserve(capacity + 1);
+			buffer.offsets.append(0);
+		}
+	}
+}
+
+ResultChunkBuilder::~ResultChunkBuilder()
+{
+
+}
+
+int ResultChunkBuilder::rowCount() const
+{
+	return m_rowCount;
+}
+
+void ResultChunkBuilder::addRow(const QSqlQuery &query)
+{
+	for (int i = 0, count = m_buffers.size(); i < count; i++) {
+		addValue(i, query.value(i));
+	}
+	++m_rowCount;
+}
+
+void ResultChunkBuilder::addRow(const QVector<QVariant> &values)
+{
+	for (int i = 0, count = m_buffers.size(); i < count; i++) {
+		addValue(i, values.value(i));
+	}
+	++m_rowCount;
+}
+
+void ResultChunkBuilder::addValue(int column, const QVariant &value)
+{
+	ColumnBuffer &buffer = m_buffers [column];
+
+	if ((m_rowCount >> 3) >= buffer.nulls.size()) {
+		buffer.nulls.append('\0');
+	}
+
+	const bool isNull = value.isNull();
+	if (isNull) {
+		buffer.nulls.data() [m_rowCount >> 3] |= char(1 << (m_rowCount & 7));
+	}
+
+	switch (buffer.type) {
+	case ResultColumn::Text: case ResultColumn::Binary:
+		if (!isNull) {
+			buffer.bytes += buffer.type == ResultColumn::Text ? value.toString().toUtf8() : value.toByteArray();
+		}
+		buffer.offsets.append(buffer.bytes.size());
+		return;
+	case ResultColumn::Boolean:
+		buffer.values.append(char(!isNull && value.toBool()));
+		return;
+	case ResultColumn::Time: {
+		const QTime time = value.toTime();
+		const qint32 msecs = time.isValid() ? QTime(0, 0).msecsTo(time) : -1;
+		buffer.values.append(reinterpret_cast<const char *>(&msecs), sizeof(msecs));
+		return;
+	}
+	case ResultColumn::Real: {
+		const double real = isNull ? 0 : value.toDouble();
+		buffer.values.append(reinterpret_cast<const char *>(&real), sizeof(real));
+		return;
+	}
+	default:
+		break;
+	}
+
+	qint64 integer = 0;
+	if (!isNull) {
+		switch (buffer.type) {
+		case ResultColumn::DateTime: {
+			const QDateTime dateTime = value.toDateTime();
+			integer = dateTime.isValid() ? dateTime.toMSecsSinceEpoch() : invalidValue;
+			break;
+		}
+		case ResultColumn::Date: {
+			const QDate date = value.toDate();
+			integer = date.isValid() ? date.toJulianDay() : invalidValue;
+			break;
+		}
+		default:
+			integer = value.toLongLong();
+			break;
+		}
+	}
+	buffer.values.append(reinterpret_cast<const char *>(&integer), sizeof(integer));
+}
+
+ResultChunk ResultChunkBuilder::finish()
+{
+	ResultChunkData *data = new ResultChunkData();
+	data->rowCount = m_rowCount;
+	data->types.resize(m_buffers.size());
+	data->layout.resize(m_buffers.size());
+
+	int size = 0;
+	for (int i = 0, count = m_buffers.size(); i < count; i++) {
+		const ColumnBuffer &buffer = m_buffers.at(i);
+		ResultChunkData::Layout &layout = data->layout [i];
+
+		data->types [i] = buffer.type;
+		layout.nulls = size;
+		size = align(size + buffer.nulls.size());
+		layout.values = size;
+		size = align(size + buffer.values.size());
+		layout.offsets = size;
+		size = align(size + buffer.offsets.size() * sizeof(quint32));
+		layout.bytes = size;
+		size = align(size + buffer.bytes.size());
+	}
+
+	data->buffer.resize(size);
+	char *base = data->buffer.data();
+
+	for (int i = 0, count = m_buffers.size(); i < count; i++) {
+		const ColumnBuffer &buffer = m_buffers.at(i);
+		const ResultChunkData::Layout &layout = data->layout.at(i);
+
+		memcpy(base + layout.nulls, buffer.nulls.constData(), buffer.nulls.size());
+		memcpy(base + layout.values, buffer.values.constData(), buffer.values.size());
+		memcpy(base + layout.offsets, buffer.offsets.constData(), buffer.offsets.size() * sizeof(quint32));
+		memcpy(base + layout.bytes, buffer.bytes.constData(), buffer.bytes.size());
+	}
+
+	ResultChunk chunk;
+	chunk.d = data;
+
+	m_buffers.clear();
+	m_rowCount = 0;
+
+	return chunk;
+}
+
+ResultStore::ResultStore()
+	: m_rowCount(0)
+	, m_byteSize(0)
+{
+
+}
+
+ResultStore::~ResultStore()
+{
+
+}
+
+ResultColumns ResultStore::columns() const
+{
+	return m_columns;
+}
+
+void ResultStore::setColumns(const ResultColumns &columns)
+{
+	clear();
+	m_columns = columns;
+}
+
+int ResultStore::rowCount() const
+{
+	return m_rowCount;
+}
+
+int ResultStore::columnCount() const
+{
+	return m_columns.size();
+}
+
+qint64 ResultStore::byteSize() const
+{
+	return m_byteSize;
+}
+
+void ResultStore::append(const ResultChunk &chunk)
+{
+	if (chunk.rowCount() == 0) {
+		return;
+	}
+
+	m_firstRows.append(m_rowCount);
+	m_chunks.append(chunk);
+	m_rowCount += chunk.rowCount();
+	m_byteSize += chunk.byteSize();
+}
+
+void ResultStore::clear()
+{
+	m_columns.clear();
+	m_chunks.clear();
+	m_firstRows.clear();
+	m_rowCount = 0;
+	m_byteSize = 0;
+}
+
+bool ResultStore::isNull(int row, int column) const
+{
+	const int index = chunkIndex(row);
+	return m_chunks.at(index).isNull(row - m_firstRows.at(index), column);
+}
+
+QVariant ResultStore::value(int row, int column) const
+{
+	const int index = chunkIndex(row);
+	return m_chunks.at(index).value(row - m_firstRows.at(index), column);
+}
+
+int ResultStore::chunkIndex(int row) const
+{
+	return std::upper_bound(m_firstRows.constBegin(), m_firstRows.constEnd(), row) - m_firstRows.constBegin() - 1;
+}
+
+ResultColumns ResultStore::columnsOf(const QSqlRecord &record)
+{
+	ResultColumns columns(record.count());
+
+	for (int i = 0, count = record.count(); i < count; i++) {
+		const QSqlField &field = record.field(i);
+		columns [i].name = field.name();
+		columns [i].type = field.typeID() == numericTypeId ? ResultColumn::Text : ResultColumn::typeOf(field.type());
+	}
+
+	return columns;
+}
@@ -0,0 +1,156 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#ifndef RESULTSTORE_H
+#define RESULTSTORE_H
+
+class QSqlQuery;
+class QSqlRecord;
+
+#include <QtCore/QSharedDataPointer>
+#include <QtCore/QByteArray>
+#include <QtCore/QVector>
+#include <QtCore/QList>
+#include <QtCore/QVariant>
+
+struct ResultColumn {
+	enum Type {
+		Integer,
+		Real,
+		Boolean,
+		DateTime,
+		Date,
+		Time,
+		Text,
+		Binary
+	};
+
+	QString name;
+	Type type;
+
+	static Type typeOf(QVariant::Type variantType);
+	static int width(Type type);
+};
+
+typedef QVector<ResultColumn> ResultColumns;
+
+class ResultChunkData;
+
+/*!
+ * One batch of rows stored column by column in a single allocation:
+ * fixed-width arrays for numbers, booleans and timestamps, offsets plus
+ * UTF-8 bytes for text, and a null bitmap per column.
+ * The chunk is immutable and implicitly shared, so it can be built in the
+ * worker thread and passed to the GUI thread without copying.
+ */
+class ResultChunk
+{
+public:
+	ResultChunk();
+	ResultChunk(const ResultChunk &other);
+	~ResultChunk();
+	ResultChunk &operator=(const ResultChunk &other);
+
+	int rowCount() const;
+	int columnCount() const;
+	qint64 byteSize() const;
+
+	bool isNull(int row, int column) const;
+	QVariant value(int row, int column) const;
+
+private:
+	friend class ResultChunkBuilder;
+	QSharedDataPointer<ResultChunkData> d;
+};
+
+class ResultChunkBuilder
+{
+public:
+	ResultChunkBuilder(const ResultColumns &columns, int capacity);
+	~ResultChunkBuilder();
+
+	int rowCount() const;
+
+	void addRow(const QSqlQuery &query);
+	void addRow(const QVector<QVariant> &values);
+	ResultChunk finish();
+
+private:
+	Q_DISABLE_COPY(ResultChunkBuilder)
+
+	void addValue(int column, const QVariant &value);
+
+	struct ColumnBuffer {
+		ResultColumn::Type type;
+		QByteArray nulls;
+		QByteArray values;
+		QVector<quint32> offsets;
+		QByteArray bytes;
+	};
+
+private:
+	QVector<ColumnBuffer> m_buffers;
+	int m_rowCount;
+};
+
+/*!
+ * Whole query result as a list of chunks with a row index over them.
+ */
+class ResultStore
+{
+public:
+	ResultStore();
+	~ResultStore();
+
+	ResultColumns columns() const;
+	void setColumns(const ResultColumns &columns);
+
+	int rowCount() const;
+	int columnCount() const;
+	qint64 byteSize() const;
+
+	void append(const ResultChunk &chunk);
+	void clear();
+
+	bool isNull(int row, int column) const;
+	QVariant value(int row, int column) const;
+
+	static ResultColumns columnsOf(const QSqlRecord &record);
+
+private:
+	int chunkIndex(int row) const;
+
+private:
+	ResultColumns m_columns;
+	QList<ResultChunk> m_chunks;
+	QVector<int> m_firstRows;
+	int m_rowCount;
+	qint64 m_byteSize;
+};
+
+Q_DECLARE_METATYPE(ResultColumns)
+Q_DECLARE_METATYPE(ResultChunk)
+
+#endif //RESULTSTORE_H
@@ -0,0 +1,529 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#include <QtCore/QEvent>
+#include <QtCore/QHash>
+#include <QtCore/QPair>
+#include <QtCore/QSet>
+#include <QtCore/QTimer>
+#include <QtCore/QVector>
+
+#include <QtGui/QAbstractItemView>
+#include <QtGui/QCompleter>
+#include <QtGui/QKeyEvent>
+#include <QtGui/QPlainTextEdit>
+#include <QtGui/QScrollBar>
+#include <QtGui/QStringListModel>
+#include <QtGui/QTextBlock>
+#include <QtGui/QTextCursor>
+#include <QtGui/QTextDocument>
+
+#include <algorithm>
+#include <cstring>
+
+#include "sqlcompleter.h"
+#include "completionindex.h"
+#include "sqlsplitter.h"
+
+static const int maxItems = 200;
+
+namespace
+{
+
+// Sorted, lower case; words that can not be a bare alias and need quotes as a name
+static const char *const keywords[] = {
+	"all", "analyse", "analyze", "and", "any", "array", "as", "asc",
+	"asymmetric", "both", "case", "cast", "check", "collate", "column",
+	"constraint", "create", "cross", "current_date", "current_role",
+	"current_time", "current_timestamp", "current_user", "default",
+	"deferrable", "desc", "distinct", "do", "else", "end", "except", "false",
+	"fetch", "for", "foreign", "from", "full", "grant", "group", "having",
+	"in", "initially", "inner", "intersect", "into", "join", "lateral",
+	"leading", "left", "limit", "localtime", "localtimestamp", "natural",
+	"not", "null", "offset", "on", "only", "or", "order", "outer", "placing",
+	"primary", "references", "returning", "right", "select", "session_user",
+	"set", "some", "symmetric", "table", "tablesample", "then", "to",
+	"trailing", "true", "union", "unique", "update", "user", "using",
+	"values", "variadic", "when", "where", "window", "with"
+};
+
+struct WordLess {
+	bool operator()(const char *left, const char *right) const {
+		return std::strcmp(left, right) < 0;
+	}
+};
+
+bool isKeyword(const QString &word)
+{
+	const QByteArray &key = word.toLower().toLatin1();
+	const char *const *end = keywords + sizeof(keywords) / sizeof(*keywords);
+	const char *const *it = std::lower_bound(keywords, end, key.constData(), WordLess());
+	return it != end && key == *it;
+}
+
+inline bool isIdentifierStart(QChar c)
+{
+	return c.isLetter() || c == '_';
+}
+
+inline bool isIdentifierChar(QChar c)
+{
+	return c.isLetterOrNumber() || c == '_' || c == '$';
+}
+
+struct Token {
+	enum Type {
+		Name,
+		Keyword,
+		Dot,
+		Comma,
+		Other
+	};
+
+	Type type;
+	int offset;
+	// Unquoted names folded to lower case as the server does
+	QString text;
+};
+
+typedef QPair<QString, QString> Relation;
+
+QVector<Token> tokenize(const QString &text)
+{
+	QVector<Token> tokens;
+	const QChar *data = text.constData();
+	const int size = text.size();
+
+	int pos = 0;
+	while (pos < size) {
+		const QChar c = data [pos];
+		const QChar n = pos + 1 < size ? data [pos + 1] : QChar();
+
+		Token token;
+		token.type = Token::Other;
+		token.offset = pos;
+
+		if (c.isSpace()) {
+			++pos;
+			continue;
+		} else if (c == '-' && n == '-') {
+			while (pos < size && data [pos] != '\n') {
+				++pos;
+			}
+			continue;
+		} else if (c == '/' && n == '*') {
+			const int end = text.indexOf("*/", pos + 2);
+			pos = end < 0 ? size : end + 2;
+			continue;
+		} else if (c == '\'') {
+			for (++pos; pos < size; ++pos) {
+				if (data [pos] == '\'') {
+					if (pos + 1 >= size || data [pos + 1] != '\'') {
+						break;
+					}
+					++pos;
+				}
+			}
+			++pos;
+		} else if (c == '"') {
+			token.type = Token::Name;
+			for (++pos; pos < size; ++pos) {
+				if (data [pos] == '"') {
+					if (pos + 1 >= size || data [pos + 1] != '"') {
+						break;
+					}
+					++pos;
+				}
+				token.text += data [pos];
+			}
+			++pos;
+		} else if (isIdentifierStart(c)) {
+			const int start = pos;
+			while (pos < size && isIdentifierChar(data [pos])) {
+				++pos;
+			}
+			token.text = text.mid(start, pos - start).toLower();
+			token.type = isKeyword(token.text) ? Token::Keyword : Token::Name;
+		} else if (c.isDigit()) {
+			while (pos < size && (isIdentifierChar(data [pos]) || data [pos] == '.')) {
+				++pos;
+			}
+		} else {
+			token.type = c == '.' ? Token::Dot : c == ',' ? Token::Comma : Token::Other;
+			++pos;
+		}
+
+		tokens << token;
+	}
+
+	return tokens;
+}
+
+/*
+ * Walks the tokens, collecting the relations of FROM lists, JOIN, UPDATE
+ * and INTO clauses by their alias and by their own name.
+ * Returns whether a relation name is expected after the last token.
+ */
+bool scan(const QVector<Token> &tokens, QHash<QString, Relation> *aliases)
+{
+	bool isFromList = false;
+	bool isRelationExpected = false;
+
+	for (int i = 0; i < tokens.size(); i++) {
+		const Token &token = tokens.at(i);
+
+		if (token.type == Token::Keyword) {
+			const QString &word = token.text;
+			if (word == "from" || word == "join" || word == "update" || word == "into" || word == "table") {
+				isRelationExpected = true;
+				isFromList = isFromList || word == "from";
+			} else if (word == "only" || word == "lateral") {
+				// FROM ONLY relation
+			} else {
+				isRelationExpected = false;
+				isFromList = isFromList && (word == "as" || word == "left" || word == "right" || word == "inner"
+											|| word == "outer" || word == "full" || word == "cross" || word == "natural"
+											|| word == "on" || word == "using");
+			}
+		} else if (token.type == Token::Comma) {
+			isRelationExpected = isFromList;
+		} else if (token.type == Token::Name && isRelationExpected) {
+			// [scheme.]relation [[AS] alias]
+			QStringList names;
+			names << token.text;
+			while (i + 2 < tokens.size() && tokens.at(i + 1).type == Token::Dot && tokens.at(i + 2).type == Token::Name) {
+				names << tokens.at(i + 2).text;
+				i += 2;
+			}
+
+			const Relation relation(names.size() > 1 ? names.at(names.size() - 2) : QString(), names.last());
+			aliases->insert(relation.second, relation);
+
+			int next = i + 1;
+			if (next < tokens.size() && tokens.at(next).type == Token::Keyword && tokens.at(next).text == "as") {
+				++next;
+			}
+			if (next < tokens.size() && tokens.at(next).type == Token::Name) {
+				aliases->insert(tokens.at(next).text, relation);
+				i = next;
+			}
+
+			isRelationExpected = false;
+		} else {
+			isRelationExpected = false;
+		}
+	}
+
+	return isRelationExpected;
+}
+
+QString quoted(const QString &name)
+{
+	bool isPlain = !name.isEmpty() && (name.at(0).isLower() || name.at(0) == '_') && !isKeyword(name);
+	for (int i = 0; isPlain && i < name.size(); i++) {
+		const QChar c = name.at(i);
+		isPlain = c.isLower() || c.isDigit() || c == '_' || c == '$';
+	}
+
+	if (isPlain) {
+		return name;
+	}
+
+	QString result = name;
+	return "\"" + result.replace("\"", "\"\"") + "\"";
+}
+
+void append(const QStringList &names, QSet<QString> *seen, QStringList *result)
+{
+	foreach(const QString & name, names) {
+		if (result->size() < maxItems && !seen->contains(name)) {
+			seen->insert(name);
+			*result << name;
+		}
+	}
+}
+
+/*
+ * The highlighter leaves a non-zero state on a block that ends inside a
+ * comment, string or dollar quote, the next block can not be split alone.
+ */
+bool isCleanStart(const QTextBlock &block)
+{
+	return !block.previous().isValid() || block.previous().userState() <= 0;
+}
+
+QString documentText(QTextDocument *document, int from, int to)
+{
+	QTextCursor cursor(document);
+	cursor.setPosition(from);
+	cursor.setPosition(to, QTextCursor::KeepAnchor);
+	return cursor.selectedText().replace(QChar::ParagraphSeparator, '\n');
+}
+
+}
+
+SqlCompleter::SqlCompleter(QPlainTextEdit *editor)
+	: QObject(editor), m_editor(editor)
+{
+	m_model = new QStringListModel(this);
+
+	m_completer = new QCompleter(m_model, this);
+	m_completer->setWidget(m_editor);
+	m_completer->setCompletionMode(QCompleter::PopupCompletion);
+	m_completer->setCaseSensitivity(Qt::CaseInsensitive);
+	m_completer->setModelSorting(QCompleter::UnsortedModel);
+	connect(m_completer, SIGNAL(activated(QString)), this, SLOT(insertCompletion(QString)));
+
+	m_editor->installEventFilter(this);
+}
+
+QString SqlCompleter::connectionName() const
+{
+	return m_connectionName;
+}
+
+void SqlCompleter::setConnectionName(const QString &connectionName)
+{
+	m_connectionName = connectionName;
+	m_completer->popup()->hide();
+}
+
+bool SqlCompleter::eventFilter(QObject *object, QEvent *event)
+{
+	if (object != m_editor || event->type() != QEvent::KeyPress) {
+		return QObject::eventFilter(object, event);
+	}
+
+	QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
+	const bool isPopupVisible = m_completer->popup()->isVisible();
+
+	// The popup gets these itself
+	if (isPopupVisible) {
+		switch (keyEvent->key()) {
+			case Qt::Key_Enter:
+			case Qt::Key_Return:
+			case Qt::Key_Escape:
+			case Qt::Key_Tab:
+			case Qt::Key_Backtab:
+				event->ignore();
+				return true;
+			default:
+				break;
+		}
+	}
+
+	if (keyEvent->key() == Qt::Key_Space && (keyEvent->modifiers() & Qt::ControlModifier)) {
+		complete();
+		return true;
+	}
+
+	// Both after the editor has taken the key
+	if (keyEvent->text() == ".") {
+		QTimer::singleShot(0, this, SLOT(complete()));
+	} else if (isPopupVisible) {
+		QTimer::singleShot(0, this, SLOT(updatePopup()));
+	}
+
+	return QObject::eventFilter(object, event);
+}
+
+void SqlCompleter::complete()
+{
+	if (m_connectionName.isEmpty()) {
+		return;
+	}
+
+	CompletionIndex::instance()->prepare(m_connectionName);
+
+	const QString &currentPrefix = prefix();
+	const QStringList &names = candidates(currentPrefix);
+	if (names.isEmpty()) {
+		m_completer->popup()->hide();
+		return;
+	}
+
+	m_model->setStringList(names);
+	m_completer->setCompletionPrefix(currentPrefix);
+	m_completer->popup()->setCurrentIndex(m_completer->completionModel()->index(0, 0));
+
+	QRect rect = m_editor->cursorRect();
+	rect.setWidth(m_completer->popup()->sizeHintForColumn(0)
+				  + m_completer->popup()->verticalScrollBar()->sizeHint().width());
+	m_completer->complete(rect);
+}
+
+void SqlCompleter::updatePopup()
+{
+	// Closed once the word is deleted or finished
+	if (prefix().isEmpty()) {
+		m_completer->popup()->hide();
+	} else {
+		complete();
+	}
+}
+
+void SqlCompleter::insertCompletion(const QString &completion)
+{
+	QTextCursor cursor = m_editor->textCursor();
+	cursor.movePosition(QTextCursor::Left, QTextCursor::KeepAnchor, prefix().size());
+	cursor.insertText(quoted(completion));
+	m_editor->setTextCursor(cursor);
+}
+
+QString SqlCompleter::prefix() const
+{
+	const QTextCursor &cursor = m_editor->textCursor();
+	const QString &text = cursor.block().text().left(cursor.positionInBlock());
+
+	int start = text.size();
+	while (start > 0 && isIdentifierChar(text.at(start - 1))) {
+		--start;
+	}
+
+	return text.mid(start);
+}
+
+QStringList SqlCompleter::candidates(const QString &prefix) const
+{
+	const int position = m_editor->textCursor().position() - prefix.size();
+
+	int begin;
+	int end;
+	statementBounds(position, &begin, &end);
+
+	const QVector<Token> &statement = tokenize(documentText(m_editor->document(), begin, end));
+	QHash<QString, Relation> aliases;
+	scan(statement, &aliases);
+
+	// Context: the tokens before the word under the cursor, less a qualifier
+	QVector<Token> tokens = statement;
+	while (!tokens.isEmpty() && tokens.last().offset >= position - begin) {
+		tokens.pop_back();
+	}
+
+	QStringList qualifier;
+	while (tokens.size() >= 2 && tokens.last().type == Token::Dot && tokens.at(tokens.size() - 2).type == Token::Name
+			&& qualifier.size() < 2) {
+		qualifier.prepend(tokens.at(tokens.size() - 2).text);
+		tokens.resize(tokens.size() - 2);
+	}
+
+	QHash<QString, Relation> preceding;
+	const bool isRelationExpected = scan(tokens, &preceding);
+
+	CompletionIndex *index = CompletionIndex::instance();
+	QStringList result;
+	QSet<QString> seen;
+
+	if (qualifier.size() == 2) {
+		append(index->columns(m_connectionName, qualifier.first(), qualifier.last(), prefix, maxItems), &seen, &result);
+	} else if (!qualifier.isEmpty()) {
+		const QString &name = qualifier.first();
+
+		if (!isRelationExpected) {
+			if (aliases.contains(name)) {
+				const Relation &relation = aliases.value(name);
+				append(index->columns(m_connectionName, relation.first, relation.second, prefix, maxItems), &seen, &result);
+			} else if (index->hasRelation(m_connectionName, QString(), name)) {
+				append(index->columns(m_connectionName, QString(), name, prefix, maxItems), &seen, &result);
+			}
+		}
+
+		if (index->hasScheme(m_connectionName, name)) {
+			append(index->relations(m_connectionName, name, prefix, maxItems), &seen, &result);
+			if (!isRelationExpected) {
+				append(index->functions(m_connectionName, name, prefix, maxItems), &seen, &result);
+			}
+		}
+	} else if (isRelationExpected) {
+		append(index->relations(m_connectionName, QString(), prefix, maxItems), &seen, &result);
+		append(index->schemes(m_connectionName, prefix, maxItems), &seen, &result);
+	} else {
+		QSet<Relation> relations;
+		foreach(const Relation & relation, aliases) {
+			if (!relations.contains(relation)) {
+				relations.insert(relation);
+				append(index->columns(m_connectionName, relation.first, relation.second, prefix, maxItems), &seen, &result);
+			}
+		}
+
+		// Everything else only once something is typed
+		if (!prefix.isEmpty() || result.isEmpty()) {
+			append(index->functions(m_connectionName, QString(), prefix, maxItems), &seen, &result);
+			append(index->relations(m_connectionName, QString(), prefix, maxItems), &seen, &result);
+			append(index->schemes(m_connectionName, prefix, maxItems), &seen, &result);
+		}
+	}
+
+	return result;
+}
+
+/*
+ * The statement around position, found from the blocks next to it rather
+ * than by splitting the whole document on each key press. Runs of blocks
+ * that start outside of any comment or string are split one at a time.
+ */
+void SqlCompleter::statementBounds(int position, int *begin, int *end) const
+{
+	QTextDocument *document = m_editor->document();
+	const QTextBlock &current = document->findBlock(position);
+
+	// Back to the last top-level semicolon before position
+	*begin = 0;
+	int limit = position;
+	for (QTextBlock block = current; block.isValid(); block = block.previous()) {
+		while (!isCleanStart(block)) {
+			block = block.previous();
+		}
+
+		const QList<qint64> &separators = SqlSplitter::separators(documentText(document, block.position(), limit));
+		if (!separators.isEmpty()) {
+			*begin = block.position() + separators.last() + 1;
+			break;
+		}
+		limit = block.position();
+	}
+
+	// On to the first one after it, begin is outside of any string
+	*end = document->characterCount() - 1;
+	int from = *begin;
+	for (QTextBlock block = current.next(); ; block = block.next()) {
+		while (block.isValid() && !isCleanStart(block)) {
+			block = block.next();
+		}
+
+		const int to = block.isValid() ? block.position() : *end;
+		const QList<qint64> &separators = SqlSplitter::separators(documentText(document, from, to));
+		if (!separators.isEmpty()) {
+			*end = from + separators.first() + 1;
+			break;
+		}
+
+		if (!block.isValid()) {
+			break;
+		}
+		from = to;
+	}
+}
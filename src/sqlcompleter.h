@@ -0,0 +1,77 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#ifndef SQLCOMPLETER_H
+#define SQLCOMPLETER_H
+
+#include <QtCore/QObject>
+#include <QtCore/QStringList>
+
+class QCompleter;
+class QPlainTextEdit;
+class QStringListModel;
+
+/*!
+ * Completion popup for an SQL editor, filled from CompletionIndex.
+ * Shown on Ctrl+Space and after a '.'; the statement under the cursor
+ * decides what is offered: relations after FROM, JOIN, UPDATE and INTO,
+ * columns after an alias or relation name and a dot, columns of the
+ * relations of the statement first anywhere else.
+ */
+class SqlCompleter : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit SqlCompleter(QPlainTextEdit *editor);
+
+	QString connectionName() const;
+
+public Q_SLOTS:
+	void setConnectionName(const QString &connectionName);
+	void complete();
+
+protected:
+	bool eventFilter(QObject *object, QEvent *event);
+
+private Q_SLOTS:
+	void updatePopup();
+	void insertCompletion(const QString &completion);
+
+private:
+	Q_DISABLE_COPY(SqlCompleter)
+
+	QString prefix() const;
+	QStringList candidates(const QString &prefix) const;
+	void statementBounds(int position, int *begin, int *end) const;
+
+private:
+	QPlainTextEdit *m_editor;
+	QCompleter *m_completer;
+	QStringListModel *m_model;
+	QString m_connectionName;
+};
+
+#endif //SQLCOMPLETER_H
@@ -24,48 +24,269 @@
 
 #include <QtGui/QTextDocument>
 
+#include <algorithm>
+#include <cstring>
+
 #include "sqlhighlighter.h"
 
+namespace
+{
+
+/*
+ * Block state: the kind of construct left open at the end of the block in
+ * the high byte and its payload (comment depth, dollar tag index) below.
+ */
+enum State {
+	NormalState = 0,
+	CommentState = 1 << 24,
+	StringState = 2 << 24,
+	EscapeStringState = 3 << 24,
+	IdentifierState = 4 << 24,
+	DollarState = 5 << 24
+};
+
+static const int stateMask = 0xFF << 24;
+static const int maxWordLength = 32;
+
+// Sorted, lower case; looked up with a binary search
+static const char *const keywords[] = {
+	"add", "all", "alter", "analyze", "and", "any", "array", "as", "asc",
+	"begin", "between", "by", "cascade", "case", "cast", "check", "column",
+	"commit", "constraint", "cost", "create", "cross", "declare", "default",
+	"delete", "desc", "distinct", "drop", "else", "end", "except", "exists",
+	"explain", "false", "for", "foreign", "from", "full", "function", "grant",
+	"group", "having", "if", "ilike", "in", "index", "inner", "insert",
+	"intersect", "into", "is", "isnull", "join", "key", "language", "left",
+	"like", "limit", "not", "notnull", "null", "offset", "on", "or", "order",
+	"outer", "primary", "references", "replace", "return", "returning",
+	"returns", "revoke", "right", "rollback", "schema", "select", "sequence",
+	"set", "table", "then", "trigger", "true", "truncate", "union", "unique",
+	"update", "using", "vacuum", "values", "view", "volatile", "when", "where",
+	"with"
+};
+
+static const char *const functions[] = {
+	"avg", "coalesce", "count", "greatest", "least", "max", "min", "nullif",
+	"sum"
+};
+
+struct WordLess {
+	bool operator()(const char *left, const char *right) const {
+		return std::strcmp(left, right) < 0;
+	}
+};
+
+template <int N>
+bool contains(const char *const(&table)[N], const char *word)
+{
+	const char *const *it = std::lower_bound(table, table + N, word, WordLess());
+	return it != table + N && std::strcmp(*it, word) == 0;
+}
+
+inline bool isIdentifierStart(QChar c)
+{
+	return c.isLetter() || c == '_';
+}
+
+inline bool isIdentifierChar(QChar c)
+{
+	return c.isLetterOrNumber() || c == '_' || c == '$';
+}
+
+}
+
 //! [0]
 SQLHighlighter::SQLHighlighter(QTextDocument *parent)
 	: QSyntaxHighlighter(parent)
 {
+	m_defaultFormat.setForeground(Qt::gray);
+	m_keywordFormat.setForeground(Qt::magenta);
+	m_functionFormat.setForeground(Qt::darkGreen);
+	m_numberFormat.setForeground(Qt::blue);
+	m_stringFormat.setForeground(Qt::red);
+	m_commentFormat.setForeground(Qt::blue);
+}
 
+int SQLHighlighter::skipComment(const QChar *data, int length, int pos, int *depth) const
+{
+	while (pos < length && *depth > 0) {
+		if (data [pos] == '*' && pos + 1 < length && data [pos + 1] == '/') {
+			--*depth;
+			pos += 2;
+		} else if (data [pos] == '/' && pos + 1 < length && data [pos + 1] == '*') {
+			++*depth;
+			pos += 2;
+		} else {
+			++pos;
+		}
+	}
+
+	return pos;
 }
 
-void SQLHighlighter::setFormatByRegExp(const QRegExp &re, const QString &text, const QColor &color)
+int SQLHighlighter::skipQuoted(const QChar *data, int length, int pos, QChar quote, bool isEscape) const
 {
-	for (int i = re.indexIn(text, 0); i != -1; i = re.indexIn(text, i + re.matchedLength())) {
-		setFormat(i, re.matchedLength(), color);
+	while (pos < length) {
+		if (isEscape && data [pos] == '\\') {
+			pos += 2;
+		} else if (data [pos] == quote) {
+			if (pos + 1 < length && data [pos + 1] == quote) {
+				pos += 2;
+			} else {
+				return pos + 1;
+			}
+		} else {
+			++pos;
+		}
 	}
+
+	return -1;
+}
+
+int SQLHighlighter::skipDollarQuoted(const QChar *data, int length, int pos, const QString &tag) const
+{
+	const int index = QString::fromRawData(data + pos, length - pos).indexOf(tag);
+	return index == -1 ? -1 : pos + index + tag.length();
+}
+
+int SQLHighlighter::dollarTag(const QString &tag)
+{
+	int index = m_dollarTags.indexOf(tag);
+	if (index == -1) {
+		index = m_dollarTags.size();
+		m_dollarTags << tag;
+	}
+	return index;
 }
 
 void SQLHighlighter::highlightBlock(const QString &text)
 {
-	setFormat(0, text.length(), Qt::gray);
+	const QChar *data = text.constData();
+	const int length = text.length();
 
-	const QRegExp commandsRegexp("\\b(?:select|from|where|and|case|when|then|else|distinct|all|null|"
-								 "is|like|between|not|group|by|having|order|inner|outer|right|left|alter|with|isnull|cast|create|replace|function|"
-								 "returns|language|volatile|cost|table|view|or|"
-								 "asc|desc|"
-								 "join|on|using|union|exists|in|as|intersect|except|coalesce|insert|into|update)\\b",
-								 Qt::CaseInsensitive);
+	setFormat(0, length, m_defaultFormat);
 
-	setFormatByRegExp(commandsRegexp, text, Qt::magenta);
+	int state = qMax(previousBlockState(), 0);
+	int pos = 0;
 
-	const QRegExp aggregationsRegexp("\\b(?:count|min|max)\\b\\s*\\([^\\)]+\\)",
-									 Qt::CaseInsensitive);
-	setFormatByRegExp(aggregationsRegexp, text, Qt::darkGreen);
+	// Finish the construct left open by the previous block
+	if (state != NormalState) {
+		const int kind = state & stateMask;
+		int end;
 
-	const QRegExp numbersRegexp("[^\\w]((\\d+)(\\.)?)",
-								Qt::CaseInsensitive);
-	setFormatByRegExp(numbersRegexp, text, Qt::blue);
+		if (kind == CommentState) {
+			int depth = state & ~stateMask;
+			end = skipComment(data, length, 0, &depth);
+			state = depth > 0 ? CommentState | depth : NormalState;
+		} else if (kind == DollarState) {
+			end = skipDollarQuoted(data, length, 0, m_dollarTags.value(state & ~stateMask));
+		} else {
+			end = skipQuoted(data, length, 0, kind == IdentifierState ? '"' : '\'', kind == EscapeStringState);
+		}
 
-	const QRegExp stringsRegexp("'[^']+'",
-								Qt::CaseInsensitive);
-	setFormatByRegExp(stringsRegexp, text, Qt::red);
+		if (kind != CommentState && end != -1) {
+			state = NormalState;
+		}
 
-	const QRegExp commentRegexp("^\\s*(--)");
-	setFormatByRegExp(commentRegexp, text, Qt::blue);
-}
+		pos = end == -1 ? length : end;
+		if (kind != IdentifierState) {
+			setFormat(0, pos, kind == CommentState ? m_commentFormat : m_stringFormat);
+		}
+	}
+
+	while (pos < length && state == NormalState) {
+		const QChar c = data [pos];
+		const QChar next = pos + 1 < length ? data [pos + 1] : QChar();
+		const int start = pos;
+
+		if (c == '-' && next == '-') {
+			setFormat(pos, length - pos, m_commentFormat);
+			pos = length;
+		} else if (c == '/' && next == '*') {
+			int depth = 1;
+			pos = skipComment(data, length, pos + 2, &depth);
+			if (depth > 0) {
+				state = CommentState | depth;
+			}
+			setFormat(start, pos - start, m_commentFormat);
+		} else if (c == '\'' || c == '"') {
+			const bool isEscape = c == '\'' && start > 0 && (data [start - 1] == 'e' || data [start - 1] == 'E')
+								  && (start == 1 || !isIdentifierChar(data [start - 2]));
+			const int end = skipQuoted(data, length, pos + 1, c, isEscape);
+			if (end == -1) {
+				state = c == '"' ? IdentifierState : isEscape ? EscapeStringState : StringState;
+			}
+			pos = end == -1 ? length : end;
+			if (c == '\'') {
+				setFormat(isEscape ? start - 1 : start, pos - start + (isEscape ? 1 : 0), m_stringFormat);
+			}
+		} else if (c == '$' && !next.isDigit()) {
+			int end = pos + 1;
+			while (end < length && (isIdentifierStart(data [end]) || (end > pos + 1 && data [end].isDigit()))) {
+				++end;
+			}
+
+			if (end < length && data [end] == '$') {
+				const QString tag(data + pos, end - pos + 1);
+				const int close = skipDollarQuoted(data, length, end + 1, tag);
+				if (close == -1) {
+					state = DollarState | dollarTag(tag);
+				}
+				pos = close == -1 ? length : close;
+				setFormat(start, pos - start, m_stringFormat);
+			} else {
+				++pos;
+			}
+		} else if (c.isDigit() || (c == '.' && next.isDigit())) {
+			while (pos < length && (data [pos].isDigit() || data [pos] == '.')) {
+				++pos;
+			}
+			if (pos < length && (data [pos] == 'e' || data [pos] == 'E')) {
+				int exponent = pos + 1;
+				if (exponent < length && (data [exponent] == '+' || data [exponent] == '-')) {
+					++exponent;
+				}
+				if (exponent < length && data [exponent].isDigit()) {
+					pos = exponent;
+					while (pos < length && data [pos].isDigit()) {
+						++pos;
+					}
+				}
+			}
+			setFormat(start, pos - start, m_numberFormat);
+		} else if (isIdentifierStart(c)) {
+			char word [maxWordLength + 1];
+			bool isAscii = true;
+
+			while (pos < length && isIdentifierChar(data [pos])) {
+				const ushort unicode = data [pos].unicode();
+				if (pos - start < maxWordLength && unicode < 0x80) {
+					word [pos - start] = unicode >= 'A' && unicode <= 'Z' ? unicode + ('a' - 'A') : unicode;
+				} else {
+					isAscii = false;
+				}
+				++pos;
+			}
+			word [qMin(pos - start, maxWordLength)] = 0;
 
+			if (!isAscii) {
+				continue;
+			}
+
+			int after = pos;
+			while (after < length && data [after].isSpace()) {
+				++after;
+			}
+
+			if (after < length && data [after] == '(' && contains(functions, word)) {
+				setFormat(start, pos - start, m_functionFormat);
+			} else if (contains(keywords, word)) {
+				setFormat(start, pos - start, m_keywordFormat);
+			}
+		} else {
+			++pos;
+		}
+	}
+
+	setCurrentBlockState(state);
+}
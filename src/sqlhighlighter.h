@@ -25,12 +25,19 @@
 #ifndef SQLHIGHLIGHTER_H
 #define SQLHIGHLIGHTER_H
 
+#include <QtCore/QStringList>
+
 #include <QtGui/QSyntaxHighlighter>
 
 #include <QTextCharFormat>
 
 class QTextDocument;
 
+/*!
+ * Single-pass SQL lexer. Unterminated comments, strings and dollar quotes
+ * are carried to the next block through the block state, so an edit only
+ * rehighlights blocks whose incoming state changes.
+ */
 class SQLHighlighter : public QSyntaxHighlighter
 {
 	Q_OBJECT
@@ -44,7 +51,20 @@ protected:
 private:
 	Q_DISABLE_COPY(SQLHighlighter)
 
-	void setFormatByRegExp(const QRegExp &re, const QString &text, const QColor& color);
+	int skipComment(const QChar *data, int length, int pos, int *depth) const;
+	int skipQuoted(const QChar *data, int length, int pos, QChar quote, bool isEscape) const;
+	int skipDollarQuoted(const QChar *data, int length, int pos, const QString &tag) const;
+	int dollarTag(const QString &tag);
+
+private:
+	QTextCharFormat m_defaultFormat;
+	QTextCharFormat m_keywordFormat;
+	QTextCharFormat m_functionFormat;
+	QTextCharFormat m_numberFormat;
+	QTextCharFormat m_stringFormat;
+	QTextCharFormat m_commentFormat;
+
+	QStringList m_dollarTags;
 };
 
 #endif
@@ -0,0 +1,299 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#include <QtCore/QStringList>
+
+#include "sqlsplitter.h"
+
+static inline ushort code(QChar c)
+{
+	return c.unicode();
+}
+
+static inline ushort code(char c)
+{
+	return uchar(c);
+}
+
+static inline bool isSpace(ushort c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static inline bool isIdentifierStart(ushort c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c >= 0x80;
+}
+
+static inline bool isIdentifier(ushort c)
+{
+	return isIdentifierStart(c) || (c >= '0' && c <= '9') || c == '$';
+}
+
+template <typename Char>
+static qint64 skipLineComment(const Char *data, qint64 size, qint64 pos)
+{
+	while (pos < size && code(data [pos]) != '\n') {
+		++pos;
+	}
+	return pos;
+}
+
+template <typename Char>
+static qint64 skipBlockComment(const Char *data, qint64 size, qint64 pos, int *line)
+{
+	int depth = 1;
+	pos += 2;
+
+	while (pos < size && depth > 0) {
+		const ushort c = code(data [pos]);
+		const ushort n = pos + 1 < size ? code(data [pos + 1]) : 0;
+
+		if (c == '/' && n == '*') {
+			++depth;
+			pos += 2;
+		} else if (c == '*' && n == '/') {
+			--depth;
+			pos += 2;
+		} else {
+			if (c == '\n') {
+				++*line;
+			}
+			++pos;
+		}
+	}
+
+	return pos;
+}
+
+template <typename Char>
+static qint64 skipQuoted(const Char *data, qint64 size, qint64 pos, ushort quote, bool backslashEscapes, int *line)
+{
+	++pos;
+
+	while (pos < size) {
+		const ushort c = code(data [pos]);
+
+		if (c == '\n') {
+			++*line;
+		}
+
+		if (backslashEscapes && c == '\\') {
+			pos += 2;
+			continue;
+		}
+
+		++pos;
+
+		if (c == quote) {
+			if (pos < size && code(data [pos]) == quote) {
+				++pos;
+				continue;
+			}
+			break;
+		}
+	}
+
+	return pos;
+}
+
+template <typename Char>
+static qint64 dollarTagLength(const Char *data, qint64 size, qint64 pos)
+{
+	qint64 end = pos + 1;
+
+	if (end < size && isIdentifierStart(code(data [end]))) {
+		while (end < size && isIdentifier(code(data [end])) && code(data [end]) != '$') {
+			++end;
+		}
+	}
+
+	if (end < size && code(data [end]) == '$') {
+		return end - pos + 1;
+	}
+
+	return 0;
+}
+
+template <typename Char>
+static qint64 skipDollarQuoted(const Char *data, qint64 size, qint64 pos, qint64 tagLength, int *line)
+{
+	const Char *tag = data + pos;
+	pos += tagLength;
+
+	while (pos < size) {
+		const ushort c = code(data [pos]);
+
+		if (c == '$' && pos + tagLength <= size) {
+			qint64 i = 1;
+			while (i < tagLength && code(data [pos + i]) == code(tag [i])) {
+				++i;
+			}
+			if (i == tagLength) {
+				return pos + tagLength;
+			}
+		}
+
+		if (c == '\n') {
+			++*line;
+		}
+		++pos;
+	}
+
+	return pos;
+}
+
+// Index of the semicolon ending the statement at i, size if there is none;
+// *end is moved past the last significant character
+template <typename Char>
+static qint64 skipStatement(const Char *data, qint64 size, qint64 i, int *line, qint64 *end)
+{
+	while (i < size) {
+		const ushort c = code(data [i]);
+		const ushort n = i + 1 < size ? code(data [i + 1]) : 0;
+		const ushort p = i > 0 ? code(data [i - 1]) : 0;
+
+		if (c == ';') {
+			break;
+		} else if (c == '\n') {
+			++*line;
+			++i;
+		} else if (c == '-' && n == '-') {
+			i = skipLineComment(data, size, i);
+			continue;
+		} else if (c == '/' && n == '*') {
+			i = skipBlockComment(data, size, i, line);
+		} else if (c == '\'') {
+			const ushort pp = i > 1 ? code(data [i - 2]) : 0;
+			i = skipQuoted(data, size, i, c, (p == 'E' || p == 'e') && !isIdentifier(pp), line);
+		} else if (c == '"') {
+			i = skipQuoted(data, size, i, c, false, line);
+		} else if (c == '$' && !isIdentifier(p)) {
+			const qint64 tagLength = dollarTagLength(data, size, i);
+			i = tagLength > 0 ? skipDollarQuoted(data, size, i, tagLength, line) : i + 1;
+		} else {
+			++i;
+		}
+
+		if (!isSpace(c)) {
+			*end = i;
+		}
+	}
+
+	return i;
+}
+
+template <typename Char>
+static bool nextStatement(const Char *data, qint64 size, qint64 *pos, int *line, SqlStatement *statement)
+{
+	qint64 i = *pos;
+
+	while (i < size) {
+		const ushort c = code(data [i]);
+		const ushort n = i + 1 < size ? code(data [i + 1]) : 0;
+
+		if (c == '\n') {
+			++*line;
+			++i;
+		} else if (isSpace(c) || c == ';') {
+			++i;
+		} else if (c == '-' && n == '-') {
+			i = skipLineComment(data, size, i);
+		} else if (c == '/' && n == '*') {
+			i = skipBlockComment(data, size, i, line);
+		} else {
+			break;
+		}
+	}
+
+	if (i >= size) {
+		*pos = size;
+		return false;
+	}
+
+	statement->offset = i;
+	statement->line = *line;
+
+	qint64 end = i;
+	i = skipStatement(data, size, i, line, &end);
+
+	statement->length = end - statement->offset;
+	*pos = i < size ? i + 1 : size;
+	return true;
+}
+
+QList<SqlStatement> SqlSplitter::split(const QString &text)
+{
+	QList<SqlStatement> result;
+
+	qint64 pos = 0;
+	int line = 1;
+	SqlStatement statement;
+	while (nextStatement(text.constData(), text.size(), &pos, &line, &statement)) {
+		result << statement;
+	}
+
+	return result;
+}
+
+QStringList SqlSplitter::statements(const QString &text)
+{
+	QStringList result;
+
+	foreach(const SqlStatement & statement, split(text)) {
+		result << text.mid(statement.offset, statement.length);
+	}
+
+	return result;
+}
+
+QList<qint64> SqlSplitter::separators(const QString &text)
+{
+	QList<qint64> result;
+
+	const qint64 size = text.size();
+	int line = 1;
+	qint64 end = 0;
+	for (qint64 i = skipStatement(text.constData(), size, 0, &line, &end); i < size;
+			i = skipStatement(text.constData(), size, i + 1, &line, &end)) {
+		result << i;
+	}
+
+	return result;
+}
+
+bool SqlSplitter::next(const QChar *data, qint64 size, qint64 *pos, int *line, SqlStatement *statement)
+{
+	return nextStatement(data, size, pos, line, statement);
+}
+
+/*!
+ * Splits UTF-8 (or any ASCII compatible) bytes, offsets are in bytes.
+ * Used on memory mapped files that are never decoded as a whole.
+ */
+bool SqlSplitter::next(const char *data, qint64 size, qint64 *pos, int *line, SqlStatement *statement)
+{
+	return nextStatement(data, size, pos, line, statement);
+}
@@ -0,0 +1,55 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#ifndef SQLSPLITTER_H
+#define SQLSPLITTER_H
+
+class QStringList;
+
+#include <QtCore/QList>
+#include <QtCore/QString>
+
+struct SqlStatement {
+	qint64 offset;
+	qint64 length;
+	int line;
+};
+
+/*!
+ * Splits SQL text into statements on top-level semicolons.
+ * Semicolons inside quoted strings and identifiers, dollar-quoted bodies,
+ * -- line comments and nested block comments are skipped.
+ */
+class SqlSplitter
+{
+public:
+	static QList<SqlStatement> split(const QString &text);
+	static QStringList statements(const QString &text);
+	static QList<qint64> separators(const QString &text);
+	static bool next(const QChar *data, qint64 size, qint64 *pos, int *line, SqlStatement *statement);
+	static bool next(const char *data, qint64 size, qint64 *pos, int *line, SqlStatement *statement);
+};
+
+#endif //SQLSPLITTER_H
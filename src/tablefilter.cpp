@@ -0,0 +1,75 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#include <QtCore/QStringList>
+
+#include "tablefilter.h"
+
+bool TableFilter::isEmpty() const
+{
+	return m_predicates.isEmpty();
+}
+
+void TableFilter::clear()
+{
+	m_predicates.clear();
+}
+
+QList<FilterPredicate> TableFilter::predicates() const
+{
+	return m_predicates;
+}
+
+void TableFilter::add(const QString &column, FilterPredicate::Operator op, const QVariant &value)
+{
+	FilterPredicate predicate;
+	predicate.column = column;
+	predicate.op = op;
+	predicate.value = value;
+	m_predicates << predicate;
+}
+
+QString TableFilter::whereClause(QVariantList *bindValues) const
+{
+	static const char *const operators[] = {" = ?", " IS DISTINCT FROM ?", " < ?", " <= ?", " > ?", " >= ?"};
+
+	QStringList conditions;
+
+	foreach(const FilterPredicate &predicate, m_predicates) {
+		QString column = predicate.column;
+		column = "\"" + column.replace('"', "\"\"") + "\"";
+
+		if (predicate.value.isNull() && predicate.op == FilterPredicate::Equal) {
+			conditions << column + " IS NULL";
+		} else if (predicate.value.isNull() && predicate.op == FilterPredicate::NotEqual) {
+			conditions << column + " IS NOT NULL";
+		} else {
+			conditions << column + operators [predicate.op];
+			*bindValues << predicate.value;
+		}
+	}
+
+	return conditions.join(" AND ");
+}
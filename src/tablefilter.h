@@ -0,0 +1,68 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#ifndef TABLEFILTER_H
+#define TABLEFILTER_H
+
+#include <QtCore/QList>
+#include <QtCore/QString>
+#include <QtCore/QVariant>
+
+struct FilterPredicate {
+	enum Operator {
+		Equal,
+		NotEqual,
+		Less,
+		LessOrEqual,
+		Greater,
+		GreaterOrEqual
+	};
+
+	QString column;
+	Operator op;
+	QVariant value;
+};
+
+/*!
+ * Row filter of a table as a list of predicates joined by AND.
+ * Values are never written into the query text, they become bind values,
+ * so filters of the same shape produce the same query and share its plan.
+ */
+class TableFilter
+{
+public:
+	bool isEmpty() const;
+	void clear();
+
+	QList<FilterPredicate> predicates() const;
+	void add(const QString &column, FilterPredicate::Operator op, const QVariant &value);
+
+	QString whereClause(QVariantList *bindValues) const;
+
+private:
+	QList<FilterPredicate> m_predicates;
+};
+
+#endif //TABLEFILTER_H
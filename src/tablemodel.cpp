@@ -0,0 +1,922 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#include <QtCore/QMap>
+#include <QtCore/QMetaObject>
+
+#include <climits>
+
+#include "tablemodel.h"
+#include "connectionpool.h"
+
+// Rows per multi-row statement; the bind values of one statement are
+// also kept well below the protocol limit of 65535 parameters.
+static const int MaxBatchRows = 1000;
+static const int MaxBindValues = 30000;
+
+// Virtual mode keeps at most MaxPages pages of PageSize rows. Rows up to
+// MaxGapPages pages away from the window are reached by paging from its
+// ends, farther rows by a jump to a histogram bound of the primary key.
+static const int PageSize = 500;
+static const int MaxPages = 20;
+static const int MaxGapPages = 4;
+
+TableModel::TableModel(const QString &connectionName, const QString &tableName, QObject *parent)
+	: QAbstractTableModel(parent)
+	, m_tableName(tableName)
+	, m_primaryKeyJobId(0)
+	, m_selectJobId(0)
+	, m_isSelectRequested(false)
+	, m_submitJobId(0)
+	, m_submitStatements(0)
+	, m_virtualThreshold(0)
+	, m_isVirtual(false)
+	, m_estimatedRows(-1)
+	, m_virtualRows(0)
+	, m_windowStart(0)
+	, m_boundsJobId(0)
+	, m_pageJobId(0)
+	, m_pageLoad(FirstPage)
+	, m_pageRow(0)
+	, m_wantedRow(-1)
+	, m_isPageScheduled(false)
+{
+	m_executor = ConnectionPool::pool(connectionName)->checkOut();
+	connect(m_executor, SIGNAL(jobFinished(int, QueryResult)), this, SLOT(jobFinished(int, QueryResult)));
+
+	// Key columns come with their position in the index, the keyset order
+	// must follow it for the index to serve the pages
+	QueryJob job("SELECT a.attname, format_type(a.atttypid, a.atttypmod), "
+				 "(SELECT k FROM generate_subscripts(i.indkey::int2[], 1) k WHERE (i.indkey::int2[]) [k] = a.attnum), "
+				 "c.reltuples::bigint FROM pg_attribute a "
+				 "JOIN pg_class c ON c.oid = a.attrelid "
+				 "LEFT JOIN pg_index i ON i.indrelid = a.attrelid AND i.indisprimary "
+				 "WHERE a.attrelid = ?::regclass AND a.attnum > 0 AND NOT a.attisdropped ORDER BY a.attnum");
+	job.bindValues << escapeIdentifier(tableName);
+	job.priority = QueryJob::HighPriority;
+	m_primaryKeyJobId = m_executor->submit(job);
+}
+
+TableModel::~TableModel()
+{
+	ConnectionPool::release(m_executor);
+}
+
+QString TableModel::tableName() const
+{
+	return m_tableName;
+}
+
+TableFilter TableModel::filter() const
+{
+	return m_filter;
+}
+
+void TableModel::setFilter(const TableFilter &filter)
+{
+	m_filter = filter;
+}
+
+QString TableModel::columnName(int column) const
+{
+	return m_columns.value(column).name;
+}
+
+ResultColumn::Type TableModel::columnType(int column) const
+{
+	return m_columns.value(column).type;
+}
+
+bool TableModel::isDirty() const
+{
+	return !m_changes.isEmpty() || !m_removed.isEmpty() || !m_inserted.isEmpty();
+}
+
+int TableModel::virtualThreshold() const
+{
+	return m_virtualThreshold;
+}
+
+void TableModel::setVirtualThreshold(int rows)
+{
+	m_virtualThreshold = rows;
+}
+
+bool TableModel::isVirtual() const
+{
+	return m_isVirtual;
+}
+
+qint64 TableModel::estimatedRows() const
+{
+	return m_estimatedRows;
+}
+
+QString TableModel::escapeIdentifier(const QString &identifier)
+{
+	QStringList parts = identifier.split('.');
+
+	for (int i = 0, count = parts.size(); i < count; i++) {
+		QString part = parts.at(i);
+		if (!part.startsWith('"')) {
+			part = "\"" + part.replace('"', "\"\"") + "\"";
+		}
+		parts [i] = part;
+	}
+
+	return parts.join(".");
+}
+
+QString TableModel::escapeColumnName(const QString &name)
+{
+	// One identifier, dots and quotes are part of the name
+	return "\"" + QString(name).replace('"', "\"\"") + "\"";
+}
+
+int TableModel::rowCount(const QModelIndex &parent) const
+{
+	if (parent.isValid()) {
+		return 0;
+	}
+
+	return m_isVirtual ? m_virtualRows : m_store.rowCount() + m_inserted.size();
+}
+
+int TableModel::columnCount(const QModelIndex &parent) const
+{
+	return parent.isValid() ? 0 : m_columns.size();
+}
+
+QVariant TableModel::data(const QModelIndex &index, int role) const
+{
+	if (!index.isValid() || (role != Qt::DisplayRole && role != Qt::EditRole)) {
+		return QVariant();
+	}
+
+	const int row = index.row();
+	if (m_isVirtual) {
+		int offset;
+		const ResultChunk *page = pageOf(row, &offset);
+		if (!page) {
+			requestRow(row);
+			return QVariant();
+		}
+		return page->isNull(offset, index.column()) ? QVariant() : page->value(offset, index.column());
+	}
+
+	if (row >= m_store.rowCount()) {
+		return m_inserted.at(row - m_store.rowCount()).value(index.column());
+	}
+
+	const QHash<int, QHash<int, QVariant> >::const_iterator it = m_changes.constFind(row);
+	if (it != m_changes.constEnd() && it.value().contains(index.column())) {
+		return it.value().value(index.column());
+	}
+
+	return originalValue(row, index.column());
+}
+
+bool TableModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+	if (!index.isValid() || role != Qt::EditRole || m_isVirtual) {
+		return false;
+	}
+
+	const int row = index.row();
+	if (row >= m_store.rowCount()) {
+		m_inserted [row - m_store.rowCount()][index.column()] = value;
+	} else {
+		m_changes [row][index.column()] = value;
+	}
+
+	emit dataChanged(index, index);
+	emit headerDataChanged(Qt::Vertical, row, row);
+	return true;
+}
+
+Qt::ItemFlags TableModel::flags(const QModelIndex &index) const
+{
+	if (!index.isValid()) {
+		return Qt::NoItemFlags;
+	}
+
+	if (m_isVirtual) {
+		return Qt::ItemIsSelectable | Qt::ItemIsEnabled;
+	}
+
+	return Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsEditable;
+}
+
+QVariant TableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+	if (role != Qt::DisplayRole) {
+		return QVariant();
+	}
+
+	if (orientation == Qt::Horizontal) {
+		return m_columns.value(section).name;
+	}
+
+	if (m_isVirtual) {
+		return section + 1;
+	}
+
+	if (section >= m_store.rowCount()) {
+		return "*";
+	}
+
+	if (m_removed.contains(section)) {
+		return "!";
+	}
+
+	return section + 1;
+}
+
+bool TableModel::insertRows(int row, int count, const QModelIndex &parent)
+{
+	Q_UNUSED(row)
+
+	if (parent.isValid() || count <= 0 || m_isVirtual) {
+		return false;
+	}
+
+	const int first = rowCount();
+	beginInsertRows(QModelIndex(), first, first + count - 1);
+	for (int i = 0; i < count; i++) {
+		m_inserted.append(QVector<QVariant> (m_columns.size()));
+	}
+	endInsertRows();
+
+	return true;
+}
+
+bool TableModel::removeRows(int row, int count, const QModelIndex &parent)
+{
+	if (parent.isValid() || row < 0 || count <= 0 || row + count > rowCount() || m_isVirtual) {
+		return false;
+	}
+
+	for (int i = row + count - 1; i >= row; i--) {
+		if (i >= m_store.rowCount()) {
+			beginRemoveRows(QModelIndex(), i, i);
+			m_inserted.removeAt(i - m_store.rowCount());
+			endRemoveRows();
+		} else {
+			m_removed.insert(i);
+			emit headerDataChanged(Qt::Vertical, i, i);
+		}
+	}
+
+	return true;
+}
+
+void TableModel::sort(int column, Qt::SortOrder order)
+{
+	// Virtual mode pages in primary key order only
+	if (column < 0 || column >= m_columns.size() || m_isVirtual) {
+		return;
+	}
+
+	m_orderBy = escapeColumnName(columnName(column)) + (order == Qt::AscendingOrder ? " ASC" : " DESC");
+	select();
+}
+
+void TableModel::select()
+{
+	if (m_primaryKeyJobId) {
+		m_isSelectRequested = true;
+		return;
+	}
+
+	m_isVirtual = m_virtualThreshold > 0 && !m_primaryKey.isEmpty() && m_estimatedRows >= m_virtualThreshold;
+	if (m_isVirtual) {
+		QueryJob job("SELECT b FROM pg_class c "
+					 "JOIN pg_namespace n ON n.oid = c.relnamespace "
+					 "JOIN pg_stats s ON s.schemaname = n.nspname AND s.tablename = c.relname "
+					 "CROSS JOIN unnest(s.histogram_bounds::text::text[]) b "
+					 "WHERE c.oid = ?::regclass AND s.attname = ?");
+		job.bindValues << escapeIdentifier(m_tableName) << m_primaryKey.first();
+		m_boundsJobId = m_executor->submit(job);
+
+		m_pageJobId = 0;
+		m_wantedRow = -1;
+		loadPage(FirstPage);
+		return;
+	}
+
+	QString query = "SELECT * FROM " + escapeIdentifier(m_tableName);
+
+	QVariantList bindValues;
+	const QString &where = m_filter.whereClause(&bindValues);
+	if (!where.isEmpty()) {
+		query += " WHERE " + where;
+	}
+
+	if (!m_orderBy.isEmpty()) {
+		query += " ORDER BY " + m_orderBy;
+	}
+
+	QueryJob job(query);
+	job.bindValues = bindValues;
+	job.cachePrepared = true;
+	m_selectJobId = m_executor->submit(job);
+}
+
+void TableModel::revertAll()
+{
+	beginResetModel();
+	m_changes.clear();
+	m_removed.clear();
+	m_inserted.clear();
+	endResetModel();
+}
+
+void TableModel::submitAll()
+{
+	if (!isDirty() || m_submitJobId) {
+		return;
+	}
+
+	QueryJob job(QString(), QueryJob::Batch);
+	addDeletes(&job);
+	addUpdates(&job);
+	addInserts(&job);
+
+	m_submitStatements = job.statements.size();
+	m_submitTimer.start();
+	m_submitJobId = m_executor->submit(job);
+}
+
+void TableModel::addDeletes(QueryJob *job) const
+{
+	const QString tableName = escapeIdentifier(m_tableName);
+	QList<int> rows = m_removed.toList();
+	qSort(rows);
+
+	const QList<int> &keys = keyColumns();
+	if (keys.isEmpty()) {
+		foreach(int row, rows) {
+			QVariantList bindValues;
+			const QString &where = whereClause(row, &bindValues);
+			addStatement(job, "DELETE FROM " + tableName + " WHERE " + where, bindValues);
+		}
+		return;
+	}
+
+	const int size = batchSize(keys.size());
+	for (int first = 0; first < rows.size(); first += size) {
+		QStringList tuples;
+		QVariantList bindValues;
+		for (int i = first, last = qMin(first + size, rows.size()); i < last; i++) {
+			tuples << keyTuple(rows.at(i), keys, &bindValues);
+		}
+
+		addStatement(job, "DELETE FROM " + tableName + " WHERE " + columnTuple(keyNames())
+					 + " IN (" + tuples.join(", ") + ")", bindValues);
+	}
+}
+
+void TableModel::addUpdates(QueryJob *job) const
+{
+	const QString tableName = escapeIdentifier(m_tableName);
+	const QList<int> &keys = keyColumns();
+
+	// Rows changing the same columns are updated by one statement
+	// joining the table with a VALUES list of new values and keys.
+	QMap<QString, QList<int> > groups;
+	for (QHash<int, QHash<int, QVariant> >::const_iterator it = m_changes.constBegin(); it != m_changes.constEnd(); ++it) {
+		if (m_removed.contains(it.key())) {
+			continue;
+		}
+
+		QList<int> columns = it.value().keys();
+		qSort(columns);
+
+		QStringList shape;
+		foreach(int column, columns) {
+			shape << QString::number(column);
+		}
+		groups [shape.join(",")] << it.key();
+	}
+
+	for (QMap<QString, QList<int> >::const_iterator group = groups.constBegin(); group != groups.constEnd(); ++group) {
+		const QList<int> &rows = group.value();
+		QList<int> columns = m_changes.value(rows.first()).keys();
+		qSort(columns);
+
+		// Bind values in VALUES have no target column to take the type
+		// from, so every one is cast to the type of its column.
+		QStringList casts;
+		bool isTyped = !keys.isEmpty();
+		foreach(int column, columns + keys) {
+			const QString &type = m_columnTypes.value(columnName(column));
+			isTyped = isTyped && !type.isEmpty();
+			casts << "CAST(? AS " + type + ")";
+		}
+
+		if (!isTyped) {
+			QStringList assignments;
+			foreach(int column, columns) {
+				assignments << escapeColumnName(columnName(column)) + " = ?";
+			}
+
+			foreach(int row, rows) {
+				QVariantList bindValues;
+				foreach(int column, columns) {
+					bindValues << m_changes.value(row).value(column);
+				}
+
+				const QString &where = whereClause(row, &bindValues);
+				addStatement(job, "UPDATE " + tableName + " SET " + assignments.join(", ") + " WHERE " + where, bindValues);
+			}
+			continue;
+		}
+
+		QStringList assignments;
+		QStringList aliases;
+		for (int i = 0, count = columns.size(); i < count; i++) {
+			assignments << escapeColumnName(columnName(columns.at(i))) + " = v.c" + QString::number(i);
+			aliases << "c" + QString::number(i);
+		}
+
+		QStringList conditions;
+		for (int i = 0, count = keys.size(); i < count; i++) {
+			conditions << "t." + escapeColumnName(columnName(keys.at(i))) + " = v.k" + QString::number(i);
+			aliases << "k" + QString::number(i);
+		}
+
+		const QString tuple = "(" + casts.join(", ") + ")";
+		const int size = batchSize(casts.size());
+		for (int first = 0; first < rows.size(); first += size) {
+			QStringList tuples;
+			QVariantList bindValues;
+			for (int i = first, last = qMin(first + size, rows.size()); i < last; i++) {
+				const int row = rows.at(i);
+				foreach(int column, columns) {
+					bindValues << m_changes.value(row).value(column);
+				}
+				foreach(int column, keys) {
+					bindValues << originalValue(row, column);
+				}
+				tuples << tuple;
+			}
+
+			addStatement(job, "UPDATE " + tableName + " AS t SET " + assignments.join(", ")
+						 + " FROM (VALUES " + tuples.join(", ") + ") AS v (" + aliases.join(", ") + ")"
+						 + " WHERE " + conditions.join(" AND "), bindValues);
+		}
+	}
+}
+
+void TableModel::addInserts(QueryJob *job) const
+{
+	const QString tableName = escapeIdentifier(m_tableName);
+
+	// Rows are grouped by the columns they set, the others get defaults
+	QMap<QString, QList<int> > groups;
+	for (int i = 0, count = m_inserted.size(); i < count; i++) {
+		QStringList shape;
+		for (int column = 0, columns = m_inserted.at(i).size(); column < columns; column++) {
+			if (m_inserted.at(i).at(column).isValid()) {
+				shape << QString::number(column);
+			}
+		}
+		groups [shape.join(",")] << i;
+	}
+
+	for (QMap<QString, QList<int> >::const_iterator group = groups.constBegin(); group != groups.constEnd(); ++group) {
+		const QList<int> &rows = group.value();
+		if (group.key().isEmpty()) {
+			foreach(int row, rows) {
+				Q_UNUSED(row)
+				addStatement(job, "INSERT INTO " + tableName + " DEFAULT VALUES", QVariantList());
+			}
+			continue;
+		}
+
+		QList<int> columns;
+		QStringList names;
+		QStringList placeholders;
+		foreach(const QString &column, group.key().split(',')) {
+			columns << column.toInt();
+			names << escapeColumnName(columnName(columns.last()));
+			placeholders << "?";
+		}
+
+		const QString tuple = "(" + placeholders.join(", ") + ")";
+		const int size = batchSize(columns.size());
+		for (int first = 0; first < rows.size(); first += size) {
+			QStringList tuples;
+			QVariantList bindValues;
+			for (int i = first, last = qMin(first + size, rows.size()); i < last; i++) {
+				foreach(int column, columns) {
+					bindValues << m_inserted.at(rows.at(i)).at(column);
+				}
+				tuples << tuple;
+			}
+
+			addStatement(job, "INSERT INTO " + tableName + " (" + names.join(", ") + ") VALUES "
+						 + tuples.join(", "), bindValues);
+		}
+	}
+}
+
+void TableModel::addStatement(QueryJob *job, const QString &query, const QVariantList &bindValues)
+{
+	job->statements << query;
+	job->statementValues << bindValues;
+}
+
+int TableModel::batchSize(int bindValuesPerRow)
+{
+	return qBound(1, MaxBindValues / qMax(bindValuesPerRow, 1), MaxBatchRows);
+}
+
+QString TableModel::columnTuple(const QStringList &columns)
+{
+	return columns.size() == 1 ? columns.first() : "(" + columns.join(", ") + ")";
+}
+
+QStringList TableModel::keyNames() const
+{
+	QStringList names;
+
+	foreach(const QString &name, m_primaryKey) {
+		names << escapeColumnName(name);
+	}
+
+	return names;
+}
+
+QList<int> TableModel::keyColumns() const
+{
+	QList<int> columns;
+
+	foreach(const QString &name, m_primaryKey) {
+		int column = 0;
+		while (column < m_columns.size() && columnName(column) != name) {
+			column++;
+		}
+
+		if (column == m_columns.size()) {
+			return QList<int>();
+		}
+		columns << column;
+	}
+
+	return columns;
+}
+
+QString TableModel::keyTuple(int row, const QList<int> &columns, QVariantList *bindValues) const
+{
+	QStringList placeholders;
+
+	foreach(int column, columns) {
+		placeholders << "?";
+		*bindValues << originalValue(row, column);
+	}
+
+	return columnTuple(placeholders);
+}
+
+const ResultChunk *TableModel::pageOf(int row, int *offset) const
+{
+	int first = m_windowStart;
+
+	for (int i = 0, count = m_pages.size(); i < count && row >= first; i++) {
+		const int next = first + m_pages.at(i).rowCount();
+		if (row < next) {
+			*offset = row - first;
+			return &m_pages.at(i);
+		}
+		first = next;
+	}
+
+	return 0;
+}
+
+int TableModel::windowEnd() const
+{
+	int end = m_windowStart;
+
+	foreach(const ResultChunk &page, m_pages) {
+		end += page.rowCount();
+	}
+
+	return end;
+}
+
+void TableModel::requestRow(int row) const
+{
+	// Views ask for every visible row while painting, the page is fetched
+	// once the event loop is back and only for the last row asked for.
+	m_wantedRow = row;
+
+	if (!m_isPageScheduled) {
+		m_isPageScheduled = true;
+		QMetaObject::invokeMethod(const_cast<TableModel *>(this), "fetchPage", Qt::QueuedConnection);
+	}
+}
+
+void TableModel::fetchPage()
+{
+	m_isPageScheduled = false;
+
+	const int row = m_wantedRow;
+	int offset;
+	if (!m_isVirtual || m_pageJobId || m_selectJobId || row < 0 || row >= m_virtualRows || pageOf(row, &offset)) {
+		return;
+	}
+
+	const int gap = PageSize * MaxGapPages;
+	if (!m_pages.isEmpty() && row >= windowEnd() && row < windowEnd() + gap) {
+		loadPage(NextPage);
+	} else if (!m_pages.isEmpty() && row < m_windowStart && row >= m_windowStart - gap) {
+		loadPage(PreviousPage);
+	} else {
+		loadPage(JumpPage, row - row % PageSize);
+	}
+}
+
+QVariant TableModel::boundOf(int row) const
+{
+	if (m_bounds.size() < 2 || m_virtualRows <= 0) {
+		return QVariant();
+	}
+
+	// Histogram bounds split the table into buckets of equal row counts;
+	// numeric keys are interpolated inside the bucket.
+	const double position = qMin(double(row) / m_virtualRows, 1.0) * (m_bounds.size() - 1);
+	const int bound = qMin(int(position), m_bounds.size() - 2);
+
+	const ResultColumn::Type type = columnType(keyColumns().value(0));
+	if (type == ResultColumn::Integer || type == ResultColumn::Real) {
+		bool isLowOk;
+		bool isHighOk;
+		const double low = m_bounds.at(bound).toDouble(&isLowOk);
+		const double high = m_bounds.at(bound + 1).toDouble(&isHighOk);
+
+		if (isLowOk && isHighOk) {
+			const double value = low + (high - low) * (position - bound);
+			return type == ResultColumn::Integer ? QVariant(qRound64(value)) : QVariant(value);
+		}
+	}
+
+	return m_bounds.at(qRound(position));
+}
+
+void TableModel::loadPage(PageLoad load, int row)
+{
+	const QStringList &keys = keyNames();
+	QStringList conditions;
+	QVariantList bindValues;
+	QString offset;
+
+	const QString &where = m_filter.whereClause(&bindValues);
+	if (!where.isEmpty()) {
+		conditions << where;
+	}
+
+	if (load == NextPage || load == PreviousPage) {
+		const ResultChunk &page = load == NextPage ? m_pages.last() : m_pages.first();
+		const int pageRow = load == NextPage ? page.rowCount() - 1 : 0;
+
+		QStringList placeholders;
+		foreach(int column, keyColumns()) {
+			placeholders << "?";
+			bindValues << page.value(pageRow, column);
+		}
+		conditions << columnTuple(keys) + (load == NextPage ? " > " : " < ") + columnTuple(placeholders);
+	} else if (load == JumpPage && row > 0) {
+		const QVariant &bound = boundOf(row);
+		if (bound.isValid()) {
+			conditions << keys.first() + " >= ?";
+			bindValues << bound;
+		} else {
+			// No statistics on the key, the server has to skip the rows
+			offset = " OFFSET ?";
+		}
+	}
+
+	QStringList orderBy;
+	foreach(const QString &key, keys) {
+		orderBy << key + (load == PreviousPage ? " DESC" : " ASC");
+	}
+
+	QString query = "SELECT * FROM " + escapeIdentifier(m_tableName);
+	if (!conditions.isEmpty()) {
+		query += " WHERE " + conditions.join(" AND ");
+	}
+	query += " ORDER BY " + orderBy.join(", ") + QString(" LIMIT %1").arg(PageSize) + offset;
+
+	QueryJob job(query);
+	job.bindValues = bindValues;
+	job.cachePrepared = true;
+	if (!offset.isEmpty()) {
+		job.bindValues << row;
+	}
+
+	m_pageLoad = load;
+	m_pageRow = row;
+	if (load == FirstPage) {
+		m_selectJobId = m_executor->submit(job);
+	} else {
+		m_pageJobId = m_executor->submit(job);
+	}
+}
+
+void TableModel::addPage(const ResultChunk &page)
+{
+	const int count = page.rowCount();
+
+	if (m_pageLoad == JumpPage) {
+		m_pages.clear();
+		m_windowStart = m_pageRow;
+		if (count > 0) {
+			m_pages << page;
+		}
+	} else if (m_pageLoad == NextPage) {
+		if (count > 0) {
+			m_pages << page;
+		}
+		while (m_pages.size() > MaxPages) {
+			m_windowStart += m_pages.takeFirst().rowCount();
+		}
+	} else if (m_pageLoad == PreviousPage) {
+		ResultChunkBuilder builder(m_columns, count);
+		for (int row = count - 1; row >= 0; row--) {
+			QVector<QVariant> values(m_columns.size());
+			for (int column = 0, columns = m_columns.size(); column < columns; column++) {
+				if (!page.isNull(row, column)) {
+					values [column] = page.value(row, column);
+				}
+			}
+			builder.addRow(values);
+		}
+
+		if (count > 0) {
+			m_pages.prepend(builder.finish());
+		}
+		m_windowStart -= count;
+		while (m_pages.size() > MaxPages) {
+			m_pages.removeLast();
+		}
+
+		// The window start was only estimated. A short page means the
+		// first row of the table is reached, rows past the top need room.
+		if (count < PageSize || m_windowStart < 0) {
+			emit layoutAboutToBeChanged();
+			const int start = count < PageSize ? 0 : PageSize;
+			m_virtualRows = qMax(m_virtualRows + start - m_windowStart, 0);
+			m_windowStart = start;
+			m_virtualRows = qMax(m_virtualRows, windowEnd());
+			emit layoutChanged();
+		}
+	}
+
+	if (m_pageLoad != PreviousPage) {
+		if (count < PageSize) {
+			setVirtualRows(windowEnd());
+		} else if (windowEnd() >= m_virtualRows) {
+			setVirtualRows(windowEnd() + PageSize);
+		}
+	}
+
+	if (!m_pages.isEmpty()) {
+		emit dataChanged(index(m_windowStart, 0), index(windowEnd() - 1, columnCount() - 1));
+	}
+}
+
+void TableModel::setVirtualRows(int rows)
+{
+	if (rows > m_virtualRows) {
+		beginInsertRows(QModelIndex(), m_virtualRows, rows - 1);
+		m_virtualRows = rows;
+		endInsertRows();
+	} else if (rows < m_virtualRows) {
+		beginRemoveRows(QModelIndex(), rows, m_virtualRows - 1);
+		m_virtualRows = rows;
+		endRemoveRows();
+	}
+}
+
+QVariant TableModel::originalValue(int row, int column) const
+{
+	return m_store.isNull(row, column) ? QVariant() : m_store.value(row, column);
+}
+
+QString TableModel::whereClause(int row, QVariantList *bindValues) const
+{
+	QStringList conditions;
+
+	for (int column = 0, count = m_columns.size(); column < count; column++) {
+		const QString &name = columnName(column);
+		if (!m_primaryKey.isEmpty() && !m_primaryKey.contains(name)) {
+			continue;
+		}
+
+		if (m_store.isNull(row, column)) {
+			conditions << escapeColumnName(name) + " IS NULL";
+		} else {
+			conditions << escapeColumnName(name) + " = ?";
+			*bindValues << originalValue(row, column);
+		}
+	}
+
+	return conditions.join(" AND ");
+}
+
+void TableModel::jobFinished(int jobId, const QueryResult &result)
+{
+	if (jobId == m_primaryKeyJobId) {
+		m_primaryKeyJobId = 0;
+		m_columnTypes.clear();
+
+		QMap<int, QString> keyColumns;
+		for (int row = 0, count = result.rows.rowCount(); row < count; row++) {
+			const QString &name = result.rows.value(row, 0).toString();
+			m_columnTypes.insert(name, result.rows.value(row, 1).toString());
+			if (!result.rows.value(row, 2).isNull()) {
+				keyColumns.insert(result.rows.value(row, 2).toInt(), name);
+			}
+			m_estimatedRows = result.rows.value(row, 3).toLongLong();
+		}
+		m_primaryKey = keyColumns.values();
+
+		if (m_isSelectRequested) {
+			m_isSelectRequested = false;
+			select();
+		}
+	} else if (jobId == m_boundsJobId) {
+		m_boundsJobId = 0;
+		m_bounds.clear();
+		for (int row = 0, count = result.rows.rowCount(); row < count; row++) {
+			m_bounds << result.rows.value(row, 0).toString();
+		}
+	} else if (jobId == m_pageJobId) {
+		m_pageJobId = 0;
+		if (result.error.isValid()) {
+			emit errorOccurred(result.error);
+			return;
+		}
+
+		addPage(result.rows);
+		fetchPage();
+	} else if (jobId == m_selectJobId) {
+		m_selectJobId = 0;
+		if (result.error.isValid()) {
+			emit errorOccurred(result.error);
+			return;
+		}
+
+		beginResetModel();
+		m_columns = result.columns;
+		m_store.setColumns(result.columns);
+		m_pages.clear();
+		m_windowStart = 0;
+		if (m_isVirtual) {
+			const int count = result.rows.rowCount();
+			if (count > 0) {
+				m_pages << result.rows;
+			}
+			m_virtualRows = count < PageSize ? count : qMax<qint64>(qMin<qint64>(m_estimatedRows, INT_MAX - PageSize), count + PageSize);
+		} else {
+			m_store.append(result.rows);
+		}
+		m_changes.clear();
+		m_removed.clear();
+		m_inserted.clear();
+		endResetModel();
+	} else if (jobId == m_submitJobId) {
+		m_submitJobId = 0;
+		if (result.error.isValid()) {
+			emit errorOccurred(result.error);
+			return;
+		}
+
+		emit submitted(m_submitStatements, result.numRowsAffected, m_submitTimer.elapsed());
+		select();
+	}
+}
@@ -0,0 +1,162 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#ifndef TABLEMODEL_H
+#define TABLEMODEL_H
+
+#include <QtCore/QAbstractTableModel>
+#include <QtCore/QStringList>
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+#include <QtCore/QElapsedTimer>
+
+#include "queryexecutor.h"
+#include "tablefilter.h"
+
+/*!
+ * Editable model of one table. Selects and changes are submitted as jobs
+ * to the connection's QueryExecutor; edits are cached until submitAll(),
+ * which sends them as one batch of multi-row statements in a transaction.
+ *
+ * Tables estimated to hold more than virtualThreshold() rows are browsed
+ * read-only in virtual mode: pages are fetched by primary key on demand
+ * and only a window of pages around the visible rows is kept.
+ */
+class TableModel : public QAbstractTableModel
+{
+	Q_OBJECT
+
+public:
+	TableModel(const QString &connectionName, const QString &tableName, QObject *parent = 0);
+	virtual ~TableModel();
+
+	QString tableName() const;
+	TableFilter filter() const;
+	void setFilter(const TableFilter &filter);
+
+	QString columnName(int column) const;
+	ResultColumn::Type columnType(int column) const;
+	bool isDirty() const;
+
+	int virtualThreshold() const;
+	void setVirtualThreshold(int rows);
+	bool isVirtual() const;
+	qint64 estimatedRows() const;
+
+	virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
+	virtual int columnCount(const QModelIndex &parent = QModelIndex()) const;
+	virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+	virtual bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole);
+	virtual Qt::ItemFlags flags(const QModelIndex &index) const;
+	virtual QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+	virtual bool insertRows(int row, int count, const QModelIndex &parent = QModelIndex());
+	virtual bool removeRows(int row, int count, const QModelIndex &parent = QModelIndex());
+	virtual void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+
+	static QString escapeIdentifier(const QString &identifier);
+	static QString escapeColumnName(const QString &name);
+
+public Q_SLOTS:
+	void select();
+	void submitAll();
+	void revertAll();
+
+Q_SIGNALS:
+	void errorOccurred(const QSqlError &error);
+	void submitted(int statements, int rows, qint64 elapsed);
+
+private Q_SLOTS:
+	void jobFinished(int jobId, const QueryResult &result);
+	void fetchPage();
+
+private:
+	Q_DISABLE_COPY(TableModel)
+
+	QVariant originalValue(int row, int column) const;
+	QString whereClause(int row, QVariantList *bindValues) const;
+	QList<int> keyColumns() const;
+	QString keyTuple(int row, const QList<int> &columns, QVariantList *bindValues) const;
+
+	void addDeletes(QueryJob *job) const;
+	void addUpdates(QueryJob *job) const;
+	void addInserts(QueryJob *job) const;
+
+	enum PageLoad {
+		FirstPage,
+		NextPage,
+		PreviousPage,
+		JumpPage
+	};
+
+	const ResultChunk *pageOf(int row, int *offset) const;
+	int windowEnd() const;
+	void requestRow(int row) const;
+	QVariant boundOf(int row) const;
+	void loadPage(PageLoad load, int row = 0);
+	void addPage(const ResultChunk &page);
+	void setVirtualRows(int rows);
+	QStringList keyNames() const;
+
+	static QString columnTuple(const QStringList &columns);
+	static int batchSize(int bindValuesPerRow);
+	static void addStatement(QueryJob *job, const QString &query, const QVariantList &bindValues);
+
+private:
+	QueryExecutor *m_executor;
+	QString m_tableName;
+	TableFilter m_filter;
+	QString m_orderBy;
+	QStringList m_primaryKey;
+	QHash<QString, QString> m_columnTypes;
+
+	int m_primaryKeyJobId;
+	int m_selectJobId;
+	bool m_isSelectRequested;
+	int m_submitJobId;
+	int m_submitStatements;
+	QElapsedTimer m_submitTimer;
+
+	ResultColumns m_columns;
+	ResultStore m_store;
+	QHash<int, QHash<int, QVariant> > m_changes;
+	QSet<int> m_removed;
+	QList<QVector<QVariant> > m_inserted;
+
+	int m_virtualThreshold;
+	bool m_isVirtual;
+	qint64 m_estimatedRows;
+	int m_virtualRows;
+	int m_windowStart;
+	QList<ResultChunk> m_pages;
+	QStringList m_bounds;
+	int m_boundsJobId;
+	int m_pageJobId;
+	PageLoad m_pageLoad;
+	int m_pageRow;
+	mutable int m_wantedRow;
+	mutable bool m_isPageScheduled;
+};
+
+#endif //TABLEMODEL_H
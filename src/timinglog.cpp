@@ -0,0 +1,60 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#include "timinglog.h"
+
+static const int timingLogCapacity = 256;
+
+QVector<TimingRecord> TimingLog::s_records;
+int TimingLog::s_next = 0;
+int TimingLog::s_count = 0;
+
+int TimingLog::capacity()
+{
+	return timingLogCapacity;
+}
+
+void TimingLog::add(const TimingRecord &record)
+{
+	if (s_records.isEmpty()) {
+		s_records.resize(timingLogCapacity);
+	}
+
+	s_records [s_next] = record;
+	s_next = (s_next + 1) % timingLogCapacity;
+	s_count = qMin(s_count + 1, timingLogCapacity);
+}
+
+QList<TimingRecord> TimingLog::records()
+{
+	// Newest first
+	QList<TimingRecord> records;
+
+	for (int i = 1; i <= s_count; i++) {
+		records << s_records.at((s_next - i + timingLogCapacity) % timingLogCapacity);
+	}
+
+	return records;
+}
@@ -0,0 +1,445 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#include <QtCore/QSettings>
+#include <QtCore/QTimer>
+
+#include <QtGui/QTabWidget>
+#include <QtGui/QTreeWidget>
+#include <QtGui/QSpinBox>
+#include <QtGui/QLabel>
+#include <QtGui/QHBoxLayout>
+#include <QtGui/QVBoxLayout>
+
+#include "activitywidget.h"
+
+// The wait column is %1, wait events are there since 9.6
+static const char *const activityQuery =
+	"SELECT pid, datname, usename, application_name, client_addr::text, state"
+	", %1"
+	", CASE WHEN state = 'active' THEN (extract(epoch FROM clock_timestamp() - query_start) * 1000)::bigint END"
+	", (extract(epoch FROM clock_timestamp() - xact_start) * 1000)::bigint"
+	", query"
+	" FROM pg_stat_activity WHERE pid <> pg_backend_pid()";
+
+// Texts are left out, they are read once per statement with textsQuery
+static const char *const statementsQuery =
+	"SELECT extract(epoch FROM clock_timestamp())::float8, userid, dbid, queryid"
+	", calls, %1, rows, shared_blks_hit, shared_blks_read"
+	" FROM pg_stat_statements(false)";
+
+static const char *const textsQuery =
+	"SELECT userid, dbid, queryid, query FROM pg_stat_statements"
+	" WHERE queryid = ANY (CAST(? AS bigint[]))";
+
+// Fails when the library is not preloaded or the function is not allowed,
+// unlike a timeout or a dropped connection of the statements poll
+static const char *const probeQuery =
+	"SELECT count(*) FROM (SELECT 1 FROM pg_stat_statements(false) LIMIT 1) s";
+
+namespace
+{
+	// Sorts by the number in Qt::UserRole where there is one
+	class SortItem : public QTreeWidgetItem
+	{
+	public:
+		explicit SortItem(QTreeWidget *view)
+			: QTreeWidgetItem(view) {}
+
+		virtual bool operator<(const QTreeWidgetItem &other) const {
+			const int column = treeWidget()->sortColumn();
+			const QVariant &left = data(column, Qt::UserRole);
+			const QVariant &right = other.data(column, Qt::UserRole);
+
+			if (left.isValid() && right.isValid()) {
+				return left.toDouble() < right.toDouble();
+			}
+
+			return QTreeWidgetItem::operator<(other);
+		}
+	};
+
+	// Cells with the same text are not touched, so they are not repainted
+	void setCell(QTreeWidgetItem *item, int column, const QString &text, const QVariant &sortKey = QVariant())
+	{
+		if (item->text(column) != text) {
+			item->setData(column, Qt::UserRole, sortKey);
+			item->setText(column, text);
+		}
+	}
+
+	void setNumber(QTreeWidgetItem *item, int column, double value, int precision)
+	{
+		setCell(item, column, QString::number(value, 'f', precision), value);
+	}
+}
+
+ActivityWidget::ActivityWidget(const QString &connectionName, QWidget *parent)
+	: QWidget(parent), connectionName_(connectionName), setupJobId_(0), activityJobId_(0), statementsJobId_(0), textsJobId_(0), probeJobId_(0)
+{
+	executor_ = new QueryExecutor(connectionName, this);
+	connect(executor_, SIGNAL(jobFinished(int, QueryResult)), this, SLOT(jobFinished(int, QueryResult)));
+	executor_->start();
+
+	pollTimer_ = new QTimer(this);
+	connect(pollTimer_, SIGNAL(timeout()), this, SLOT(poll()));
+
+	intervalLabel_ = new QLabel(this);
+
+	intervalEdit_ = new QSpinBox(this);
+	intervalEdit_->setRange(1, 3600);
+	connect(intervalEdit_, SIGNAL(valueChanged(int)), this, SLOT(setInterval(int)));
+
+	statusLabel_ = new QLabel(this);
+
+	activityView_ = new QTreeWidget(this);
+	activityView_->setRootIsDecorated(false);
+	activityView_->setColumnCount(10);
+	activityView_->setSortingEnabled(true);
+	activityView_->sortByColumn(7, Qt::DescendingOrder);
+
+	statementsView_ = new QTreeWidget(this);
+	statementsView_->setRootIsDecorated(false);
+	statementsView_->setColumnCount(9);
+	statementsView_->setSortingEnabled(true);
+	statementsView_->sortByColumn(2, Qt::DescendingOrder);
+
+	tabs_ = new QTabWidget(this);
+	tabs_->addTab(activityView_, "");
+	tabs_->addTab(statementsView_, "");
+
+	QHBoxLayout *toolLayout = new QHBoxLayout();
+	toolLayout->addWidget(intervalLabel_);
+	toolLayout->addWidget(intervalEdit_);
+	toolLayout->addWidget(statusLabel_, 1);
+
+	QVBoxLayout *mainLayout = new QVBoxLayout();
+	mainLayout->setContentsMargins(0, 0, 0, 0);
+	mainLayout->addLayout(toolLayout);
+	mainLayout->addWidget(tabs_);
+	setLayout(mainLayout);
+
+	loadSettings();
+	retranslateStrings();
+
+	setupJobId_ = submit("SELECT current_setting('server_version_num')::int"
+						 ", (SELECT extversion FROM pg_extension WHERE extname = 'pg_stat_statements')");
+}
+
+ActivityWidget::~ActivityWidget()
+{
+	saveSettings();
+
+	disconnect(executor_, 0, this, 0);
+	delete executor_;
+}
+
+void ActivityWidget::loadSettings()
+{
+	QSettings settings;
+
+	settings.beginGroup("ActivityWidget");
+	intervalEdit_->setValue(settings.value("Interval", 1).toInt());
+	settings.endGroup();
+}
+
+void ActivityWidget::saveSettings()
+{
+	QSettings settings;
+
+	settings.beginGroup("ActivityWidget");
+	settings.setValue("Interval", intervalEdit_->value());
+	settings.endGroup();
+}
+
+void ActivityWidget::retranslateStrings()
+{
+	setWindowTitle(tr("Activity of %1").arg(connectionName_));
+
+	intervalLabel_->setText(tr("Refresh every, s"));
+	tabs_->setTabText(tabs_->indexOf(activityView_), tr("Sessions"));
+	tabs_->setTabText(tabs_->indexOf(statementsView_), tr("Statements"));
+
+	activityView_->setHeaderLabels(QStringList() << tr("PID") << tr("Database") << tr("User") << tr("Application")
+								   << tr("Client") << tr("State") << tr("Wait") << tr("Query, s")
+								   << tr("Transaction, s") << tr("Query"));
+	statementsView_->setHeaderLabels(QStringList() << tr("Query") << tr("Calls/s") << tr("ms/s") << tr("Rows/s")
+									 << tr("Mean, ms") << tr("Calls") << tr("Total, ms") << tr("Rows") << tr("Hit, %"));
+}
+
+bool ActivityWidget::event(QEvent *ev)
+{
+	if (ev->type() == QEvent::LanguageChange) {
+		retranslateStrings();
+	}
+
+	return QWidget::event(ev);
+}
+
+int ActivityWidget::submit(const QString &query, const QVariantList &bindValues)
+{
+	QueryJob job(query);
+	job.bindValues = bindValues;
+
+	const int jobId = executor_->submit(job);
+	pendingJobs_ << jobId;
+	return jobId;
+}
+
+void ActivityWidget::setInterval(int seconds)
+{
+	pollTimer_->setInterval(seconds * 1000);
+}
+
+void ActivityWidget::poll()
+{
+	// A slow server gets no new polls queued behind the pending ones
+	if (!pendingJobs_.isEmpty()) {
+		return;
+	}
+
+	activityJobId_ = submit(activityQuery_);
+	if (!statementsQuery_.isEmpty()) {
+		statementsJobId_ = submit(statementsQuery_);
+	}
+}
+
+void ActivityWidget::jobFinished(int jobId, const QueryResult &result)
+{
+	if (!pendingJobs_.remove(jobId)) {
+		return;
+	}
+
+	if (jobId == setupJobId_) {
+		setupFinished(result);
+		return;
+	}
+
+	if (result.error.isValid() && jobId == activityJobId_) {
+		statusLabel_->setText(result.error.text());
+		return;
+	}
+
+	if (result.error.isValid()) {
+		if (jobId == textsJobId_) {
+			// Asked again with the next poll
+			foreach(const QString & key, textKeys_) {
+				requestedTexts_.remove(key);
+			}
+		} else if (jobId == statementsJobId_) {
+			// Polling goes on unless the probe fails too
+			probeJobId_ = submit(probeQuery);
+		} else if (jobId == probeJobId_) {
+			statementsQuery_.clear();
+		}
+		statementsError_ = result.error.text();
+	} else if (jobId == activityJobId_) {
+		updateActivity(result.rows);
+	} else if (jobId == statementsJobId_) {
+		statementsError_.clear();
+		updateStatements(result.rows);
+	} else if (jobId == textsJobId_) {
+		updateTexts(result.rows);
+	}
+
+	QString status = tr("%1 sessions, %2 statements").arg(activityItems_.size()).arg(statementItems_.size());
+	if (!statementsError_.isEmpty()) {
+		status += " (" + statementsError_ + ")";
+	}
+	statusLabel_->setText(status);
+}
+
+void ActivityWidget::setupFinished(const QueryResult &result)
+{
+	if (result.error.isValid()) {
+		statusLabel_->setText(result.error.text());
+		return;
+	}
+
+	const int version = result.rows.value(0, 0).toInt();
+	activityQuery_ = QString(activityQuery).arg(version >= 90600 ? "wait_event_type || ': ' || wait_event"
+					 : "CASE WHEN waiting THEN 'Lock' END");
+
+	if (result.rows.isNull(0, 1)) {
+		statementsError_ = tr("pg_stat_statements is not installed in this database");
+	} else if (version < 90400) {
+		statementsError_ = tr("pg_stat_statements needs PostgreSQL 9.4 or later");
+	} else {
+		statementsQuery_ = QString(statementsQuery).arg(version >= 130000 ? "total_exec_time" : "total_time");
+	}
+
+	setInterval(intervalEdit_->value());
+	pollTimer_->start();
+	poll();
+}
+
+QTreeWidgetItem *ActivityWidget::item(QTreeWidget *view, QHash<QString, QTreeWidgetItem *> *items, const QString &key,
+									  const QList<int> &numberColumns)
+{
+	QTreeWidgetItem *item = items->value(key);
+
+	if (!item) {
+		item = new SortItem(view);
+		foreach(int column, numberColumns) {
+			item->setTextAlignment(column, Qt::AlignRight | Qt::AlignVCenter);
+		}
+		items->insert(key, item);
+	}
+
+	return item;
+}
+
+void ActivityWidget::removeItems(QHash<QString, QTreeWidgetItem *> *items, const QSet<QString> &keys)
+{
+	QHash<QString, QTreeWidgetItem *>::iterator it = items->begin();
+
+	while (it != items->end()) {
+		if (keys.contains(it.key())) {
+			++it;
+		} else {
+			delete it.value();
+			it = items->erase(it);
+		}
+	}
+}
+
+void ActivityWidget::updateActivity(const ResultChunk &rows)
+{
+	static const QList<int> numberColumns = QList<int>() << 0 << 7 << 8;
+	QSet<QString> keys;
+
+	for (int row = 0, count = rows.rowCount(); row < count; row++) {
+		const QString &key = rows.value(row, 0).toString();
+		keys << key;
+
+		QTreeWidgetItem *i = item(activityView_, &activityItems_, key, numberColumns);
+		setCell(i, 0, key, rows.value(row, 0));
+		for (int column = 1; column <= 6; column++) {
+			setCell(i, column, rows.value(row, column).toString());
+		}
+		for (int column = 7; column <= 8; column++) {
+			if (rows.isNull(row, column)) {
+				setCell(i, column, QString(), -1);
+			} else {
+				setNumber(i, column, rows.value(row, column).toLongLong() / 1000.0, 1);
+			}
+		}
+
+		const QString &query = rows.value(row, 9).toString();
+		if (i->toolTip(9) != query) {
+			setCell(i, 9, query.simplified().left(500));
+			i->setToolTip(9, query);
+		}
+	}
+
+	removeItems(&activityItems_, keys);
+}
+
+void ActivityWidget::updateStatements(const ResultChunk &rows)
+{
+	static const QList<int> numberColumns = QList<int>() << 1 << 2 << 3 << 4 << 5 << 6 << 7 << 8;
+	QSet<QString> keys;
+	QSet<QString> newIds;
+	textKeys_.clear();
+
+	for (int row = 0, count = rows.rowCount(); row < count; row++) {
+		// No queryid for statements of other users without the privilege to see them
+		if (rows.isNull(row, 3)) {
+			continue;
+		}
+
+		const QString &queryId = rows.value(row, 3).toString();
+		const QString &key = rows.value(row, 1).toString() + "/" + rows.value(row, 2).toString() + "/" + queryId;
+		keys << key;
+
+		StatementSample sample;
+		sample.time = rows.value(row, 0).toDouble();
+		sample.calls = rows.value(row, 4).toLongLong();
+		sample.totalTime = rows.value(row, 5).toDouble();
+		sample.rows = rows.value(row, 6).toLongLong();
+
+		QTreeWidgetItem *i = item(statementsView_, &statementItems_, key, numberColumns);
+
+		// Rates are left empty on the first sample and after a reset of the statistics
+		const QHash<QString, StatementSample>::const_iterator previous = samples_.constFind(key);
+		const double interval = previous != samples_.constEnd() ? sample.time - previous.value().time : 0;
+
+		if (interval > 0 && sample.calls >= previous.value().calls) {
+			setNumber(i, 1, (sample.calls - previous.value().calls) / interval, 1);
+			setNumber(i, 2, (sample.totalTime - previous.value().totalTime) / interval, 1);
+			setNumber(i, 3, (sample.rows - previous.value().rows) / interval, 1);
+		} else {
+			for (int column = 1; column <= 3; column++) {
+				setCell(i, column, QString(), -1);
+			}
+		}
+		samples_.insert(key, sample);
+
+		const qint64 hit = rows.value(row, 7).toLongLong();
+		const qint64 read = rows.value(row, 8).toLongLong();
+
+		setNumber(i, 4, sample.calls > 0 ? sample.totalTime / sample.calls : 0, 3);
+		setNumber(i, 5, sample.calls, 0);
+		setNumber(i, 6, sample.totalTime, 0);
+		setNumber(i, 7, sample.rows, 0);
+		if (hit + read > 0) {
+			setNumber(i, 8, hit * 100.0 / (hit + read), 1);
+		} else {
+			setCell(i, 8, QString(), -1);
+		}
+
+		if (!requestedTexts_.contains(key)) {
+			requestedTexts_ << key;
+			textKeys_ << key;
+			newIds << queryId;
+		}
+	}
+
+	removeItems(&statementItems_, keys);
+
+	foreach(const QString & key, samples_.keys()) {
+		if (!keys.contains(key)) {
+			samples_.remove(key);
+			requestedTexts_.remove(key);
+		}
+	}
+
+	if (!newIds.isEmpty()) {
+		textsJobId_ = submit(textsQuery, QVariantList() << "{" + QStringList(newIds.toList()).join(",") + "}");
+	}
+}
+
+void ActivityWidget::updateTexts(const ResultChunk &rows)
+{
+	for (int row = 0, count = rows.rowCount(); row < count; row++) {
+		const QString &key = rows.value(row, 0).toString() + "/" + rows.value(row, 1).toString() + "/" + rows.value(row, 2).toString();
+
+		if (QTreeWidgetItem *i = statementItems_.value(key)) {
+			const QString &query = rows.value(row, 3).toString();
+			setCell(i, 0, query.simplified().left(500));
+			i->setToolTip(0, query.left(4096));
+		}
+	}
+}
@@ -0,0 +1,116 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#ifndef ACTIVITYWIDGET_H
+#define ACTIVITYWIDGET_H
+
+class QTabWidget;
+class QTreeWidget;
+class QTreeWidgetItem;
+class QSpinBox;
+class QLabel;
+class QTimer;
+
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+
+#include <QtGui/QWidget>
+
+#include "queryexecutor.h"
+
+/*!
+ * Live view of pg_stat_activity and pg_stat_statements of one server,
+ * polled on a connection of its own. Every snapshot is diffed against
+ * the previous one, so only the rows and cells that changed are touched.
+ * Statement counters become per second rates; statement texts are only
+ * fetched for statements not seen before.
+ */
+class ActivityWidget : public QWidget
+{
+	Q_OBJECT
+
+public:
+	explicit ActivityWidget(const QString &connectionName, QWidget *parent = 0);
+	virtual ~ActivityWidget();
+
+protected:
+	bool event(QEvent *ev);
+
+private:
+	Q_DISABLE_COPY(ActivityWidget)
+
+	struct StatementSample {
+		double time;
+		qint64 calls;
+		double totalTime;
+		qint64 rows;
+	};
+
+	void loadSettings();
+	void saveSettings();
+	void retranslateStrings();
+	int submit(const QString &query, const QVariantList &bindValues = QVariantList());
+	void setupFinished(const QueryResult &result);
+	void updateActivity(const ResultChunk &rows);
+	void updateStatements(const ResultChunk &rows);
+	void updateTexts(const ResultChunk &rows);
+	QTreeWidgetItem *item(QTreeWidget *view, QHash<QString, QTreeWidgetItem *> *items, const QString &key,
+						  const QList<int> &numberColumns);
+	void removeItems(QHash<QString, QTreeWidgetItem *> *items, const QSet<QString> &keys);
+
+private Q_SLOTS:
+	void poll();
+	void setInterval(int seconds);
+	void jobFinished(int jobId, const QueryResult &result);
+
+private:
+	QString connectionName_;
+	QueryExecutor *executor_;
+	QSet<int> pendingJobs_;
+	int setupJobId_;
+	int activityJobId_;
+	int statementsJobId_;
+	int textsJobId_;
+	int probeJobId_;
+	QString activityQuery_;
+	QString statementsQuery_;
+	QString statementsError_;
+
+	QHash<QString, QTreeWidgetItem *> activityItems_;
+	QHash<QString, QTreeWidgetItem *> statementItems_;
+	QHash<QString, StatementSample> samples_;
+	QSet<QString> requestedTexts_;
+	QStringList textKeys_;
+
+	QTimer *pollTimer_;
+	QLabel *intervalLabel_;
+	QSpinBox *intervalEdit_;
+	QLabel *statusLabel_;
+	QTabWidget *tabs_;
+	QTreeWidget *activityView_;
+	QTreeWidget *statementsView_;
+};
+
+#endif //ACTIVITYWIDGET_H
@@ -1,7 +1,7 @@
 #include <QtCore/QSettings>
 #include <QtCore/QDebug>
 
-#include <QtGui/QTreeWidget>
+#include <QtGui/QTreeView>
 #include <QtGui/QLayout>
 #include <QtGui/QAction>
 #include <QtGui/QMenu>
@@ -10,22 +10,34 @@
 
 #include <QtSql/QSqlDatabase>
 #include <QtSql/QSqlError>
-#include <QtSql/QSqlQuery>
 
 #include "databasetree.h"
 #include "connectiondialog.h"
+#include "importdialog.h"
+#include "catalogmodel.h"
+#include "connectionpool.h"
+#include "completionindex.h"
 
 DatabaseTree::DatabaseTree(QWidget *parent)
 	: QWidget(parent)
 {
 	setObjectName("DATABASE_TREE");
 
-	tree = new QTreeWidget(this);
+	model = new CatalogModel(this);
+	connect(model, SIGNAL(connectionRequested(QString)), this, SLOT(registerConnection(QString)));
+	connect(model, SIGNAL(connectionOpened(QString)), this, SIGNAL(connectionsChanged()));
+	connect(model, SIGNAL(errorOccurred(QSqlError)), this, SLOT(showError(QSqlError)));
+	connect(model, SIGNAL(schemesLoaded(QString, QStringList)), CompletionIndex::instance(), SLOT(setSchemes(QString, QStringList)));
+	connect(model, SIGNAL(relationsLoaded(QString, QString, QStringList)), CompletionIndex::instance(), SLOT(setRelations(QString, QString, QStringList)));
+
+	tree = new QTreeView(this);
 	tree->header()->hide();
+	tree->setUniformRowHeights(true);
+	tree->setModel(model);
+	tree->setSelectionMode(QAbstractItemView::ExtendedSelection);
 	tree->setContextMenuPolicy(Qt::CustomContextMenu);
 	connect(tree, SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(treeContextMenu(QPoint)));
-	connect(tree, SIGNAL(itemExpanded(QTreeWidgetItem *)), this, SLOT(itemExpanded(QTreeWidgetItem *)));
-	connect(tree, SIGNAL(itemActivated(QTreeWidgetItem *, int)), this, SLOT(itemActivated(QTreeWidgetItem *, int)));
+	connect(tree, SIGNAL(activated(QModelIndex)), this, SLOT(itemActivated(QModelIndex)));
 
 	QVBoxLayout *mainLayout = new QVBoxLayout();
 	mainLayout->setContentsMargins(0, 0, 0, 0);
@@ -41,6 +53,27 @@ DatabaseTree::DatabaseTree(QWidget *parent)
 	actionCloseConnection = new QAction(this);
 	connect(actionCloseConnection, SIGNAL(triggered()), this, SLOT(closeConnection()));
 
+	actionRefresh = new QAction(this);
+	actionRefresh->setIcon(QIcon(":/share/images/refresh.png"));
+	connect(actionRefresh, SIGNAL(triggered()), this, SLOT(refresh()));
+
+	actionRunOnSelected = new QAction(this);
+	connect(actionRunOnSelected, SIGNAL(triggered()), this, SLOT(runOnSelected()));
+
+	actionImport = new QAction(this);
+	actionImport->setIcon(QIcon(":/share/images/open.png"));
+	connect(actionImport, SIGNAL(triggered()), this, SLOT(importTable()));
+
+	actionPoolStatistics = new QAction(this);
+	connect(actionPoolStatistics, SIGNAL(triggered()), this, SLOT(showPoolStatistics()));
+
+	actionActivity = new QAction(this);
+	connect(actionActivity, SIGNAL(triggered()), this, SLOT(showActivity()));
+
+	actionConnect = new QAction(this);
+	actionConnect->setIcon(QIcon(":/share/images/connect_established.png"));
+	connect(actionConnect, SIGNAL(triggered()), this, SLOT(connectSelected()));
+
 	retranslateStrings();
 	loadSettings();
 	loadTree();
@@ -49,17 +82,39 @@ DatabaseTree::DatabaseTree(QWidget *parent)
 DatabaseTree::~DatabaseTree()
 {
 	saveSettings();
-	foreach(const QString & connectionName, QSqlDatabase::connectionNames()) {
-		QSqlDatabase::database(connectionName).close();
+	model->saveCache();
+	ConnectionPool::closePools();
+	QueryExecutor::closeExecutors();
+	foreach(const QString & connectionName, QueryExecutor::connectionNames()) {
+		QSqlDatabase::database(connectionName, false).close();
 		QSqlDatabase::removeDatabase(connectionName);
 	}
 }
 
 QString DatabaseTree::currentConnection() const
 {
-	QTreeWidgetItem *item = tree->currentItem();
-	const QMap <QString, QVariant> &option = item->data(0, Qt::UserRole).value<QMap <QString, QVariant>> ();
-	return option.value("ConnectionName").toString();
+	return model->connectionName(tree->currentIndex());
+}
+
+QStringList DatabaseTree::selectedConnections()
+{
+	QStringList result;
+
+	foreach(const QModelIndex & index, tree->selectionModel()->selectedRows()) {
+		const CatalogModel::Kind kind = model->kind(index);
+		if (kind != CatalogModel::ConnectionNode && kind != CatalogModel::DatabaseNode) {
+			continue;
+		}
+
+		const QString &connectionName = model->connectionName(index);
+		registerConnection(connectionName);
+
+		if (!result.contains(connectionName)) {
+			result << connectionName;
+		}
+	}
+
+	return result;
 }
 
 void DatabaseTree::loadSettings()
@@ -83,6 +138,8 @@ void DatabaseTree::loadSettings()
 		connections.append(c);
 	}
 	settings.endArray();
+
+	connectTimeout = settings.value("ConnectTimeout", 10).toInt();
 }
 
 void DatabaseTree::saveSettings()
@@ -102,6 +159,8 @@ void DatabaseTree::saveSettings()
 		settings.setValue("Password", connections.at(i).password);
 	}
 	settings.endArray();
+
+	settings.setValue("ConnectTimeout", connectTimeout);
 }
 
 void DatabaseTree::retranslateStrings()
@@ -110,6 +169,12 @@ void DatabaseTree::retranslateStrings()
 	actionAddConnection->setText(tr("Add connection"));
 	actionEditConnection->setText(tr("Edit connection"));
 	actionCloseConnection->setText(tr("Close connection"));
+	actionRefresh->setText(tr("Refresh"));
+	actionRunOnSelected->setText(tr("Run SQL on selected"));
+	actionConnect->setText(tr("Connect"));
+	actionPoolStatistics->setText(tr("Pool statistics"));
+	actionActivity->setText(tr("Server activity"));
+	actionImport->setText(tr("Import from file"));
 }
 
 void DatabaseTree::addConnection()
@@ -146,6 +211,8 @@ void DatabaseTree::editConnection()
 	d.setPassword(connections.at(index).password);
 
 	if (d.exec()) {
+		closeDatabases(connections.at(index).name);
+
 		connections [index].name = d.connectionName();
 		connections [index].host = d.host();
 		connections [index].port = d.port();
@@ -163,429 +230,216 @@ void DatabaseTree::closeConnection()
 	if (!action)
 		return;
 
-	const QString &connectionName = action->data().toString();
+	closeDatabases(action->data().toString());
+}
 
-	foreach(const QString & name, QSqlDatabase::connectionNames()) {
-		if (name.startsWith(connectionName)) {
+void DatabaseTree::closeDatabases(const QString &connectionName)
+{
+	ConnectionPool::closePools(connectionName);
+	QueryExecutor::closeExecutors(connectionName);
+	foreach(const QString & name, QueryExecutor::connectionNames()) {
+		if (name == connectionName || name.startsWith(connectionName + ".")) {
 			QSqlDatabase::database(name, false).close();
-			if (QSqlDatabase::database(name, false).isOpen()) {
-				QMessageBox::critical(this, "", QSqlDatabase::database(name, false).lastError().text());
-				return;
-			}
 			QSqlDatabase::removeDatabase(name);
 		}
 	}
 
+	model->closeConnection(connectionName);
 	emit connectionsChanged();
-	loadTree();
+}
+
+void DatabaseTree::refresh()
+{
+	model->refresh(tree->currentIndex());
+}
+
+void DatabaseTree::showError(const QSqlError &error)
+{
+	QMessageBox::critical(this, "", error.text());
 }
 
 void DatabaseTree::treeContextMenu(const QPoint &point)
 {
 	QMenu menu;
 
-	QTreeWidgetItem *item = tree->itemAt(point);
-	if (!item) {
+	const QModelIndex &index = tree->indexAt(point);
+	if (!index.isValid()) {
 		menu.addAction(actionAddConnection);
 	} else {
-		const QMap <QString, QVariant> &option = item->data(0, Qt::UserRole).value<QMap <QString, QVariant>> ();
-		if (option ["Type"].toString() == "Connection") {
-			actionEditConnection->setData(option ["Index"]);
+		const QString &connectionName = model->connectionName(index);
+		const CatalogModel::Kind kind = model->kind(index);
+		const bool isConnection = kind == CatalogModel::ConnectionNode || kind == CatalogModel::DatabaseNode;
+
+		if (kind == CatalogModel::ConnectionNode) {
+			actionEditConnection->setData(index.row());
 			menu.addAction(actionEditConnection);
-			if (QSqlDatabase::contains(item->text(0))) {
-				actionCloseConnection->setData(item->text(0));
-				menu.addAction(actionCloseConnection);
-			}
 		}
-		if (option ["Type"].toString() == "Database") {
-			const QString &connectionName = option ["ConnectionName"].toString() + "." + item->text(0);
-			if (QSqlDatabase::contains(connectionName)) {
-				actionCloseConnection->setData(connectionName);
-				menu.addAction(actionCloseConnection);
-			}
+		if (isConnection && QSqlDatabase::contains(connectionName)) {
+			actionCloseConnection->setData(connectionName);
+			menu.addAction(actionCloseConnection);
 		}
-	}
-
-	if (!menu.actions().isEmpty()) {
-		menu.exec(tree->mapToGlobal(point));
-	}
-}
-
-void DatabaseTree::loadTree()
-{
-	QMap<QString, QVariant> options;
-	options ["Type"] = "Connection";
-
-	QTreeWidgetItem *item;
-
-	for (int i = 0, size = connections.size(); i < size; i++) {
-
-		item = 0;
-		const QList<QTreeWidgetItem *> l = tree->findItems(connections.at(i).name, Qt::MatchFixedString, 0);
-		foreach(QTreeWidgetItem * i, l) {
-			if (i->parent() == 0) {
-				item = i;
-				break;
-			}
+		if (!isConnection || model->isLoaded(index)) {
+			menu.addAction(actionRefresh);
 		}
-
-		if (!item) {
-			item = new QTreeWidgetItem();
-			item->setText(0, connections.at(i).name);
-			options ["Index"] = i;
-			item->setData(0, Qt::UserRole, options);
-
-			tree->addTopLevelItem(item);
+		if (kind == CatalogModel::TableNode) {
+			actionImport->setData(QStringList() << connectionName << model->schemeName(index) + "." + model->name(index));
+			menu.addAction(actionImport);
 		}
-
-		if (QSqlDatabase::database(item->text(0), false).isOpen()) {
-			loadDatabases(item);
-			item->setData(0, Qt::DecorationRole, QIcon(":/share/images/connect_established.png"));
-		} else {
-			item->setData(0, Qt::DecorationRole, QIcon(":/share/images/connect_no.png"));
-			item->setExpanded(false);
-			qDeleteAll(item->takeChildren());
-			item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+		if (isConnection) {
+			actionPoolStatistics->setData(connectionName);
+			menu.addAction(actionPoolStatistics);
+			actionActivity->setData(connectionName);
+			menu.addAction(actionActivity);
 		}
 	}
-}
-
-void DatabaseTree::loadDatabases(QTreeWidgetItem *parent)
-{
-	QMap<QString, QVariant> options = parent->data(0, Qt::UserRole).value<QMap<QString, QVariant>> ();
-	options ["Type"] = "Database";
-	options ["ConnectionName"] = parent->text(0);
-
-	QSqlQuery query(QSqlDatabase::database(parent->text(0)));
-	if (!query.exec("SELECT datname FROM pg_database")) {
-		QMessageBox::critical(this, "", query.lastError().text());
-		return;
-	}
 
-	QTreeWidgetItem *item = 0;
-	const QList<QTreeWidgetItem *> l = tree->findItems(tr("Databases"), Qt::MatchFixedString | Qt::MatchRecursive, 0);
-	foreach(QTreeWidgetItem * i, l) {
-		if (i->parent() == parent) {
-			item = i;
+	foreach(const QModelIndex & selected, tree->selectionModel()->selectedRows()) {
+		if (model->canFetchMore(selected)) {
+			menu.addAction(actionConnect);
 			break;
 		}
 	}
-	if (!item) {
-		item = new QTreeWidgetItem();
-		item->setText(0, tr("Databases"));
-
-		item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
 
-		parent->addChild(item);
+	if (tree->selectionModel()->selectedRows().size() > 1) {
+		menu.addAction(actionRunOnSelected);
 	}
-	parent = item;
-
-	while (query.next()) {
-		item = 0;
-		const QList<QTreeWidgetItem *> l = tree->findItems(query.value(0).toString(), Qt::MatchFixedString | Qt::MatchRecursive, 0);
-		foreach(QTreeWidgetItem * i, l) {
-			if (i->parent() == parent) {
-				item = i;
-				break;
-			}
-		}
 
-		if (!item) {
-			item = new QTreeWidgetItem();
-			item->setText(0, query.value(0).toString());
-			item->setData(0, Qt::UserRole, options);
+	if (!menu.actions().isEmpty()) {
+		menu.exec(tree->mapToGlobal(point));
+	}
+}
 
-			parent->addChild(item);
-		}
-		if (QSqlDatabase::database(options ["ConnectionName"].toString() + "." + item->text(0), false).isOpen()) {
-			item->setData(0, Qt::DecorationRole, QIcon(":/share/images/database.png"));
-			loadSchemes(item);
-		} else {
-			item->setData(0, Qt::DecorationRole, QIcon(":/share/images/disconnected-database.png"));
-			item->setExpanded(false);
-			qDeleteAll(item->takeChildren());
-			item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
-		}
+void DatabaseTree::runOnSelected()
+{
+	const QStringList &connectionNames = selectedConnections();
+	if (!connectionNames.isEmpty()) {
+		emit connectionsChanged();
+		emit runOnTargets(connectionNames);
 	}
 }
 
-void DatabaseTree::loadSchemes(QTreeWidgetItem *parent)
+void DatabaseTree::importTable()
 {
-	QMap<QString, QVariant> options = parent->data(0, Qt::UserRole).value <QMap<QString, QVariant>> ();
-	options ["Type"] = "Scheme";
-	options ["ConnectionName"] = options ["ConnectionName"].toString() + "." + parent->text(0);
+	QAction *action = qobject_cast <QAction *> (sender());
+	if (!action)
+		return;
 
-	QSqlQuery query(QSqlDatabase::database(options ["ConnectionName"].toString()));
+	const QStringList &table = action->data().toStringList();
+	if (table.size() == 2) {
+		ImportDialog d(table.at(0), table.at(1), this);
+		d.exec();
+	}
+}
 
-	if (!query.exec("SELECT nspname, oid FROM pg_namespace ORDER BY 1")) {
-		QMessageBox::critical(this, "", query.lastError().text());
+void DatabaseTree::showPoolStatistics()
+{
+	QAction *action = qobject_cast <QAction *> (sender());
+	if (!action)
 		return;
-	}
 
-	QTreeWidgetItem *item = 0;
+	const QString &connectionName = action->data().toString();
+	QStringList lines;
 
-	const QList<QTreeWidgetItem *> l = tree->findItems(tr("Schemes"), Qt::MatchFixedString | Qt::MatchRecursive, 0);
-	foreach(QTreeWidgetItem * i, l) {
-		if (i->parent() == parent) {
-			item = i;
-			break;
+	foreach(const QString & name, ConnectionPool::connectionNames()) {
+		if (name != connectionName && !name.startsWith(connectionName + ".")) {
+			continue;
 		}
-	}
-	if (!item) {
-		item = new QTreeWidgetItem();
-		item->setText(0, tr("Schemes"));
-		item->setData(0, Qt::UserRole, options);
-		item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
 
-		parent->addChild(item);
+		const PoolStatistics &statistics = ConnectionPool::pool(name)->statistics();
+		const qint64 preparedRuns = statistics.preparedHits + statistics.preparedMisses;
+		lines << name
+			  << tr("  connections: %1 (%2 checked out)").arg(statistics.size).arg(statistics.checkedOut)
+			  << tr("  checkouts: %1 (%2 shared)").arg(statistics.checkouts).arg(statistics.sharedCheckouts)
+			  << tr("  wait time: %1 ms").arg(statistics.waitTime / 1000)
+			  << tr("  reconnects: %1").arg(statistics.reconnects)
+			  << tr("  health checks: %1 (%2 failed)").arg(statistics.healthChecks).arg(statistics.failedHealthChecks)
+			  << tr("  reaped: %1").arg(statistics.reaped)
+			  << tr("  prepared statements: %1 hits of %2 runs (%3%), %4 ms saved")
+			  .arg(statistics.preparedHits).arg(preparedRuns)
+			  .arg(preparedRuns > 0 ? statistics.preparedHits * 100 / preparedRuns : 0)
+			  .arg(statistics.preparedTimeSaved / 1000);
 	}
-	parent = item;
-
-	while (query.next()) {
-		item = 0;
-		const QList<QTreeWidgetItem *> l = tree->findItems(query.value(0).toString(), Qt::MatchFixedString | Qt::MatchRecursive, 0);
-		foreach(QTreeWidgetItem * i, l) {
-			if (i->parent() == parent) {
-				item = i;
-				break;
-			}
-		}
-
-		if (!item) {
-			item = new QTreeWidgetItem();
-			item->setText(0, query.value(0).toString());
-			options ["ID"] = query.value(1);
-			options ["Scheme"] = query.value(0).toString();
-			item->setData(0, Qt::UserRole, options);
-			item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
 
-			parent->addChild(item);
-		}
-		loadTables(item);
-		loadViews(item);
-		loadSequences(item);
+	if (lines.isEmpty()) {
+		lines << tr("No pooled connections");
 	}
+
+	QMessageBox::information(this, tr("Pool statistics"), lines.join("\n"));
 }
 
-void DatabaseTree::loadTables(QTreeWidgetItem *parent)
+void DatabaseTree::showActivity()
 {
-	QMap<QString, QVariant> options = parent->data(0, Qt::UserRole).value<QMap<QString, QVariant>> ();
-	options ["Type"] = "Table";
-
-	QSqlQuery query(QSqlDatabase::database(options ["ConnectionName"].toString()));
-	query.prepare("SELECT relname FROM pg_class WHERE relkind='r' AND relnamespace=:relnamespace ORDER BY 1");
-	query.bindValue(":relnamespace", options ["ID"].toInt());
-
-	if (!query.exec()) {
-		QMessageBox::critical(this, "", query.lastError().text());
+	QAction *action = qobject_cast <QAction *> (sender());
+	if (!action)
 		return;
-	}
-
-	QTreeWidgetItem *item = 0;
 
-	const QList<QTreeWidgetItem *> l = tree->findItems(tr("Tables"), Qt::MatchFixedString | Qt::MatchRecursive, 0);
-	foreach(QTreeWidgetItem * i, l) {
-		if (i->parent() == parent) {
-			item = i;
-			break;
-		}
-	}
-	if (!item) {
-		item = new QTreeWidgetItem();
-		item->setText(0, tr("Tables"));
-		item->setData(0, Qt::UserRole, options);
-		item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
-		item->setData(0, Qt::DecorationRole, QIcon(":/share/images/table.png"));
-
-		parent->addChild(item);
-	}
-	parent = item;
-
-	while (query.next()) {
-		item = 0;
-		const QList<QTreeWidgetItem *> l = tree->findItems(query.value(0).toString(), Qt::MatchFixedString | Qt::MatchRecursive, 0);
-		foreach(QTreeWidgetItem * i, l) {
-			if (i->parent() == parent) {
-				item = i;
-				break;
-			}
-		}
-
-		if (!item) {
-			item = new QTreeWidgetItem();
-			item->setText(0, query.value(0).toString());
-			item->setData(0, Qt::UserRole, options);
-			item->setData(0, Qt::DecorationRole, QIcon(":/share/images/table.png"));
+	const QString &connectionName = action->data().toString();
+	registerConnection(connectionName);
+	emit openActivity(connectionName);
+}
 
-			parent->addChild(item);
+void DatabaseTree::connectSelected()
+{
+	// Every database has its own executor thread, so the connections
+	// are opened in parallel and the catalogs arrive as they are ready.
+	foreach(const QModelIndex & index, tree->selectionModel()->selectedRows()) {
+		if (model->canFetchMore(index)) {
+			model->fetchMore(index);
 		}
 	}
 }
 
-void DatabaseTree::loadViews(QTreeWidgetItem *parent)
+void DatabaseTree::registerConnection(const QString &connectionName)
 {
-	QMap<QString, QVariant> options = parent->data(0, Qt::UserRole).value<QMap<QString, QVariant>> ();
-	options ["Type"] = "View";
-
-	QSqlQuery query(QSqlDatabase::database(options ["ConnectionName"].toString()));
-	query.prepare("SELECT relname FROM pg_class WHERE relkind='v' AND relnamespace=:relnamespace ORDER BY 1");
-	query.bindValue(":relnamespace", options ["ID"].toInt());
-
-	if (!query.exec()) {
-		QMessageBox::critical(this, "", query.lastError().text());
-		return;
-	}
-
-	QTreeWidgetItem *item = 0;
-
-	const QList<QTreeWidgetItem *> l = tree->findItems(tr("Views"), Qt::MatchFixedString | Qt::MatchRecursive, 0);
-	foreach(QTreeWidgetItem * i, l) {
-		if (i->parent() == parent) {
-			item = i;
-			break;
+	foreach(const Connection & c, connections) {
+		if (connectionName == c.name) {
+			addDatabase(c, connectionName, c.maintenanceBase);
+			return;
 		}
 	}
-	if (!item) {
-		item = new QTreeWidgetItem();
-		item->setText(0, tr("Views"));
-		item->setData(0, Qt::UserRole, options);
-		item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
-		item->setData(0, Qt::DecorationRole, QIcon(":/share/images/view.png"));
-
-		parent->addChild(item);
-	}
-	parent = item;
-
-	while (query.next()) {
-		item = 0;
-		const QList<QTreeWidgetItem *> l = tree->findItems(query.value(0).toString(), Qt::MatchFixedString | Qt::MatchRecursive, 0);
-		foreach(QTreeWidgetItem * i, l) {
-			if (i->parent() == parent) {
-				item = i;
-				break;
-			}
-		}
-
-		if (!item) {
-			item = new QTreeWidgetItem();
-			item->setText(0, query.value(0).toString());
-			item->setData(0, Qt::UserRole, options);
-			item->setData(0, Qt::DecorationRole, QIcon(":/share/images/view.png"));
 
-			parent->addChild(item);
+	foreach(const Connection & c, connections) {
+		if (connectionName.startsWith(c.name + ".")) {
+			addDatabase(c, connectionName, connectionName.mid(c.name.size() + 1));
+			return;
 		}
 	}
 }
 
-void DatabaseTree::loadSequences(QTreeWidgetItem *parent)
+QSqlDatabase DatabaseTree::addDatabase(const Connection &c, const QString &connectionName, const QString &databaseName)
 {
-	QMap<QString, QVariant> options = parent->data(0, Qt::UserRole).value<QMap<QString, QVariant>> ();
-	options ["Type"] = "Sequence";
-
-	QSqlQuery query(QSqlDatabase::database(options ["ConnectionName"].toString()));
-	query.prepare("SELECT relname FROM pg_class WHERE relkind='S' AND relnamespace=:relnamespace ORDER BY 1");
-	query.bindValue(":relnamespace", options ["ID"].toInt());
-
-	if (!query.exec()) {
-		QMessageBox::critical(this, "", query.lastError().text());
-		return;
+	if (QSqlDatabase::contains(connectionName)) {
+		return QSqlDatabase::database(connectionName, false);
 	}
 
-	QTreeWidgetItem *item = 0;
+	QSqlDatabase db = QSqlDatabase::addDatabase("QPSQL", connectionName);
 
-	const QList<QTreeWidgetItem *> l = tree->findItems(tr("Sequences"), Qt::MatchFixedString | Qt::MatchRecursive, 0);
-	foreach(QTreeWidgetItem * i, l) {
-		if (i->parent() == parent) {
-			item = i;
-			break;
-		}
+	db.setHostName(c.host);
+	db.setPort(c.port);
+	db.setUserName(c.userName);
+	db.setPassword(c.password);
+	db.setDatabaseName(databaseName);
+	if (connectTimeout > 0) {
+		db.setConnectOptions(QString("connect_timeout=%1").arg(connectTimeout));
 	}
-	if (!item) {
-		item = new QTreeWidgetItem();
-		item->setText(0, tr("Sequences"));
-		item->setData(0, Qt::UserRole, options);
-		item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
-		item->setData(0, Qt::DecorationRole, QIcon(":/share/images/sequence.png"));
-
-		parent->addChild(item);
-	}
-	parent = item;
-
-	while (query.next()) {
-		item = 0;
-		const QList<QTreeWidgetItem *> l = tree->findItems(query.value(0).toString(), Qt::MatchFixedString | Qt::MatchRecursive, 0);
-		foreach(QTreeWidgetItem * i, l) {
-			if (i->parent() == parent) {
-				item = i;
-				break;
-			}
-		}
 
-		if (!item) {
-			item = new QTreeWidgetItem();
-			item->setText(0, query.value(0).toString());
-			item->setData(0, Qt::UserRole, options);
-			item->setData(0, Qt::DecorationRole, QIcon(":/share/images/sequence.png"));
-
-			parent->addChild(item);
-		}
-	}
+	return db;
 }
 
-void DatabaseTree::itemExpanded(QTreeWidgetItem *item)
+void DatabaseTree::loadTree()
 {
-	QMap<QString, QVariant> options = item->data(0, Qt::UserRole).value<QMap<QString, QVariant>> ();
-
-	if (options ["Type"].toString() == "Connection") {
-		if (!QSqlDatabase::database(item->text(0)).isOpen()) {
-			const Connection &c = connections.at(options ["Index"].toInt());
-
-			QSqlDatabase db = QSqlDatabase::addDatabase("QPSQL", c.name);
-
-			db.setHostName(c.host);
-			db.setPort(c.port);
-			db.setDatabaseName(c.maintenanceBase);
-			db.setUserName(c.userName);
-			db.setPassword(c.password);
-
-			if (!db.open()) {
-				QMessageBox::critical(this, "", db.lastError().text());
-				QSqlDatabase::removeDatabase(c.name);
-			} else {
-				loadTree();
-				emit connectionsChanged();
-			}
-		}
-	}
-	if (options ["Type"].toString() == "Database") {
-		const Connection &c = connections.at(options ["Index"].toInt());
-		if (!QSqlDatabase::database(c.name + "." + item->text(0)).isOpen()) {
-			QSqlDatabase db = QSqlDatabase::addDatabase("QPSQL", c.name + "."  + item->text(0));
-
-			db.setHostName(c.host);
-			db.setPort(c.port);
-			db.setUserName(c.userName);
-			db.setPassword(c.password);
-			db.setDatabaseName(item->text(0));
-
-			if (!db.open()) {
-				QMessageBox::critical(this, "", db.lastError().text());
-				QSqlDatabase::removeDatabase(c.name + "."  + item->text(0));
-			} else {
-				loadTree();
-				emit connectionsChanged();
-			}
-		}
+	QStringList connectionNames;
+
+	foreach(const Connection & c, connections) {
+		connectionNames << c.name;
 	}
+
+	model->setConnections(connectionNames);
 }
 
-void DatabaseTree::itemActivated(QTreeWidgetItem *item, int column)
+void DatabaseTree::itemActivated(const QModelIndex &index)
 {
-	Q_UNUSED(column)
-
-	QMap<QString, QVariant> options = item->data(0, Qt::UserRole).value<QMap<QString, QVariant>> ();
-
-	if (options ["Type"].toString() == "Table") {
-		emit openTable(options ["ConnectionName"].toString(), options ["Scheme"].toString() + "." + item->text(0));
+	if (model->kind(index) == CatalogModel::TableNode) {
+		emit openTable(model->connectionName(index), model->schemeName(index) + "." + model->name(index));
 	}
 }
@@ -25,9 +25,14 @@
 #ifndef DATABASETREE_H
 #define DATABASETREE_H
 
-class QTreeWidget;
-class QTreeWidgetItem;
+class QTreeView;
+class QModelIndex;
 class QAction;
+class QSqlDatabase;
+class QSqlError;
+class CatalogModel;
+
+#include <QtCore/QStringList>
 
 #include <QtGui/QWidget>
 
@@ -46,42 +51,57 @@ private:
 	};
 
 private:
-	QTreeWidget *tree;
+	QTreeView *tree;
+	CatalogModel *model;
 
 	QAction *actionAddConnection;
 	QAction *actionEditConnection;
 	QAction *actionCloseConnection;
+	QAction *actionRefresh;
+	QAction *actionRunOnSelected;
+	QAction *actionConnect;
+	QAction *actionPoolStatistics;
+	QAction *actionActivity;
+	QAction *actionImport;
 
 	QList<Connection> connections;
+	int connectTimeout;
 public:
 	DatabaseTree(QWidget *parent);
 	~DatabaseTree();
 
 	QString currentConnection() const;
+	QStringList selectedConnections();
 
 private:
 	void loadSettings();
 	void saveSettings();
 	void retranslateStrings();
 	void loadTree();
-	void loadDatabases(QTreeWidgetItem *parent);
-	void loadSchemes(QTreeWidgetItem *parent);
-	void loadTables(QTreeWidgetItem *parent);
-	void loadViews(QTreeWidgetItem *parent);
-	void loadSequences(QTreeWidgetItem *parent);
+	void closeDatabases(const QString &connectionName);
+	QSqlDatabase addDatabase(const Connection &c, const QString &connectionName, const QString &databaseName);
 
 private Q_SLOTS:
 	void addConnection();
 	void editConnection();
 	void closeConnection();
+	void refresh();
+	void showError(const QSqlError &error);
 	void treeContextMenu(const QPoint &point);
+	void runOnSelected();
+	void connectSelected();
+	void showPoolStatistics();
+	void showActivity();
+	void importTable();
+	void registerConnection(const QString &connectionName);
 
-	void itemExpanded(QTreeWidgetItem *item);
-	void itemActivated(QTreeWidgetItem *item, int column);
+	void itemActivated(const QModelIndex &index);
 
 Q_SIGNALS:
 	void openTable(const QString &connectionName, const QString &tableName);
+	void openActivity(const QString &connectionName);
 	void connectionsChanged();
+	void runOnTargets(const QStringList &connectionNames);
 };
 
 #endif //DATABASETREE_H
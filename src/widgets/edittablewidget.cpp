@@ -1,21 +1,28 @@
+#include <QtCore/QSettings>
+
 #include <QtGui/QTableView>
 #include <QtGui/QVBoxLayout>
 #include <QtGui/QToolBar>
+#include <QtGui/QStatusBar>
 #include <QtGui/QAction>
 #include <QtGui/QtEvents>
-
-#include <QtSql/QSqlTableModel>
-#include <QtSql/QSqlRecord>
-#include <QtSql/QSqlField>
+#include <QtGui/QMessageBox>
 
 #include "edittablewidget.h"
+#include "tablemodel.h"
+#include "importdialog.h"
 
 EditTableWidget::EditTableWidget(const QString &connectionName, const QString &tableName, QWidget *parent)
 	: QWidget(parent)
+	, connectionName(connectionName)
 {
-	model = new QSqlTableModel(this, QSqlDatabase::database(connectionName));
-	model->setEditStrategy(QSqlTableModel::OnManualSubmit);
-	model->setTable(tableName);
+	model = new TableModel(connectionName, tableName, this);
+	connect(model, SIGNAL(errorOccurred(QSqlError)), this, SLOT(showError(QSqlError)));
+	connect(model, SIGNAL(submitted(int, int, qint64)), this, SLOT(showSubmitted(int, int, qint64)));
+	connect(model, SIGNAL(modelReset()), this, SLOT(updateMode()));
+
+	QSettings settings;
+	model->setVirtualThreshold(settings.value("EditTableWidget/VirtualRows", 100000).toInt());
 	model->select();
 
 	view = new QTableView(this);
@@ -25,10 +32,14 @@ EditTableWidget::EditTableWidget(const QString &connectionName, const QString &t
 
 	toolBar = new QToolBar(this);
 
+	statusBar = new QStatusBar(this);
+	statusBar->setSizeGripEnabled(false);
+
 	QVBoxLayout *mainLayout = new QVBoxLayout();
 	mainLayout->setContentsMargins(0, 0, 0, 0);
 	mainLayout->addWidget(toolBar);
 	mainLayout->addWidget(view);
+	mainLayout->addWidget(statusBar);
 	setLayout(mainLayout);
 
 	actionSave = new QAction(this);
@@ -44,6 +55,12 @@ EditTableWidget::EditTableWidget(const QString &connectionName, const QString &t
 	connect(actionRevert, SIGNAL(triggered()), model, SLOT(revertAll()));
 	toolBar->addAction(actionRevert);
 
+	actionImport = new QAction(this);
+	actionImport->setObjectName("IMPORT");
+	actionImport->setIcon(QIcon(":/share/images/open.png"));
+	connect(actionImport, SIGNAL(triggered()), this, SLOT(importData()));
+	toolBar->addAction(actionImport);
+
 	actionAddIncludeFilter = new QAction(this);
 	actionAddIncludeFilter->setObjectName("ADD_INCLUDE_FILTER");
 	connect(actionAddIncludeFilter, SIGNAL(triggered()), this, SLOT(addIncludeFilter()));
@@ -76,57 +93,65 @@ void EditTableWidget::retranslateStrings()
 	setWindowTitle(tr("Edit table") + " " + model->tableName());
 	actionSave->setText(tr("Save"));
 	actionRevert->setText(tr("Revert"));
+	actionImport->setText(tr("Import from file"));
 	actionAddIncludeFilter->setText(tr("Add include filter"));
 	actionAddExcludeFilter->setText(tr("Add exclude filter"));
 }
 
-QString EditTableWidget::dataForFilter(const QModelIndex &index)
+void EditTableWidget::showError(const QSqlError &error)
 {
-	const QSqlRecord &record = model->record();
-	QString data = index.data(Qt::EditRole).toString();
-	switch (record.field(index.column()).type()) {
-	case QVariant::String: case QVariant::Date: case QVariant::Time: case QVariant::DateTime:
-		data = "'" + data + "'";
-		break;
-	default:
-		break;
-	}
-	return data;
+	QMessageBox::critical(this, "", error.text());
 }
 
-void EditTableWidget::addIncludeFilter()
+void EditTableWidget::updateMode()
 {
-	const QString &data = dataForFilter(view->currentIndex());
-	const QString &column =  model->record().fieldName(view->currentIndex().column());
-
-	QString filter = model->filter();
+	// Sorting by a header would reselect the whole table
+	if (view->isSortingEnabled() == model->isVirtual()) {
+		view->setSortingEnabled(!model->isVirtual());
+	}
 
-	if (!filter.isEmpty())
-		filter += " AND ";
+	foreach(QAction *action, QList<QAction *>() << actionSave << actionRevert) {
+		action->setEnabled(!model->isVirtual());
+	}
 
-	if (view->currentIndex().data(Qt::EditRole).isNull()) {
-		model->setFilter(filter + column + " IS NULL");
-	} else {
-		model->setFilter(filter + column + "=" + data);
+	if (model->isVirtual()) {
+		statusBar->showMessage(tr("About %1 rows, read only, paged by primary key").arg(model->estimatedRows()));
 	}
+}
 
-	model->select();
+void EditTableWidget::showSubmitted(int statements, int rows, qint64 elapsed)
+{
+	statusBar->showMessage(tr("%1 rows saved with %2 statements in %3 msecs").arg(rows).arg(statements).arg(elapsed));
 }
 
-void EditTableWidget::addExcludeFilter()
+void EditTableWidget::addFilter(bool isInclude)
 {
-	const QString &data = dataForFilter(view->currentIndex());
-	const QString &column =  model->record().fieldName(view->currentIndex().column());
+	const QModelIndex &index = view->currentIndex();
+	if (!index.isValid())
+		return;
+
+	TableFilter filter = model->filter();
+	filter.add(model->columnName(index.column()),
+			   isInclude ? FilterPredicate::Equal : FilterPredicate::NotEqual,
+			   index.data(Qt::EditRole));
+	model->setFilter(filter);
+	model->select();
+}
 
-	QString filter = model->filter();
+void EditTableWidget::addIncludeFilter()
+{
+	addFilter(true);
+}
 
-	if (!filter.isEmpty())
-		filter += " AND ";
+void EditTableWidget::addExcludeFilter()
+{
+	addFilter(false);
+}
 
-	if (view->currentIndex().data(Qt::EditRole).isNull()) {
-		model->setFilter(filter + column + " IS NOT NULL");
-	} else {
-		model->setFilter(filter + column + " IS DISTINCT FROM " + data);
+void EditTableWidget::importData()
+{
+	ImportDialog d(connectionName, model->tableName(), this);
+	if (d.exec()) {
+		model->select();
 	}
-	model->select();
 }
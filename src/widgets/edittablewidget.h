@@ -26,8 +26,10 @@
 #define EDITTABLEWIDGET_H
 
 class QTableView;
-class QSqlTableModel;
+class QSqlError;
+class TableModel;
 class QToolBar;
+class QStatusBar;
 class QAction;
 
 #include <QtCore/QModelIndex>
@@ -39,14 +41,17 @@ class EditTableWidget : public QWidget
 	Q_OBJECT
 
 private:
-	QSqlTableModel *model;
+	QString connectionName;
+	TableModel *model;
 	QTableView *view;
 	QToolBar *toolBar;
+	QStatusBar *statusBar;
 
 	QAction *actionSave;
 	QAction *actionRevert;
 	QAction *actionAddIncludeFilter;
 	QAction *actionAddExcludeFilter;
+	QAction *actionImport;
 
 public:
 	EditTableWidget(const QString &connectionName, const QString &tableName, QWidget *parent = 0);
@@ -54,14 +59,18 @@ public:
 
 private:
 	void retranslateStrings();
-	QString dataForFilter(const QModelIndex &index);
+	void addFilter(bool isInclude);
 
 protected:
 	bool event(QEvent *ev);
 
 private Q_SLOTS:
+	void showError(const QSqlError &error);
+	void showSubmitted(int statements, int rows, qint64 elapsed);
+	void updateMode();
 	void addIncludeFilter();
 	void addExcludeFilter();
+	void importData();
 };
 
 #endif //EDITTABLEWIDGET_H
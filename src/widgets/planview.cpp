@@ -0,0 +1,119 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#include <QtGui/QHeaderView>
+
+#include "planview.h"
+
+// Share of the execution time spent in the node itself
+static const double hotShare = 0.5;
+static const double warmShare = 0.2;
+static const double noticeableShare = 0.1;
+
+// Actual rows this many times off the estimate
+static const double misestimateFactor = 10;
+
+PlanView::PlanView(QWidget *parent)
+	: QTreeWidget(parent)
+{
+	setColumnCount(ColumnCount);
+	setHeaderLabels(QStringList() << tr("Node") << tr("Self, ms") << tr("Self, %") << tr("Total, ms")
+					<< tr("Actual rows") << tr("Estimated rows") << tr("Misestimate") << tr("Loops")
+					<< tr("Shared hit") << tr("Shared read"));
+}
+
+PlanView::~PlanView()
+{
+}
+
+void PlanView::setPlan(const ExplainPlan &plan)
+{
+	clear();
+
+	const PlanNode &root = plan.root();
+	addNode(root, invisibleRootItem(), qMax(root.totalTime(), plan.executionTime()));
+
+	expandAll();
+	for (int i = 0; i < ColumnCount; i++) {
+		resizeColumnToContents(i);
+	}
+}
+
+void PlanView::addNode(const PlanNode &node, QTreeWidgetItem *parent, double totalTime)
+{
+	QTreeWidgetItem *item = new QTreeWidgetItem(parent);
+	item->setText(NodeColumn, node.title());
+	item->setToolTip(NodeColumn, (QStringList() << tr("Cost %1..%2").arg(node.startupCost).arg(node.totalCost) << node.details).join("\n"));
+
+	for (int i = SelfTimeColumn; i < ColumnCount; i++) {
+		item->setTextAlignment(i, Qt::AlignRight | Qt::AlignVCenter);
+	}
+
+	if (!node.isExecuted()) {
+		item->setText(SelfTimeColumn, tr("never executed"));
+		item->setText(PlanRowsColumn, QString::number(node.planRows, 'f', 0));
+		for (int i = 0; i < ColumnCount; i++) {
+			item->setForeground(i, Qt::gray);
+		}
+	} else {
+		const double share = totalTime > 0 ? node.selfTime / totalTime : 0;
+
+		item->setText(SelfTimeColumn, QString::number(node.selfTime, 'f', 3));
+		item->setText(SelfShareColumn, QString::number(share * 100, 'f', 1));
+		item->setText(TotalTimeColumn, QString::number(node.totalTime(), 'f', 3));
+		item->setText(ActualRowsColumn, QString::number(node.actualRows, 'f', 0));
+		item->setText(PlanRowsColumn, QString::number(node.planRows, 'f', 0));
+		item->setText(LoopsColumn, QString::number(node.loops, 'f', 0));
+		item->setText(SharedHitColumn, QString::number(node.sharedHit));
+		item->setText(SharedReadColumn, QString::number(node.sharedRead));
+
+		if (share >= noticeableShare) {
+			const QColor color = share >= hotShare ? QColor(255, 150, 150)
+								 : share >= warmShare ? QColor(255, 200, 140) : QColor(255, 240, 160);
+			for (int i = 0; i < ColumnCount; i++) {
+				item->setBackground(i, color);
+			}
+		}
+
+		// Rows are per loop on both sides, a zero is taken as one row
+		const double actual = qMax(node.actualRows, 1.0);
+		const double estimated = qMax(node.planRows, 1.0);
+		const double factor = qMax(actual, estimated) / qMin(actual, estimated);
+
+		if (factor >= 2) {
+			item->setText(MisestimateColumn, (actual > estimated ? tr("%1x under") : tr("%1x over")).arg(factor, 0, 'f', 0));
+		}
+
+		if (factor >= misestimateFactor) {
+			item->setForeground(ActualRowsColumn, Qt::red);
+			item->setForeground(PlanRowsColumn, Qt::red);
+			item->setForeground(MisestimateColumn, Qt::red);
+		}
+	}
+
+	foreach(const PlanNode & child, node.children) {
+		addNode(child, item, totalTime);
+	}
+}
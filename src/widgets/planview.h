@@ -0,0 +1,67 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#ifndef PLANVIEW_H
+#define PLANVIEW_H
+
+#include <QtGui/QTreeWidget>
+
+#include "explainplan.h"
+
+/*!
+ * Tree of an executed plan. Nodes that take a large share of the
+ * execution time and row estimates that are far off are highlighted.
+ */
+class PlanView : public QTreeWidget
+{
+	Q_OBJECT
+
+public:
+	explicit PlanView(QWidget *parent = 0);
+	virtual ~PlanView();
+
+	void setPlan(const ExplainPlan &plan);
+
+private:
+	Q_DISABLE_COPY(PlanView)
+
+	void addNode(const PlanNode &node, QTreeWidgetItem *parent, double totalTime);
+
+	enum Column {
+		NodeColumn = 0,
+		SelfTimeColumn,
+		SelfShareColumn,
+		TotalTimeColumn,
+		ActualRowsColumn,
+		PlanRowsColumn,
+		MisestimateColumn,
+		LoopsColumn,
+		SharedHitColumn,
+		SharedReadColumn,
+		ColumnCount
+	};
+};
+
+#endif //PLANVIEW_H
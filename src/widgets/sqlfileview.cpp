@@ -0,0 +1,148 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#include <QtGui/QPlainTextEdit>
+#include <QtGui/QScrollBar>
+#include <QtGui/QLabel>
+#include <QtGui/QLayout>
+
+#include "sqlfileview.h"
+#include "sqlhighlighter.h"
+
+static const qint64 blockSize = 4096;
+static const qint64 windowSize = 256 * 1024;
+static const qint64 maxLineSearch = 64 * 1024;
+
+SqlFileView::SqlFileView(QWidget *parent)
+	: QWidget(parent)
+	, data_(0)
+	, size_(0)
+{
+	view_ = new QPlainTextEdit(this);
+	view_->setReadOnly(true);
+	view_->setLineWrapMode(QPlainTextEdit::NoWrap);
+
+	SQLHighlighter *sqlhighlighter = new SQLHighlighter(view_->document());
+	Q_UNUSED(sqlhighlighter)
+
+	scrollBar_ = new QScrollBar(Qt::Vertical, this);
+	scrollBar_->setRange(0, 0);
+	connect(scrollBar_, SIGNAL(valueChanged(int)), this, SLOT(showWindow(int)));
+
+	positionLabel_ = new QLabel(this);
+
+	QHBoxLayout *viewLayout = new QHBoxLayout();
+	viewLayout->setContentsMargins(0, 0, 0, 0);
+	viewLayout->addWidget(view_);
+	viewLayout->addWidget(scrollBar_);
+
+	QVBoxLayout *mainLayout = new QVBoxLayout();
+	mainLayout->setContentsMargins(0, 0, 0, 0);
+	mainLayout->addLayout(viewLayout);
+	mainLayout->addWidget(positionLabel_);
+	setLayout(mainLayout);
+}
+
+SqlFileView::~SqlFileView()
+{
+
+}
+
+bool SqlFileView::open(const QString &fileName)
+{
+	file_.setFileName(fileName);
+	if (!file_.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+
+	size_ = file_.size();
+	data_ = size_ > 0 ? reinterpret_cast<const char *>(file_.map(0, size_)) : 0;
+	if (size_ > 0 && !data_) {
+		file_.close();
+		size_ = 0;
+		return false;
+	}
+
+	scrollBar_->setRange(0, int(qMax(size_ - 1, qint64(0)) / blockSize));
+	scrollBar_->setPageStep(int(windowSize / blockSize));
+	showWindow(0);
+	return true;
+}
+
+QString SqlFileView::fileName() const
+{
+	return file_.fileName();
+}
+
+QString SqlFileView::errorString() const
+{
+	return file_.errorString();
+}
+
+qint64 SqlFileView::size() const
+{
+	return size_;
+}
+
+void SqlFileView::showWindow(int block)
+{
+	const qint64 start = lineStart(qMin(block * blockSize, size_));
+	const qint64 end = lineEnd(qMin(start + windowSize, size_));
+
+	view_->setPlainText(QString::fromUtf8(data_ + start, int(end - start)));
+	positionLabel_->setText(tr("%1 - %2 of %3 KB")
+							.arg(start / 1024)
+							.arg(end / 1024)
+							.arg(size_ / 1024));
+}
+
+qint64 SqlFileView::lineStart(qint64 pos) const
+{
+	for (qint64 i = pos; i > 0 && pos - i < maxLineSearch; i--) {
+		if (data_ [i - 1] == '\n') {
+			return i;
+		}
+	}
+
+	// No line break nearby, at least do not cut a UTF-8 sequence
+	while (pos > 0 && pos < size_ && (uchar(data_ [pos]) & 0xC0) == 0x80) {
+		--pos;
+	}
+	return pos;
+}
+
+qint64 SqlFileView::lineEnd(qint64 pos) const
+{
+	for (qint64 i = pos; i < size_ && i - pos < maxLineSearch; i++) {
+		if (data_ [i] == '\n') {
+			return i;
+		}
+	}
+
+	while (pos > 0 && pos < size_ && (uchar(data_ [pos]) & 0xC0) == 0x80) {
+		--pos;
+	}
+	return pos;
+}
@@ -0,0 +1,74 @@
+/********************************************************************
+* Copyright (C) PanteR
+*-------------------------------------------------------------------
+*
+* QPgAdmin is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as
+* published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* QPgAdmin is distributed in the hope that it will be
+* useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Panther Commander; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301 USA
+*-------------------------------------------------------------------
+* Project:      QPgAdmin
+* Author:       PanteR
+* Contact:      panter.dsd@gmail.com
+*******************************************************************/
+
+
+#ifndef SQLFILEVIEW_H
+#define SQLFILEVIEW_H
+
+class QPlainTextEdit;
+class QScrollBar;
+class QLabel;
+
+#include <QtCore/QFile>
+
+#include <QtGui/QWidget>
+
+/*!
+ * Read-only view of a memory mapped SQL file. Only a window of the file
+ * around the scroll position is decoded, so files larger than the memory
+ * can be browsed.
+ */
+class SqlFileView : public QWidget
+{
+	Q_OBJECT
+
+public:
+	explicit SqlFileView(QWidget *parent = 0);
+	virtual ~SqlFileView();
+
+	bool open(const QString &fileName);
+	QString fileName() const;
+	QString errorString() const;
+	qint64 size() const;
+
+private Q_SLOTS:
+	void showWindow(int block);
+
+private:
+	Q_DISABLE_COPY(SqlFileView)
+
+	qint64 lineStart(qint64 pos) const;
+	qint64 lineEnd(qint64 pos) const;
+
+private:
+	QFile file_;
+	const char *data_;
+	qint64 size_;
+
+	QPlainTextEdit *view_;
+	QScrollBar *scrollBar_;
+	QLabel *positionLabel_;
+};
+
+#endif //SQLFILEVIEW_H
@@ -2,10 +2,14 @@
 #include <QtCore/QFile>
 #include <QtCore/QTextStream>
 #include <QtCore/QDir>
+#include <QtCore/QRegExp>
+#include <QtCore/QTimer>
 
 #include <QtGui/QTabWidget>
 #include <QtGui/QPlainTextEdit>
 #include <QtGui/QTableView>
+#include <QtGui/QTreeWidget>
+#include <QtGui/QHeaderView>
 #include <QtGui/QToolBar>
 #include <QtGui/QAction>
 #include <QtGui/QVBoxLayout>
@@ -13,18 +17,33 @@
 #include <QtGui/QFileDialog>
 #include <QtGui/QMessageBox>
 #include <QtGui/QComboBox>
+#include <QtGui/QSpinBox>
 #include <QtGui/QStatusBar>
+#include <QtGui/QProgressBar>
+#include <QtGui/QLineEdit>
 
 #include <QtSql/QSqlDatabase>
-#include <QtSql/QSqlQueryModel>
 #include <QtSql/QSqlError>
 
 #include "sqlquerywidget.h"
-#include "querythread.h"
+#include "queryexecutor.h"
+#include "queryresultmodel.h"
 #include "sqlhighlighter.h"
+#include "sqlsplitter.h"
+#include "fanoutrunner.h"
+#include "connectionpool.h"
+#include "sqlfileview.h"
+#include "timinglog.h"
+#include "queryhistory.h"
+#include "explainplan.h"
+#include "planview.h"
+#include "sqlcompleter.h"
+
+static const int maxHistoryItems = 500;
 
 SqlQueryWidget::SqlQueryWidget(const QString &connectionName, QWidget *parent)
-	: QWidget(parent), connectionName_(connectionName)
+	: QWidget(parent), connectionName_(connectionName), isRunning_(false), fetchSize_(1000), largeFileSize_(0), executor_(0), jobId_(0)
+	, isScript_(false), isFile_(false), isExport_(false), isExplain_(false), exportedBytes_(0), fileSize_(0), executedStatements_(0), failedStatements_(0), failedTargets_(0), slowestTarget_(0)
 {
 	inputTabs_ = new QTabWidget(this);
 	inputTabs_->setContextMenuPolicy(Qt::ActionsContextMenu);
@@ -34,7 +53,8 @@ SqlQueryWidget::SqlQueryWidget(const QString &connectionName, QWidget *parent)
 
 	outputTabs_ = new QTabWidget(this);
 
-	outputModel_ = new QSqlQueryModel(this);
+	outputModel_ = new QueryResultModel(this);
+	connect(outputModel_, SIGNAL(fetchRequested()), this, SLOT(fetchMore()));
 
 	outputTable_ = new QTableView(this);
 	outputTable_->setModel(outputModel_);
@@ -44,10 +64,56 @@ SqlQueryWidget::SqlQueryWidget(const QString &connectionName, QWidget *parent)
 	messagesEdit_->setReadOnly(true);
 	outputTabs_->addTab(messagesEdit_, "");
 
+	planView_ = new PlanView(this);
+	outputTabs_->addTab(planView_, "");
+
+	targetsView_ = new QTreeWidget(this);
+	targetsView_->setRootIsDecorated(false);
+	targetsView_->setColumnCount(5);
+	outputTabs_->addTab(targetsView_, "");
+
+	timingsView_ = new QTreeWidget(this);
+	timingsView_->setRootIsDecorated(false);
+	timingsView_->setColumnCount(11);
+	outputTabs_->addTab(timingsView_, "");
+
+	historyFilterEdit_ = new QLineEdit(this);
+	connect(historyFilterEdit_, SIGNAL(textChanged(QString)), this, SLOT(updateHistoryView()));
+
+	historyView_ = new QTreeWidget(this);
+	historyView_->setRootIsDecorated(false);
+	historyView_->setColumnCount(8);
+	connect(historyView_, SIGNAL(itemActivated(QTreeWidgetItem *, int)), this, SLOT(historyItemActivated(QTreeWidgetItem *)));
+
+	historyWidget_ = new QWidget(this);
+	QVBoxLayout *historyLayout = new QVBoxLayout(historyWidget_);
+	historyLayout->setContentsMargins(0, 0, 0, 0);
+	historyLayout->addWidget(historyFilterEdit_);
+	historyLayout->addWidget(historyView_);
+	outputTabs_->addTab(historyWidget_, "");
+	connect(outputTabs_, SIGNAL(currentChanged(int)), this, SLOT(updateHistoryView()));
+
+	runner_ = new FanOutRunner(this);
+	connect(runner_, SIGNAL(targetStarted(QString)), this, SLOT(targetStarted(QString)));
+	connect(runner_, SIGNAL(columnsReady(ResultColumns)), this, SLOT(targetColumnsReady(ResultColumns)));
+	connect(runner_, SIGNAL(chunkFetched(ResultChunk)), this, SLOT(targetChunkFetched(ResultChunk)));
+	connect(runner_, SIGNAL(targetFinished(QString, QueryResult, int, qint64)), this, SLOT(targetFinished(QString, QueryResult, int, qint64)));
+	connect(runner_, SIGNAL(finished()), this, SLOT(fanOutFinished()));
+
+	messagesTimer_ = new QTimer(this);
+	messagesTimer_->setSingleShot(true);
+	messagesTimer_->setInterval(100);
+	connect(messagesTimer_, SIGNAL(timeout()), this, SLOT(flushMessages()));
+
 	toolBar_ = new QToolBar(this);
 
 	statusBar_ = new QStatusBar(this);
 
+	progressBar_ = new QProgressBar(this);
+	progressBar_->setRange(0, 1000);
+	progressBar_->hide();
+	statusBar_->addPermanentWidget(progressBar_);
+
 	splitter_ = new QSplitter(Qt::Vertical, this);
 	splitter_->setObjectName("SPLITTER");
 	splitter_->addWidget(inputTabs_);
@@ -61,9 +127,16 @@ SqlQueryWidget::SqlQueryWidget(const QString &connectionName, QWidget *parent)
 	setLayout(mainLayout);
 
 	connectionEdit_ = new QComboBox(this);
-	connectionEdit_->addItems(QSqlDatabase::connectionNames());
+	connectionEdit_->addItems(QueryExecutor::connectionNames());
 	connectionEdit_->setCurrentIndex(connectionEdit_->findText(connectionName, Qt::MatchFixedString));
 
+	timeoutEdit_ = new QSpinBox(this);
+	timeoutEdit_->setRange(0, 24 * 60 * 60);
+
+	parallelismEdit_ = new QSpinBox(this);
+	parallelismEdit_->setRange(1, 64);
+	parallelismEdit_->setEnabled(false);
+
 	actionAddSqlEditor_ = new QAction(this);
 	actionAddSqlEditor_->setIcon(QIcon(":/share/images/add.png"));
 	connect(actionAddSqlEditor_, SIGNAL(triggered()), this, SLOT(addSqlEditor()));
@@ -108,13 +181,38 @@ SqlQueryWidget::SqlQueryWidget(const QString &connectionName, QWidget *parent)
 	connect(actionStart_, SIGNAL(triggered()), this, SLOT(start()));
 	toolBar_->addAction(actionStart_);
 
+	actionExplain_ = new QAction(this);
+	actionExplain_->setIcon(QIcon(":/share/images/preview.png"));
+	actionExplain_->setShortcut(Qt::Key_F7);
+	connect(actionExplain_, SIGNAL(triggered()), this, SLOT(explain()));
+	toolBar_->addAction(actionExplain_);
+
 	actionStop_ = new QAction(this);
 	actionStop_->setIcon(QIcon(":/share/images/stop.png"));
 	actionStop_->setEnabled(false);
+	connect(actionStop_, SIGNAL(triggered()), this, SLOT(cancel()));
 	toolBar_->addAction(actionStop_);
 
+	actionExport_ = new QAction(this);
+	actionExport_->setIcon(QIcon(":/share/images/save_as.png"));
+	connect(actionExport_, SIGNAL(triggered()), this, SLOT(exportToFile()));
+	toolBar_->addAction(actionExport_);
+
+	actionStopOnError_ = new QAction(this);
+	actionStopOnError_->setCheckable(true);
+	actionStopOnError_->setChecked(true);
+	toolBar_->addAction(actionStopOnError_);
+
+	actionFanOut_ = new QAction(this);
+	actionFanOut_->setCheckable(true);
+	actionFanOut_->setEnabled(false);
+	connect(actionFanOut_, SIGNAL(toggled(bool)), parallelismEdit_, SLOT(setEnabled(bool)));
+	toolBar_->addAction(actionFanOut_);
+
 	toolBar_->addSeparator();
 	toolBar_->addWidget(connectionEdit_);
+	toolBar_->addWidget(timeoutEdit_);
+	toolBar_->addWidget(parallelismEdit_);
 
 	loadSettings();
 	retranslateStrings();
@@ -123,7 +221,33 @@ SqlQueryWidget::SqlQueryWidget(const QString &connectionName, QWidget *parent)
 
 SqlQueryWidget::~SqlQueryWidget()
 {
+	stopQuery();
 	saveSettings();
+
+	if (executor_) {
+		ConnectionPool::release(executor_);
+	}
+}
+
+QStringList SqlQueryWidget::targets() const
+{
+	return targets_;
+}
+
+void SqlQueryWidget::setTargets(const QStringList &connectionNames)
+{
+	targets_ = connectionNames;
+	targetItems_.clear();
+	targetsView_->clear();
+
+	foreach(const QString & target, targets_) {
+		QTreeWidgetItem *item = new QTreeWidgetItem(targetsView_);
+		item->setText(0, target);
+		targetItems_.insert(target, item);
+	}
+
+	actionFanOut_->setEnabled(!targets_.isEmpty());
+	actionFanOut_->setChecked(!targets_.isEmpty());
 }
 
 void SqlQueryWidget::retranslateStrings()
@@ -132,6 +256,17 @@ void SqlQueryWidget::retranslateStrings()
 	updateTabCaptions();
 	outputTabs_->setTabText(outputTabs_->indexOf(outputTable_), tr("Output table"));
 	outputTabs_->setTabText(outputTabs_->indexOf(messagesEdit_), tr("Messages"));
+	outputTabs_->setTabText(outputTabs_->indexOf(targetsView_), tr("Targets"));
+	outputTabs_->setTabText(outputTabs_->indexOf(planView_), tr("Plan"));
+	targetsView_->setHeaderLabels(QStringList() << tr("Target") << tr("Status") << tr("Rows") << tr("Time, ms") << tr("Error"));
+	outputTabs_->setTabText(outputTabs_->indexOf(timingsView_), tr("Timings"));
+	timingsView_->setHeaderLabels(QStringList() << tr("Query") << tr("Connection") << tr("Total, ms")
+								  << tr("Queue") << tr("Checkout") << tr("Connect") << tr("Execution")
+								  << tr("First row") << tr("All rows") << tr("Idle") << tr("Model"));
+	outputTabs_->setTabText(outputTabs_->indexOf(historyWidget_), tr("History"));
+	historyFilterEdit_->setPlaceholderText(tr("Search history"));
+	historyView_->setHeaderLabels(QStringList() << tr("Query") << tr("Runs") << tr("Failed")
+								  << tr("Min, ms") << tr("Median, ms") << tr("95%, ms") << tr("Recent, ms") << tr("Last run"));
 
 	actionAddSqlEditor_->setText(tr("Add SQL editor"));
 	actionOpen_->setText(tr("Open"));
@@ -140,7 +275,20 @@ void SqlQueryWidget::retranslateStrings()
 	actionUndo_->setText(tr("Undo"));
 	actionRedo_->setText(tr("Redo"));
 	actionStart_->setText(tr("Start"));
+	actionExplain_->setText(tr("Explain/Analyze"));
+	actionExplain_->setToolTip(tr("Execute the statement under the cursor with EXPLAIN ANALYZE and show its plan"));
 	actionStop_->setText(tr("Stop"));
+	actionStopOnError_->setText(tr("Stop on error"));
+	actionExport_->setText(tr("Export to file"));
+	actionExport_->setToolTip(tr("Stream the query result to a file with COPY"));
+	actionStopOnError_->setToolTip(tr("Stop the script at the first failed statement"));
+	actionFanOut_->setText(tr("Run on targets"));
+	actionFanOut_->setToolTip(tr("Run the query on all targets selected in the database tree"));
+	parallelismEdit_->setPrefix(tr("Parallel: "));
+	parallelismEdit_->setToolTip(tr("Number of targets queried at the same time"));
+	timeoutEdit_->setSpecialValueText(tr("No timeout"));
+	timeoutEdit_->setSuffix(tr(" s"));
+	timeoutEdit_->setToolTip(tr("Statement timeout"));
 }
 
 void SqlQueryWidget::loadSettings()
@@ -149,6 +297,12 @@ void SqlQueryWidget::loadSettings()
 
 	settings.beginGroup("SqlQueryWidget");
 	splitter_->restoreState(settings.value("State", "").toByteArray());
+	fetchSize_ = settings.value("FetchSize", 1000).toInt();
+	largeFileSize_ = settings.value("LargeFileSize", 64).toLongLong() * 1024 * 1024;
+	timeoutEdit_->setValue(settings.value("StatementTimeout", 0).toInt());
+	actionStopOnError_->setChecked(settings.value("StopOnError", true).toBool());
+	parallelismEdit_->setValue(settings.value("Parallelism", 8).toInt());
+	outputModel_->setMemoryLimit(settings.value("MemoryLimit", 512).toLongLong() * 1024 * 1024);
 	settings.endGroup();
 }
 
@@ -158,6 +312,12 @@ void SqlQueryWidget::saveSettings()
 
 	settings.beginGroup("SqlQueryWidget");
 	settings.setValue("State", splitter_->saveState());
+	settings.setValue("FetchSize", fetchSize_);
+	settings.setValue("LargeFileSize", largeFileSize_ / (1024 * 1024));
+	settings.setValue("StatementTimeout", timeoutEdit_->value());
+	settings.setValue("StopOnError", actionStopOnError_->isChecked());
+	settings.setValue("Parallelism", parallelismEdit_->value());
+	settings.setValue("MemoryLimit", outputModel_->memoryLimit() / (1024 * 1024));
 	settings.endGroup();
 
 	settings.sync();
@@ -176,11 +336,6 @@ bool SqlQueryWidget::event(QEvent *ev)
 			}
 		}
 	}
-	if (ev->type() == QEvent::Timer) {
-		const auto elapsed = time_.elapsed();
-		statusBar_->showMessage(tr("%1 secs (%2 msecs)").arg(elapsed / 1000).arg(elapsed));
-	}
-
 	return QWidget::event(ev);
 }
 
@@ -193,11 +348,30 @@ QPlainTextEdit *SqlQueryWidget::addSqlEditor()
 	SQLHighlighter *sqlhighlighter = new SQLHighlighter(e->document());
 	Q_UNUSED(sqlhighlighter)
 
+	SqlCompleter *completer = new SqlCompleter(e);
+	completer->setConnectionName(connectionEdit_->currentText());
+	connect(connectionEdit_, SIGNAL(currentIndexChanged(QString)), completer, SLOT(setConnectionName(QString)));
+
 	const int index = inputTabs_->addTab(e, tr("Unnamed"));
 	inputTabs_->setCurrentIndex(index);
 	return e;
 }
 
+SqlFileView *SqlQueryWidget::addFileView(const QString &fileName)
+{
+	SqlFileView *view = new SqlFileView(this);
+	if (!view->open(fileName)) {
+		QMessageBox::critical(this, "", tr("Error open file") + "\n" + view->errorString());
+		delete view;
+		return 0;
+	}
+
+	view->setObjectName(QFileInfo(fileName).absoluteFilePath());
+	const int index = inputTabs_->addTab(view, QFileInfo(fileName).fileName());
+	inputTabs_->setCurrentIndex(index);
+	return view;
+}
+
 void SqlQueryWidget::open()
 {
 	QSettings settings;
@@ -214,6 +388,12 @@ void SqlQueryWidget::open()
 	settings.sync();
 
 	foreach(const QString & fileName, fileNames) {
+		// Big dumps are mapped and shown through a window instead of loaded
+		if (largeFileSize_ > 0 && QFileInfo(fileName).size() >= largeFileSize_) {
+			addFileView(fileName);
+			continue;
+		}
+
 		QFile file(fileName);
 		if (!file.open(QIODevice::ReadOnly)) {
 			QMessageBox::critical(this, "", tr("Error open file"));
@@ -281,6 +461,12 @@ bool SqlQueryWidget::saveAs()
 void SqlQueryWidget::updateTabCaptions()
 {
 	for (int i = 0, count = inputTabs_->count(); i < count; i++) {
+		if (SqlFileView *view = qobject_cast<SqlFileView *> (inputTabs_->widget(i))) {
+			inputTabs_->setTabText(i, QFileInfo(view->fileName()).fileName());
+			inputTabs_->setTabToolTip(i, QDir::toNativeSeparators(view->fileName()));
+			continue;
+		}
+
 		QPlainTextEdit *e = qobject_cast<QPlainTextEdit *> (inputTabs_->widget(i));
 		if (!e)
 			return;
@@ -304,7 +490,127 @@ void SqlQueryWidget::updateTabCaptions()
 
 void SqlQueryWidget::start()
 {
-	outputModel_->setQuery(QSqlQuery());
+	stopQuery();
+	outputModel_->clear();
+	messagesEdit_->clear();
+	if (connectionEdit_->currentIndex() < 0) {
+		QMessageBox::critical(this, "", tr("Choose connection"));
+		return;
+	}
+
+	if (SqlFileView *view = qobject_cast<SqlFileView *> (inputTabs_->currentWidget())) {
+		startFile(view);
+		return;
+	}
+
+	QPlainTextEdit *e = qobject_cast<QPlainTextEdit *> (inputTabs_->currentWidget());
+	if (!e)
+		return;
+
+	const QString &text = e->toPlainText();
+	const QList<SqlStatement> &statements = SqlSplitter::split(text);
+	if (statements.isEmpty()) {
+		messagesEdit_->appendPlainText(tr("Nothing to execute"));
+		outputTabs_->setCurrentWidget(messagesEdit_);
+		return;
+	}
+
+	actionStart_->setEnabled(false);
+	actionExplain_->setEnabled(false);
+	actionStop_->setEnabled(true);
+
+	if (actionFanOut_->isChecked() && !targets_.isEmpty()) {
+		startFanOut(text, SqlSplitter::statements(text));
+		return;
+	}
+
+	QueryJob job;
+	statementLines_.clear();
+	foreach(const SqlStatement & statement, statements) {
+		job.statements << text.mid(statement.offset, statement.length);
+		statementLines_ << statement.line;
+	}
+
+	isScript_ = statements.size() > 1;
+	isFile_ = false;
+	isExport_ = false;
+	isExplain_ = false;
+	if (isScript_) {
+		job.type = QueryJob::Script;
+		job.stopOnError = actionStopOnError_->isChecked();
+	} else {
+		job.type = QueryJob::Cursor;
+		job.query = job.statements.takeFirst();
+	}
+	executedStatements_ = 0;
+	failedStatements_ = 0;
+	pendingMessages_.clear();
+
+	job.fetchSize = fetchSize_;
+	job.statementTimeout = timeoutEdit_->value() * 1000;
+	token_ = job.token;
+	submit(job);
+}
+
+void SqlQueryWidget::explain()
+{
+	if (connectionEdit_->currentIndex() < 0) {
+		QMessageBox::critical(this, "", tr("Choose connection"));
+		return;
+	}
+
+	QPlainTextEdit *e = qobject_cast<QPlainTextEdit *> (inputTabs_->currentWidget());
+	if (!e)
+		return;
+
+	const QString &text = e->toPlainText();
+	const QList<SqlStatement> &statements = SqlSplitter::split(text);
+	if (statements.isEmpty()) {
+		messagesEdit_->clear();
+		messagesEdit_->appendPlainText(tr("Nothing to execute"));
+		outputTabs_->setCurrentWidget(messagesEdit_);
+		return;
+	}
+
+	// Only the statement under the cursor
+	const int position = e->textCursor().position();
+	SqlStatement statement = statements.last();
+	foreach(const SqlStatement & s, statements) {
+		if (position <= s.offset + s.length) {
+			statement = s;
+			break;
+		}
+	}
+	const QString &query = text.mid(statement.offset, statement.length);
+
+	stopQuery();
+	messagesEdit_->clear();
+	planView_->clear();
+
+	actionStart_->setEnabled(false);
+	actionExplain_->setEnabled(false);
+	actionStop_->setEnabled(true);
+
+	QueryJob job(ExplainPlan::query(query));
+	statementLines_.clear();
+	statementLines_ << statement.line;
+
+	isScript_ = false;
+	isFile_ = false;
+	isExport_ = false;
+	isExplain_ = true;
+
+	// EXPLAIN ANALYZE executes the statement, its changes are rolled back
+	job.rollback = true;
+	job.statementTimeout = timeoutEdit_->value() * 1000;
+	token_ = job.token;
+	submit(job);
+}
+
+void SqlQueryWidget::exportToFile()
+{
+	stopQuery();
+	messagesEdit_->clear();
 	if (connectionEdit_->currentIndex() < 0) {
 		QMessageBox::critical(this, "", tr("Choose connection"));
 		return;
@@ -314,64 +620,637 @@ void SqlQueryWidget::start()
 	if (!e)
 		return;
 
+	const QStringList &statements = SqlSplitter::statements(e->toPlainText());
+	if (statements.size() != 1 || !QueryExecutor::isCursorQuery(statements.first())) {
+		QMessageBox::critical(this, "", tr("Only a single query can be exported"));
+		return;
+	}
+
+	QSettings settings;
+	const QString csvFilter = tr("CSV files (*.csv)");
+	const QString textFilter = tr("Text files (*.txt)");
+	const QString binaryFilter = tr("Binary COPY files (*.copy)");
+	QString filter = csvFilter;
+
+	const QString &fileName = QFileDialog::getSaveFileName(this,
+							  tr("Export to file"),
+							  settings.value("SqlQueryWidget/ExportPath", "").toString(),
+							  (QStringList() << csvFilter << textFilter << binaryFilter << tr("All files (*.*)")).join(";;"),
+							  &filter);
+	if (fileName.isEmpty()) {
+		return;
+	}
+
+	settings.setValue("SqlQueryWidget/ExportPath", QFileInfo(fileName).absolutePath());
+
+	QString options = "FORMAT csv, HEADER";
+	if (filter == textFilter) {
+		options = "FORMAT text";
+	} else if (filter == binaryFilter) {
+		options = "FORMAT binary";
+	}
+
+	QueryJob job(QString("COPY (%1\n) TO STDOUT WITH (%2)").arg(statements.first()).arg(options), QueryJob::CopyOut);
+	job.fileName = fileName;
+	job.statementTimeout = timeoutEdit_->value() * 1000;
+
+	isScript_ = false;
+	isFile_ = false;
+	isExport_ = true;
+	isExplain_ = false;
+	exportFileName_ = fileName;
+	exportedBytes_ = 0;
+
+	actionStart_->setEnabled(false);
+	actionExplain_->setEnabled(false);
+	actionStop_->setEnabled(true);
+
+	token_ = job.token;
+	submit(job);
+	statusBar_->showMessage(tr("Exporting..."));
+}
+
+void SqlQueryWidget::startFile(SqlFileView *view)
+{
+	QueryJob job(QString(), QueryJob::File);
+	job.fileName = view->fileName();
+	job.stopOnError = actionStopOnError_->isChecked();
+	job.statementTimeout = timeoutEdit_->value() * 1000;
+
+	isScript_ = true;
+	isFile_ = true;
+	isExport_ = false;
+	isExplain_ = false;
+	fileSize_ = view->size();
+	statementLines_.clear();
+	executedStatements_ = 0;
+	failedStatements_ = 0;
+	pendingMessages_.clear();
+
+	progressBar_->setValue(0);
+	progressBar_->setFormat(tr("Starting..."));
+	progressBar_->show();
+
 	actionStart_->setEnabled(false);
+	actionExplain_->setEnabled(false);
 	actionStop_->setEnabled(true);
 
-	//Remove comments
-	QueryThread *thread = new QueryThread(connectionEdit_->currentText(), e->toPlainText(), this);
-	connect(thread, SIGNAL(finished()), this, SLOT(queryFinished()));
-	connect(actionStop_, SIGNAL(triggered()), thread, SLOT(terminate()));
-	thread->start();
-	timer_ = startTimer(10);
+	token_ = job.token;
+	submit(job);
+}
+
+void SqlQueryWidget::startFanOut(const QString &text, const QStringList &statements)
+{
+	QueryJob job(statements.size() == 1 ? statements.first() : text,
+				 statements.size() == 1 ? QueryJob::Cursor : QueryJob::Execute);
+	job.fetchSize = fetchSize_;
+	job.statementTimeout = timeoutEdit_->value() * 1000;
+	token_ = job.token;
+	isScript_ = false;
+	failedTargets_ = 0;
+	slowestTarget_ = 0;
+
+	foreach(QTreeWidgetItem * item, targetItems_) {
+		item->setText(1, tr("Queued"));
+		for (int column = 2; column < targetsView_->columnCount(); column++) {
+			item->setText(column, QString());
+		}
+	}
+
+	runner_->setParallelism(parallelismEdit_->value());
+	startRun();
+	runner_->start(targets_, job);
+}
+
+void SqlQueryWidget::submit(const QueryJob &job)
+{
+	startRun();
+
+	TimingRecord record;
+	record.connectionName = connectionEdit_->currentText();
+	record.query = !job.query.isEmpty() ? job.query : !job.fileName.isEmpty() ? job.fileName : job.statements.join(";\n");
+	record.type = job.type;
+	record.isFailed = false;
+	record.rowCount = 0;
+
+	QElapsedTimer timer;
+	timer.start();
+	QueryExecutor *queryExecutor = executor(record.connectionName);
+	record.timings.checkout = timer.nsecsElapsed() / 1000;
+
+	jobId_ = queryExecutor->submit(job);
+	timedJobs_.insert(jobId_, record);
+}
+
+void SqlQueryWidget::startRun()
+{
+	isRunning_ = true;
 	time_.start();
+	statusBar_->showMessage(tr("Executing..."));
+}
+
+QueryExecutor *SqlQueryWidget::executor(const QString &connectionName)
+{
+	if (executor_ && executor_->connectionName() != connectionName) {
+		disconnect(executor_, 0, this, 0);
+		ConnectionPool::release(executor_);
+		executor_ = 0;
+		timedJobs_.clear();
+	}
+
+	if (!executor_) {
+		executor_ = ConnectionPool::pool(connectionName)->checkOut();
+		connect(executor_, SIGNAL(columnsReady(int, ResultColumns)), this, SLOT(columnsReady(int, ResultColumns)));
+		connect(executor_, SIGNAL(chunkFetched(int, ResultChunk, bool)), this, SLOT(chunkFetched(int, ResultChunk, bool)));
+		connect(executor_, SIGNAL(jobFinished(int, QueryResult)), this, SLOT(jobFinished(int, QueryResult)));
+		connect(executor_, SIGNAL(statementFinished(int, StatementResult)), this, SLOT(statementFinished(int, StatementResult)));
+		connect(executor_, SIGNAL(fileProgress(int, qint64, qint64, int)), this, SLOT(fileProgress(int, qint64, qint64, int)));
+		connect(executor_, SIGNAL(copyProgress(int, qint64, qint64)), this, SLOT(copyProgress(int, qint64, qint64)));
+	}
+
+	return executor_;
+}
+
+void SqlQueryWidget::cancel()
+{
+	if (runner_->isRunning()) {
+		actionStop_->setEnabled(false);
+		messagesEdit_->appendPlainText(tr("Cancelling the query..."));
+		runner_->cancel();
+		return;
+	}
+
+	if (!jobId_)
+		return;
+
+	actionStop_->setEnabled(false);
+	messagesEdit_->appendPlainText(tr("Cancelling the query..."));
+	executor_->cancel(token_);
 }
 
-QStringList SqlQueryWidget::removeComments(const QStringList &sqlQueryes)
+void SqlQueryWidget::stopQuery()
 {
-	static const QRegExp commentRegexp("^\\s*(--)");
+	runner_->cancel();
+	progressBar_->hide();
 
-	QStringList result;
-	std::remove_copy_if(sqlQueryes.begin(), sqlQueryes.end(), std::back_inserter(result),
-	[](const QString & line) {
-		return commentRegexp.indexIn(line, 0) != -1;
+	if (!jobId_)
+		return;
+
+	if (isRunning_) {
+		executor_->cancel(token_);
+	} else {
+		executor_->closeCursor(jobId_);
 	}
-					   );
+	jobId_ = 0;
+}
 
-	return result;
+void SqlQueryWidget::fetchMore()
+{
+	if (jobId_) {
+		executor_->fetchMore(jobId_);
+	}
 }
 
-QStringList SqlQueryWidget::removeBlankLines(const QStringList &sqlQueryes)
+void SqlQueryWidget::columnsReady(int jobId, const ResultColumns &columns)
 {
-	QStringList result;
-	std::remove_copy_if(sqlQueryes.begin(), sqlQueryes.end(), std::back_inserter(result),
-	[](const QString & line) {
-		return line.isEmpty();
+	if (jobId == jobId_) {
+		outputModel_->setColumns(columns);
 	}
-					   );
+}
+
+void SqlQueryWidget::chunkFetched(int jobId, const ResultChunk &chunk, bool atEnd)
+{
+	if (jobId != jobId_)
+		return;
 
-	return result;
+	QElapsedTimer timer;
+	timer.start();
+	outputModel_->appendChunk(chunk, atEnd);
+
+	const QHash<int, TimingRecord>::iterator it = timedJobs_.find(jobId);
+	if (it != timedJobs_.end()) {
+		it.value().timings.population = qMax(it.value().timings.population, Q_INT64_C(0)) + timer.nsecsElapsed() / 1000;
+		it.value().rowCount += chunk.rowCount();
+	}
+
+	if (outputModel_->isTruncated()) {
+		executor_->closeCursor(jobId_);
+	}
+
+	if (!isScript_) {
+		queryExecuted(QSqlError());
+	}
 }
 
-void SqlQueryWidget::queryFinished()
+void SqlQueryWidget::jobFinished(int jobId, const QueryResult &result)
 {
-	killTimer(timer_);
+	// A cursor left open finishes after the next query has started
+	if (timedJobs_.contains(jobId)) {
+		addTimings(jobId, result);
+	}
+
+	if (jobId != jobId_)
+		return;
+
+	jobId_ = 0;
+
+	if (isExport_) {
+		exportFinished(result);
+		return;
+	} else if (isExplain_) {
+		explainFinished(result);
+		return;
+	} else if (isFile_) {
+		fileExecuted(result);
+	} else if (isScript_) {
+		scriptExecuted(result);
+	} else if (isRunning_) {
+		queryExecuted(result.error);
+	} else if (result.error.isValid()) {
+		messagesEdit_->appendPlainText(result.error.text() + errorLocation(result.error, statementLines_.value(0, 1)));
+		outputTabs_->setCurrentWidget(messagesEdit_);
+		return;
+	}
+
+	const qint64 cells = qint64(outputModel_->rowCount()) * outputModel_->columnCount();
+	if (cells > 0) {
+		messagesEdit_->appendPlainText(tr("%1 rows fetched, %2 KB (%3 bytes per cell)")
+									   .arg(outputModel_->rowCount())
+									   .arg(outputModel_->byteSize() / 1024)
+									   .arg(double(outputModel_->byteSize()) / cells, 0, 'f', 1));
+	}
+	if (outputModel_->isTruncated()) {
+		messagesEdit_->appendPlainText(tr("The result is truncated at %1 MB").arg(outputModel_->memoryLimit() / (1024 * 1024)));
+	}
+}
+
+void SqlQueryWidget::statementFinished(int jobId, const StatementResult &result)
+{
+	if (jobId != jobId_)
+		return;
+
+	++executedStatements_;
+
+	const int line = result.line > 0 ? result.line : statementLines_.value(result.index, 1);
+	QString message = tr("Statement %1 (line %2): ").arg(result.index + 1).arg(line);
+	if (result.error.isValid()) {
+		++failedStatements_;
+		message += result.error.text() + errorLocation(result.error, line);
+	} else if (result.rowCount >= 0) {
+		message += tr("%1 rows returned").arg(result.rowCount);
+	} else {
+		message += tr("%1 rows affected").arg(qMax(result.numRowsAffected, 0));
+	}
+	message += tr(", %1 ms").arg(result.elapsed / 1000.0, 0, 'f', 3);
+
+	pendingMessages_ << message;
+	if (!messagesTimer_->isActive()) {
+		messagesTimer_->start();
+	}
+}
+
+void SqlQueryWidget::fileProgress(int jobId, qint64 position, qint64 size, int statements)
+{
+	if (jobId != jobId_)
+		return;
+
+	executedStatements_ = statements;
+	progressBar_->setValue(size > 0 ? int(position * 1000 / size) : 1000);
+	progressBar_->setFormat(tr("%1 of %2 MB, %3 statements")
+							.arg(position / (1024 * 1024))
+							.arg(size / (1024 * 1024))
+							.arg(statements));
+}
+
+void SqlQueryWidget::copyProgress(int jobId, qint64 bytes, qint64 rows)
+{
+	if (jobId != jobId_)
+		return;
+
+	exportedBytes_ = bytes;
+
+	const double seconds = qMax(time_.elapsed(), Q_INT64_C(1)) / 1000.0;
+	statusBar_->showMessage(tr("%1 MB, %2 rows, %3 MB/s, %4 rows/s")
+							.arg(bytes / (1024.0 * 1024.0), 0, 'f', 1)
+							.arg(rows)
+							.arg(bytes / (1024.0 * 1024.0) / seconds, 0, 'f', 1)
+							.arg(qRound64(rows / seconds)));
+}
+
+void SqlQueryWidget::flushMessages()
+{
+	messagesTimer_->stop();
+
+	if (!pendingMessages_.isEmpty()) {
+		messagesEdit_->appendPlainText(pendingMessages_.join("\n"));
+		pendingMessages_.clear();
+	}
+}
+
+QString SqlQueryWidget::errorLocation(const QSqlError &error, int firstLine) const
+{
+	static const QRegExp lineRegexp("\\bLINE (\\d+):");
+
+	QRegExp regexp = lineRegexp;
+	if (regexp.indexIn(error.databaseText()) != -1) {
+		return tr(" (error at line %1)").arg(firstLine + regexp.cap(1).toInt() - 1);
+	}
+
+	return QString();
+}
+
+void SqlQueryWidget::targetStarted(const QString &target)
+{
+	if (QTreeWidgetItem *item = targetItems_.value(target)) {
+		item->setText(1, tr("Running"));
+	}
+}
+
+void SqlQueryWidget::targetColumnsReady(const ResultColumns &columns)
+{
+	outputModel_->setColumns(columns);
+}
+
+void SqlQueryWidget::targetChunkFetched(const ResultChunk &chunk)
+{
+	outputModel_->appendChunk(chunk, false);
+
+	if (outputModel_->byteSize() >= outputModel_->memoryLimit()) {
+		runner_->cancel();
+	}
+}
+
+void SqlQueryWidget::targetFinished(const QString &target, const QueryResult &result, int rowCount, qint64 elapsed)
+{
+	slowestTarget_ = qMax(slowestTarget_, elapsed);
+
+	QTreeWidgetItem *item = targetItems_.value(target);
+	if (!item)
+		return;
+
+	if (result.isCancelled) {
+		item->setText(1, tr("Cancelled"));
+	} else if (result.error.isValid()) {
+		item->setText(1, tr("Error"));
+		item->setText(4, result.error.text());
+		++failedTargets_;
+	} else {
+		item->setText(1, tr("Done"));
+	}
+	item->setText(2, QString::number(result.numRowsAffected > 0 && rowCount == 0 ? result.numRowsAffected : rowCount));
+	item->setText(3, QString::number(elapsed));
+}
+
+void SqlQueryWidget::fanOutFinished()
+{
+	outputModel_->appendChunk(ResultChunk(), true);
+	finishRun();
+
+	messagesEdit_->appendPlainText(tr("%1 targets, %2 failed, %3 ms total, slowest target %4 ms")
+								   .arg(targets_.size())
+								   .arg(failedTargets_)
+								   .arg(time_.elapsed())
+								   .arg(slowestTarget_));
+	if (outputModel_->byteSize() >= outputModel_->memoryLimit()) {
+		messagesEdit_->appendPlainText(tr("The result is truncated at %1 MB").arg(outputModel_->memoryLimit() / (1024 * 1024)));
+	}
+
+	if (failedTargets_ > 0) {
+		outputTabs_->setCurrentWidget(targetsView_);
+	} else if (outputModel_->rowCount() > 0) {
+		outputTabs_->setCurrentWidget(outputTable_);
+	} else {
+		outputTabs_->setCurrentWidget(messagesEdit_);
+	}
+}
+
+void SqlQueryWidget::finishRun()
+{
+	if (!isRunning_)
+		return;
+
+	isRunning_ = false;
 	actionStart_->setEnabled(true);
+	actionExplain_->setEnabled(true);
 	actionStop_->setEnabled(false);
 
-	QueryThread *thread = qobject_cast <QueryThread *> (sender());
-	if (!thread)
+	const qint64 elapsed = time_.elapsed();
+	statusBar_->showMessage(tr("%1 secs (%2 msecs)").arg(elapsed / 1000).arg(elapsed));
+}
+
+void SqlQueryWidget::addTimings(int jobId, const QueryResult &result)
+{
+	TimingRecord record = timedJobs_.take(jobId);
+	const QueryTimings timings = record.timings;
+
+	record.isFailed = result.error.isValid();
+	record.timings = result.timings;
+	record.timings.checkout = timings.checkout;
+	record.timings.population = timings.population;
+	record.timings.total += qMax(timings.checkout, Q_INT64_C(0));
+
+	TimingLog::add(record);
+	updateTimingsView();
+	addHistory(record, result);
+}
+
+void SqlQueryWidget::updateTimingsView()
+{
+	timingsView_->clear();
+
+	foreach(const TimingRecord & record, TimingLog::records()) {
+		const QueryTimings &timings = record.timings;
+		const QList<qint64> phases = QList<qint64>() << timings.total << timings.queueWait << timings.checkout
+									 << timings.connect << timings.execution << timings.firstRow
+									 << timings.fetch << timings.idle << timings.population;
+
+		QTreeWidgetItem *item = new QTreeWidgetItem(timingsView_);
+		item->setText(0, record.query.simplified().left(200));
+		item->setToolTip(0, record.query.left(4096));
+		item->setText(1, record.connectionName);
+		for (int i = 0, count = phases.size(); i < count; i++) {
+			item->setText(i + 2, phases.at(i) < 0 ? "-" : QString::number(phases.at(i) / 1000.0, 'f', 3));
+			item->setTextAlignment(i + 2, Qt::AlignRight | Qt::AlignVCenter);
+		}
+		if (record.isFailed) {
+			item->setForeground(0, Qt::red);
+		}
+	}
+}
+
+void SqlQueryWidget::addHistory(const TimingRecord &record, const QueryResult &result)
+{
+	// Only what was typed in the editors, not files, imports and exports
+	if (record.type != QueryJob::Execute && record.type != QueryJob::Cursor && record.type != QueryJob::Script) {
+		return;
+	}
+
+	if (result.isCancelled) {
+		return;
+	}
+
+	HistoryEntry entry;
+	entry.time = QDateTime::currentDateTime();
+	entry.connectionName = record.connectionName;
+	entry.query = record.query;
+	entry.duration = record.timings.execution >= 0 ? record.timings.execution : record.timings.total;
+	entry.rowCount = record.rowCount > 0 ? record.rowCount : qMax(result.numRowsAffected, 0);
+	if (result.error.isValid()) {
+		entry.error = result.error.text();
+	}
+
+	QueryHistory::instance()->add(entry);
+	updateHistoryView();
+}
+
+void SqlQueryWidget::updateHistoryView()
+{
+	// The log is loaded on first use, not with every editor
+	if (outputTabs_->currentWidget() != historyWidget_) {
+		return;
+	}
+
+	historyView_->clear();
+
+	QueryHistory *history = QueryHistory::instance();
+
+	foreach(int id, history->search(historyFilterEdit_->text(), maxHistoryItems)) {
+		const HistoryStats &stats = history->stats(id);
+		const QString &query = history->query(id);
+		const QList<qint64> durations = QList<qint64>() << stats.min << stats.median << stats.p95 << stats.recentMedian;
+
+		QTreeWidgetItem *item = new QTreeWidgetItem(historyView_);
+		item->setText(0, query.left(200));
+		item->setToolTip(0, query.left(4096));
+		item->setData(0, Qt::UserRole, id);
+		item->setText(1, QString::number(stats.runs));
+		item->setText(2, QString::number(stats.failed));
+		for (int i = 0, count = durations.size(); i < count; i++) {
+			item->setText(i + 3, durations.at(i) < 0 ? "-" : QString::number(durations.at(i) / 1000.0, 'f', 3));
+			item->setTextAlignment(i + 3, Qt::AlignRight | Qt::AlignVCenter);
+		}
+		item->setText(7, stats.lastRun.toString(Qt::SystemLocaleShortDate));
+
+		// The last runs are as slow as the slowest 5% of all of them
+		if (stats.recentMedian >= stats.p95 && stats.recentMedian > stats.median) {
+			item->setForeground(6, Qt::red);
+		}
+	}
+}
+
+void SqlQueryWidget::historyItemActivated(QTreeWidgetItem *item)
+{
+	const QList<HistoryEntry> &entries = QueryHistory::instance()->entries(item->data(0, Qt::UserRole).toInt(), 1);
+	if (entries.isEmpty()) {
+		return;
+	}
+
+	QPlainTextEdit *e = qobject_cast<QPlainTextEdit *> (inputTabs_->currentWidget());
+	if (!e) {
+		e = addSqlEditor();
+	}
+
+	e->insertPlainText(entries.first().query);
+	e->setFocus();
+}
+
+void SqlQueryWidget::scriptExecuted(const QueryResult &result)
+{
+	flushMessages();
+	finishRun();
+
+	messagesEdit_->appendPlainText(tr("%1 of %2 statements executed, %3 failed, %4 ms")
+								   .arg(executedStatements_)
+								   .arg(statementLines_.size())
+								   .arg(failedStatements_)
+								   .arg(time_.elapsed()));
+	if (result.isCancelled) {
+		messagesEdit_->appendPlainText(result.error.text());
+	}
+
+	if (failedStatements_ > 0 || result.isCancelled || outputModel_->rowCount() == 0) {
+		outputTabs_->setCurrentWidget(messagesEdit_);
+	} else {
+		outputTabs_->setCurrentWidget(outputTable_);
+	}
+}
+
+void SqlQueryWidget::fileExecuted(const QueryResult &result)
+{
+	flushMessages();
+	finishRun();
+	progressBar_->hide();
+
+	const qint64 elapsed = time_.elapsed();
+	messagesEdit_->appendPlainText(tr("%1 statements executed, %2 failed, %3 MB in %4 ms")
+								   .arg(executedStatements_)
+								   .arg(failedStatements_)
+								   .arg(fileSize_ / (1024 * 1024))
+								   .arg(elapsed));
+	if (result.isCancelled) {
+		messagesEdit_->appendPlainText(result.error.text());
+	}
+
+	outputTabs_->setCurrentWidget(messagesEdit_);
+}
+
+void SqlQueryWidget::exportFinished(const QueryResult &result)
+{
+	finishRun();
+	isExport_ = false;
+
+	if (result.error.isValid()) {
+		messagesEdit_->appendPlainText(result.error.text());
+	} else {
+		const double seconds = qMax(time_.elapsed(), Q_INT64_C(1)) / 1000.0;
+		messagesEdit_->appendPlainText(tr("%1 rows, %2 MB exported to %3 in %4 s (%5 MB/s, %6 rows/s)")
+									   .arg(result.numRowsAffected)
+									   .arg(exportedBytes_ / (1024.0 * 1024.0), 0, 'f', 1)
+									   .arg(QDir::toNativeSeparators(exportFileName_))
+									   .arg(seconds, 0, 'f', 1)
+									   .arg(exportedBytes_ / (1024.0 * 1024.0) / seconds, 0, 'f', 1)
+									   .arg(qRound64(result.numRowsAffected / seconds)));
+	}
+	outputTabs_->setCurrentWidget(messagesEdit_);
+}
+
+void SqlQueryWidget::explainFinished(const QueryResult &result)
+{
+	finishRun();
+	isExplain_ = false;
+
+	if (result.isCancelled) {
 		return;
+	}
 
-	const QSqlQuery &query = thread->lastQuery();
-	thread->deleteLater();
+	ExplainPlan plan;
+	if (result.error.isValid()) {
+		messagesEdit_->appendPlainText(result.error.text() + errorLocation(result.error, statementLines_.value(0, 1)));
+		outputTabs_->setCurrentWidget(messagesEdit_);
+	} else if (!plan.parse(result.rows.value(0, 0).toString())) {
+		messagesEdit_->appendPlainText(plan.errorString());
+		outputTabs_->setCurrentWidget(messagesEdit_);
+	} else {
+		planView_->setPlan(plan);
+		messagesEdit_->appendPlainText(tr("Planning %1 ms, execution %2 ms")
+									   .arg(plan.planningTime(), 0, 'f', 3)
+									   .arg(plan.executionTime(), 0, 'f', 3));
+		outputTabs_->setCurrentWidget(planView_);
+	}
+}
+
+void SqlQueryWidget::queryExecuted(const QSqlError &error)
+{
+	if (!isRunning_)
+		return;
 
-	outputModel_->setQuery(query);
+	finishRun();
 
-	if (query.lastError().isValid()) {
-		messagesEdit_->setPlainText(query.lastError().text());
+	if (error.isValid()) {
+		messagesEdit_->appendPlainText(error.text() + errorLocation(error, statementLines_.value(0, 1)));
 		outputTabs_->setCurrentWidget(messagesEdit_);
 	} else {
-		messagesEdit_->setPlainText(tr("The query is successfully comlete for %1 secs").arg(time_.elapsed() / 100));
+		messagesEdit_->appendPlainText(tr("The query is successfully completed in %1 ms").arg(time_.elapsed()));
 		if (outputModel_->rowCount() > 0) {
 			outputTabs_->setCurrentWidget(outputTable_);
 		} else {
@@ -384,15 +1263,19 @@ void SqlQueryWidget::connectionsChanged()
 {
 	const QString &currentConnection = connectionEdit_->currentText();
 	connectionEdit_->clear();
-	connectionEdit_->addItems(QSqlDatabase::connectionNames());
+	connectionEdit_->addItems(QueryExecutor::connectionNames());
 	connectionEdit_->setCurrentIndex(connectionEdit_->findText(currentConnection, Qt::MatchFixedString));
 }
 
 void SqlQueryWidget::updateActions()
 {
 	QPlainTextEdit *e = qobject_cast<QPlainTextEdit *> (inputTabs_->currentWidget());
-	if (!e)
+	if (!e) {
+		actionSave_->setEnabled(false);
+		actionUndo_->setEnabled(false);
+		actionRedo_->setEnabled(false);
 		return;
+	}
 
 	actionSave_->setEnabled(e->document()->isModified());
 	actionUndo_->setEnabled(e->document()->isUndoAvailable());
@@ -403,6 +1286,11 @@ bool SqlQueryWidget::closeTab(int index)
 {
 	inputTabs_->setCurrentIndex(index);
 
+	if (SqlFileView *view = qobject_cast<SqlFileView *> (inputTabs_->widget(index))) {
+		delete view;
+		return true;
+	}
+
 	QPlainTextEdit *e = qobject_cast<QPlainTextEdit *> (inputTabs_->widget(index));
 	if (!e)
 		return false;
@@ -32,13 +32,26 @@ class QToolBar;
 class QAction;
 class QSplitter;
 class QComboBox;
-class QSqlQueryModel;
+class QSpinBox;
+class QLineEdit;
 class QStatusBar;
-
-#include <QtCore/QTime>
+class QProgressBar;
+class QTimer;
+class QTreeWidget;
+class QTreeWidgetItem;
+class QSqlError;
+class QueryResultModel;
+class FanOutRunner;
+class SqlFileView;
+class PlanView;
+
+#include <QtCore/QElapsedTimer>
 
 #include <QtGui/QWidget>
 
+#include "queryexecutor.h"
+#include "timinglog.h"
+
 class SqlQueryWidget : public QWidget
 {
 	Q_OBJECT
@@ -47,13 +60,29 @@ public:
 	explicit SqlQueryWidget(const QString &connectionName = QString::null, QWidget *parent = nullptr);
 	virtual ~SqlQueryWidget();
 
+	QStringList targets() const;
+	void setTargets(const QStringList &connectionNames);
+
 private:
 	void loadSettings();
 	void saveSettings();
 	void retranslateStrings();
-
-	static QStringList removeComments(const QStringList &sqlQueryes);
-	static QStringList removeBlankLines(const QStringList &sqlQueryes);
+	void stopQuery();
+	void startRun();
+	void finishRun();
+	void submit(const QueryJob &job);
+	void addTimings(int jobId, const QueryResult &result);
+	void updateTimingsView();
+	void addHistory(const TimingRecord &record, const QueryResult &result);
+	QueryExecutor *executor(const QString &connectionName);
+	void queryExecuted(const QSqlError &error);
+	void scriptExecuted(const QueryResult &result);
+	void fileExecuted(const QueryResult &result);
+	void exportFinished(const QueryResult &result);
+	void explainFinished(const QueryResult &result);
+	void startFile(SqlFileView *view);
+	void startFanOut(const QString &text, const QStringList &statements);
+	QString errorLocation(const QSqlError &error, int firstLine) const;
 
 protected:
 
@@ -61,11 +90,29 @@ protected:
 private Q_SLOTS:
 	void updateTabCaptions();
 	QPlainTextEdit *addSqlEditor();
+	SqlFileView *addFileView(const QString &fileName);
 	void open();
 	bool save();
 	bool saveAs();
 	void start();
-	void queryFinished();
+	void explain();
+	void exportToFile();
+	void cancel();
+	void fetchMore();
+	void columnsReady(int jobId, const ResultColumns &columns);
+	void chunkFetched(int jobId, const ResultChunk &chunk, bool atEnd);
+	void jobFinished(int jobId, const QueryResult &result);
+	void statementFinished(int jobId, const StatementResult &result);
+	void fileProgress(int jobId, qint64 position, qint64 size, int statements);
+	void copyProgress(int jobId, qint64 bytes, qint64 rows);
+	void flushMessages();
+	void targetStarted(const QString &target);
+	void targetColumnsReady(const ResultColumns &columns);
+	void targetChunkFetched(const ResultChunk &chunk);
+	void targetFinished(const QString &target, const QueryResult &result, int rowCount, qint64 elapsed);
+	void fanOutFinished();
+	void updateHistoryView();
+	void historyItemActivated(QTreeWidgetItem *item);
 	void undo();
 
 	void redo();
@@ -79,26 +126,62 @@ public Q_SLOTS:
 
 private:
 	QString connectionName_;
-	QTime time_;
-	int timer_;
+	QElapsedTimer time_;
+	bool isRunning_;
+	QHash<int, TimingRecord> timedJobs_;
+	int fetchSize_;
+	qint64 largeFileSize_;
+	QueryExecutor *executor_;
+	int jobId_;
+	CancellationToken token_;
+	bool isScript_;
+	bool isFile_;
+	bool isExport_;
+	bool isExplain_;
+	QString exportFileName_;
+	qint64 exportedBytes_;
+	qint64 fileSize_;
+	QList<int> statementLines_;
+	int executedStatements_;
+	int failedStatements_;
+	QStringList pendingMessages_;
+	QTimer *messagesTimer_;
+	FanOutRunner *runner_;
+	QStringList targets_;
+	QHash<QString, QTreeWidgetItem *> targetItems_;
+	int failedTargets_;
+	qint64 slowestTarget_;
 
 	QTabWidget *inputTabs_;
 	QTabWidget *outputTabs_;
 	QList<QPlainTextEdit *> sqlEdits_;
 	QPlainTextEdit *messagesEdit_;
 	QTableView *outputTable_;
-	QSqlQueryModel *outputModel_;
+	QTreeWidget *targetsView_;
+	PlanView *planView_;
+	QTreeWidget *timingsView_;
+	QWidget *historyWidget_;
+	QLineEdit *historyFilterEdit_;
+	QTreeWidget *historyView_;
+	QueryResultModel *outputModel_;
 	QToolBar *toolBar_;
 	QSplitter *splitter_;
 	QComboBox *connectionEdit_;
+	QSpinBox *timeoutEdit_;
+	QSpinBox *parallelismEdit_;
 	QStatusBar *statusBar_;
+	QProgressBar *progressBar_;
 
 	QAction *actionAddSqlEditor_;
 	QAction *actionOpen_;
 	QAction *actionSave_;
 	QAction *actionSaveAs_;
 	QAction *actionStart_;
+	QAction *actionExplain_;
 	QAction *actionStop_;
+	QAction *actionStopOnError_;
+	QAction *actionExport_;
+	QAction *actionFanOut_;
 	QAction *actionUndo_;
 	QAction *actionRedo_;
 };